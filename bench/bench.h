@@ -0,0 +1,71 @@
+#ifndef MS_BENCH_H
+#define MS_BENCH_H
+
+// tiny helpers shared by the benchmarks in this directory.
+// build and run them all with `make bench release=1`
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "miniscript.h"
+
+static inline double benchSeconds(void)
+{
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+// growable string used to generate the scripts being benchmarked
+typedef struct {
+	char *data;
+	size_t length, cap;
+} BenchSource;
+
+static inline void benchAppend(BenchSource *src, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	int needed = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+
+	if (src->length + needed + 1 > src->cap)
+	{
+		src->cap = (src->length + needed + 1) * 2;
+		src->data = realloc(src->data, src->cap);
+	}
+
+	va_start(args, fmt);
+	vsnprintf(src->data + src->length, needed + 1, fmt, args);
+	va_end(args);
+	src->length += needed;
+}
+
+static inline void benchFreeSource(BenchSource *src)
+{
+	free(src->data);
+	src->data = NULL;
+	src->length = src->cap = 0;
+}
+
+// runs a script in a fresh VM, returns the time it took in seconds
+static inline double benchRunScript(const char *name, char *source)
+{
+	ms_VM *vm = ms_newVM(NULL);
+	double start = benchSeconds();
+	ms_InterpretResult res = ms_interpretString(vm, source);
+	double elapsed = benchSeconds() - start;
+	ms_freeVM(vm);
+
+	if (res != MS_INTERPRET_OK)
+	{
+		fprintf(stderr, "bench: script '%s' failed to run\n", name);
+		exit(-1);
+	}
+
+	printf("%-24s %8.3f ms\n", name, elapsed * 1000);
+	return elapsed;
+}
+
+#endif
@@ -0,0 +1,94 @@
+// compares the slab allocator against going to realloc for every allocation,
+// on a compile-heavy workload (lots of small functions, strings and code
+// buffers) and on string churn, then prints how full each size class ended up
+
+#include "bench.h"
+
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_vm.h"
+
+#define COMPILE_FUNCTIONS 200
+#define COMPILE_RUNS 200
+
+#define CHURN_ALLOCATIONS 1000000
+#define CHURN_LIVE 4096
+
+#define RUNS 3
+
+static double compileHeavy(char *source, bool slabs)
+{
+	double start = benchSeconds();
+	for (int r = 0; r < COMPILE_RUNS; r++)
+	{
+		ms_VM *vm = ms_newVM(NULL);
+		ms_useSlabAllocator(vm, slabs);
+		if (ms_interpretString(vm, source) != MS_INTERPRET_OK)
+		{
+			fprintf(stderr, "bench: compile-heavy script failed to run\n");
+			exit(-1);
+		}
+		ms_freeVM(vm);
+	}
+	return benchSeconds() - start;
+}
+
+static double stringChurn(bool slabs, bool report)
+{
+	ms_VM *vm = ms_newVM(NULL);
+	ms_useSlabAllocator(vm, slabs);
+	for (int i = 0; i < CHURN_LIVE; i++) ms_pushValueIntoVM(vm, MS_NULL_VAL);
+
+	char buf[32];
+	double start = benchSeconds();
+	for (int i = 0; i < CHURN_ALLOCATIONS; i++)
+	{
+		int len = sprintf(buf, "churn%d", i);
+		// copying may push onto the stack and move it, so don't index it before
+		ms_Value str = MS_FROM_OBJ(ms_copyString(vm, buf, len));
+		vm->stack[i % CHURN_LIVE] = str;
+		if (vm->nurseryFull) ms_collectYoung(vm);
+	}
+	double elapsed = benchSeconds() - start;
+
+	if (report) ms_printSlabReport(vm);
+	ms_freeVM(vm);
+	return elapsed;
+}
+
+int main(void)
+{
+	BenchSource src = {0};
+	for (int i = 0; i < COMPILE_FUNCTIONS; i++)
+		benchAppend(&src,
+			"f%d = function\n"
+			"  a = \"first %d\"\n"
+			"  b = \"second %d\"\n"
+			"  if a == b then\n"
+			"    return a\n"
+			"  end if\n"
+			"  return %d\n"
+			"end function\n", i, i, i, i);
+
+	// alternate both allocators and keep the best run of each, so that
+	// neither of them gets to warm up the process for the other
+	double best[4] = { -1, -1, -1, -1 };
+	for (int r = 0; r < RUNS; r++)
+	{
+		double times[4] = {
+			compileHeavy(src.data, false), compileHeavy(src.data, true),
+			stringChurn(false, false), stringChurn(true, false),
+		};
+		for (int i = 0; i < 4; i++)
+			if (best[i] < 0 || times[i] < best[i]) best[i] = times[i];
+	}
+
+	printf("%-24s %8.3f ms\n", "compile-heavy (realloc)", best[0] * 1000);
+	printf("%-24s %8.3f ms\n", "compile-heavy (slabs)", best[1] * 1000);
+	printf("%-24s %8.3f ms\n", "string churn (realloc)", best[2] * 1000);
+	printf("%-24s %8.3f ms\n", "string churn (slabs)", best[3] * 1000);
+
+	stringChurn(true, true);
+	benchFreeSource(&src);
+	return 0;
+}
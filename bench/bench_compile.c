@@ -0,0 +1,156 @@
+// compiling generated data tables: every line brings new constants, so
+// scripts like this used to run out of constant slots after 256 of them.
+// the time per line should stay the same as the tables grow.
+// also reports how big the bytecode and its line table end up, then how
+// many MB of source per second go through the compiler for code that's
+// mostly names of locals and globals, and how long loading the same
+// code back from a bytecode file takes instead. first of all, it checks
+// a few scripts the compiler used to get wrong
+
+#include "bench.h"
+
+#include "ms_bytecode.h"
+#include "ms_compiler.h"
+#include "ms_vm.h"
+
+#include <math.h>
+
+#define BYTECODE_PATH "bench_compile.msc"
+
+static ms_ObjFunction *compile(ms_VM *vm, BenchSource *src, double *elapsed)
+{
+	double start = benchSeconds();
+	ms_ObjFunction *function = ms_compileString(vm, src->data);
+	*elapsed = benchSeconds() - start;
+
+	if (function == NULL)
+	{
+		fprintf(stderr, "bench: a generated script failed to compile\n");
+		exit(-1);
+	}
+	return function;
+}
+
+// runs the script in a fresh VM, and compares `r` to `expected` bit for bit
+static void check(const char *name, char *source, double expected)
+{
+	ms_VM *vm = ms_newVM(NULL);
+	bool ran = ms_interpretString(vm, source) == MS_INTERPRET_OK;
+
+	int slot = ms_findGlobal(vm, ms_copyString(vm, "r", 1));
+	ms_Value r = slot >= 0 ? vm->globalValues.data[slot] : MS_NULL_VAL;
+	double got = MS_IS_NUM(r) ? MS_TO_NUM(r) : NAN;
+	ms_freeVM(vm);
+
+	if (!ran || memcmp(&got, &expected, sizeof got) != 0)
+	{
+		fprintf(stderr, "bench: '%s' gave %g instead of %g\n", name, got, expected);
+		exit(-1);
+	}
+}
+
+static void checks(void)
+{
+	// folding 0 * -1 used to leave -0 in the constant pool, where the 0 below found it
+	check("-0 constant", "n = 0 * -1\nr = 5 / 0\n", INFINITY);
+
+	// reading a local holding a constant past the first 256 used to make
+	// the code longer than the 16-bit jumps around it could cover
+	BenchSource src = {0};
+	benchAppend(&src, "f = function()\n  a = [");
+	for (int i = 0; i < 300; i++) benchAppend(&src, "%s%d.25", i == 0 ? "" : ", ", i);
+	benchAppend(&src, "]\n  i = 0\n  s = 0\n  while i < 2\n    x = 5000.5\n");
+	for (int i = 0; i < 3000; i++) benchAppend(&src, "    s = [@x, @x, @x, @x, @x, @x, @x, @x]\n");
+	benchAppend(&src, "    i = i + 1\n  end while\n  return s[0] + i\nend function\nr = f\n");
+	check("long constant copies", src.data, 5002.5);
+	benchFreeSource(&src);
+
+	// the outer function's `return` used to find the INVOKE offset the
+	// nested one left behind, and turned the CONST there into a TAIL_INVOKE
+	check("nested function returned", "f = function\n  a = 1\n  return function(p)\n"
+		"    y = p\n  end function\nend function\nh = f\nr = 1\n", 1);
+
+	printf("(compiler checks passed)\n\n");
+}
+
+static void table(size_t lines)
+{
+	BenchSource src = {0};
+	benchAppend(&src, "rows = 0\n");
+	for (size_t i = 0; i < lines; i++)
+	{
+		if (i % 4 == 0) benchAppend(&src, "name = \"row %zu\"\n", i);
+		else benchAppend(&src, "value = %zu.5 + rows * %zu\n", i, i + 1);
+	}
+	benchAppend(&src, "rows = %zu\n", lines);
+
+	ms_VM *vm = ms_newVM(NULL);
+	double elapsed;
+	ms_ObjFunction *function = compile(vm, &src, &elapsed);
+
+	// the line table against the int per byte of code it replaced
+	ms_Code *code = &function->code;
+	size_t runBytes = code->lineCap * sizeof(ms_LineRun);
+	size_t perByte = code->cap * sizeof(int);
+
+	printf("%7zu lines %8zu constants %10.3f ms %8.1f ns/line %7.1f MB/s %9zu KB code %7zu KB lines (was %zu KB)\n",
+		lines, code->constants.count, elapsed * 1000, elapsed * 1e9 / lines, src.length / elapsed / 1e6,
+		code->cap / 1024, runBytes / 1024, perByte / 1024);
+
+	ms_freeVM(vm);
+	benchFreeSource(&src);
+}
+
+// `count` functions reading and writing a few locals and a few of the
+// globals, which are declared up front
+static void names(size_t count, size_t globals)
+{
+	BenchSource src = {0};
+	for (size_t g = 0; g < globals; g++) benchAppend(&src, "global_value_%zu = %zu\n", g, g);
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t g = i * 7 % globals;
+		benchAppend(&src,
+			"update_%zu = function(amount, factor)\n"
+			"  current_total = global_value_%zu + amount\n"
+			"  scaled_total = current_total * factor\n"
+			"  if scaled_total > global_value_%zu then\n"
+			"    scaled_total = scaled_total - current_total\n"
+			"  end if\n"
+			"  return scaled_total + amount * factor\n"
+			"end function\n",
+			i, g, (g + 1) % globals);
+	}
+
+	ms_VM *vm = ms_newVM(NULL);
+	double elapsed;
+	ms_ObjFunction *function = compile(vm, &src, &elapsed);
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(function));
+	bool saved = ms_saveBytecode(vm, function, BYTECODE_PATH);
+	ms_freeVM(vm);
+
+	double loading = 0;
+	if (saved)
+	{
+		vm = ms_newVM(NULL);
+		double start = benchSeconds();
+		function = ms_loadBytecode(vm, BYTECODE_PATH);
+		loading = benchSeconds() - start;
+		ms_freeVM(vm);
+		remove(BYTECODE_PATH);
+	}
+
+	printf("%7zu functions %6zu globals %10.3f ms %7.1f MB/s (%zu KB of source) %8.3f ms loading bytecode\n",
+		count, globals, elapsed * 1000, src.length / elapsed / 1e6, src.length / 1024, loading * 1000);
+
+	benchFreeSource(&src);
+}
+
+int main(void)
+{
+	checks();
+	for (size_t lines = 12500; lines <= 200000; lines *= 2) table(lines);
+	printf("\n");
+	for (size_t globals = 16; globals <= 4096; globals *= 16) names(20000, globals);
+	return 0;
+}
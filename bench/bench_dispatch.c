@@ -0,0 +1,58 @@
+// times the interpreter loop over the benchmark corpus.
+// A/B the dispatch modes by comparing a plain build against
+// `make bench release=1 features=MS_NO_COMPUTED_GOTO`, and quickening
+// against one with MS_NO_QUICKENING.
+// building with MS_PROFILE_OPCODES also prints which opcode pairs
+// the corpus executes the most, which is what superinstructions are picked from
+
+#include "bench.h"
+#include "corpus.h"
+
+#include "ms_common.h"
+#ifdef MS_PROFILE_OPCODES
+#include "ms_debug.h"
+#endif
+
+#define RUNS 5
+
+int main(void)
+{
+#ifdef MS_COMPUTED_GOTO
+	printf("dispatch: computed goto\n");
+#else
+	printf("dispatch: switch\n");
+#endif
+
+	double total = 0;
+	for (size_t i = 0; i < BENCH_CORPUS_SIZE; i++)
+	{
+		// keep the best of a few runs to filter out scheduling noise
+		double best = -1;
+		for (int r = 0; r < RUNS; r++)
+		{
+			ms_VM *vm = ms_newVM(NULL);
+			double start = benchSeconds();
+			ms_InterpretResult res = ms_interpretString(vm, (char*)benchCorpus[i].source);
+			double elapsed = benchSeconds() - start;
+			ms_freeVM(vm);
+
+			if (res != MS_INTERPRET_OK)
+			{
+				fprintf(stderr, "bench: script '%s' failed to run\n", benchCorpus[i].name);
+				return -1;
+			}
+
+			if (best < 0 || elapsed < best) best = elapsed;
+		}
+
+		printf("%-24s %8.3f ms\n", benchCorpus[i].name, best * 1000);
+		total += best;
+	}
+
+	printf("%-24s %8.3f ms\n", "total", total * 1000);
+
+#ifdef MS_PROFILE_OPCODES
+	ms_printOpcodePairProfile(20);
+#endif
+	return 0;
+}
@@ -0,0 +1,58 @@
+// measures collection pauses on an allocation-heavy loop: lots of strings
+// that die right away, with a small window of them staying alive for a while.
+// compare a plain build against `make bench release=1 features=MS_NO_NURSERY`.
+// the loop drives the VM from C, to measure the collector without the
+// interpreter around it, and polls for a minor collection like the safepoints do
+
+#include "bench.h"
+
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_vm.h"
+
+#define ALLOCATIONS 2000000
+// how many of the most recent strings are kept reachable from the stack
+#define LIVE_WINDOW 64
+
+int main(void)
+{
+#ifdef MS_NO_NURSERY
+	printf("heap: single generation\n");
+#else
+	printf("heap: %d KB nursery\n", MS_NURSERY_SIZE / 1024);
+#endif
+
+	ms_VM *vm = ms_newVM(NULL);
+	for (int i = 0; i < LIVE_WINDOW; i++) ms_pushValueIntoVM(vm, MS_NULL_VAL);
+
+	char buf[32];
+	double start = benchSeconds();
+	for (int i = 0; i < ALLOCATIONS; i++)
+	{
+		int len = sprintf(buf, "temp%d", i);
+		// copying may push onto the stack and move it, so don't index it before
+		ms_Value str = MS_FROM_OBJ(ms_copyString(vm, buf, len));
+		vm->stack[i % LIVE_WINDOW] = str;
+		if (vm->nurseryFull) ms_collectYoung(vm);
+	}
+	double elapsed = benchSeconds() - start;
+
+	const ms_GCStats *stats = ms_getGCStats(vm);
+	printf("%-24s %8.3f ms\n", "total", elapsed * 1000);
+	printf("%-24s %8zu\n", "minor collections", stats->minorCycles);
+	if (stats->minorCycles > 0)
+	{
+		printf("%-24s %8.1f us\n", "avg minor pause", stats->totalMinorPause / stats->minorCycles * 1e6);
+		printf("%-24s %8.1f us\n", "max minor pause", stats->maxMinorPause * 1e6);
+		printf("%-24s %8zu KB\n", "promoted", stats->bytesPromoted / 1024);
+	}
+	printf("%-24s %8zu\n", "major collections", stats->cycles);
+	if (stats->cycles > 0)
+	{
+		printf("%-24s %8.1f us\n", "avg major pause", stats->totalPause / stats->cycles * 1e6);
+		printf("%-24s %8.1f us\n", "max major pause", stats->maxPause * 1e6);
+	}
+
+	ms_freeVM(vm);
+	return 0;
+}
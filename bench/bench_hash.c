@@ -0,0 +1,153 @@
+// string hashing throughput, on identifier-sized keys and on a few
+// kilobytes, against a copy of the old byte-at-a-time FNV-1a. then checks
+// how well the built hash spreads a set of very similar identifiers over
+// the intern table: full hash collisions, and how evenly keys land in
+// groups and control bytes (a chi-square of about 1 per bucket is ideal).
+// `make bench release=1 features=MS_HASH_FNV1A` runs it with FNV-1a built in
+
+#include "bench.h"
+
+#include "ms_hash.h"
+#include "ms_map.h"
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_vm.h"
+
+#define BYTES_PER_SIZE (64 * 1024 * 1024)
+#define IDENTIFIERS 100000
+
+static const size_t sizes[] = { 4, 8, 12, 16, 24, 32, 64, 1024, 4096, 16384 };
+#define SIZE_COUNT (sizeof(sizes) / sizeof(*sizes))
+
+static uint32_t fnv1a(const void *ptr, size_t length)
+{
+	const uint8_t *p = ptr;
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++)
+		hash = (hash ^ p[i]) * 16777619;
+	return hash;
+}
+
+static volatile uint32_t sink;
+
+static void throughput(void)
+{
+	size_t bufSize = sizes[SIZE_COUNT - 1] + 64;
+	char *buf = malloc(bufSize);
+	for (size_t i = 0; i < bufSize; i++) buf[i] = 'a' + i % 26;
+
+	printf("%8s %12s %12s %12s %12s\n", "bytes", "fnv1a ns", "fnv1a MB/s", "built ns", "built MB/s");
+	for (size_t s = 0; s < SIZE_COUNT; s++)
+	{
+		size_t len = sizes[s], count = BYTES_PER_SIZE / len;
+		uint32_t acc = 0;
+
+		// the start moves around so every call hashes something different
+		double start = benchSeconds();
+		for (size_t i = 0; i < count; i++) acc ^= fnv1a(buf + (i & 63), len);
+		double fnvTime = benchSeconds() - start;
+
+		uint64_t seed = ms_prepareHashSeed(0x1234);
+		start = benchSeconds();
+		for (size_t i = 0; i < count; i++) acc ^= ms_hashMem(buf + (i & 63), len, seed);
+		double builtTime = benchSeconds() - start;
+
+		sink = acc;
+		printf("%8zu %12.2f %12.0f %12.2f %12.0f\n", len,
+			fnvTime * 1e9 / count, BYTES_PER_SIZE / fnvTime / 1e6,
+			builtTime * 1e9 / count, BYTES_PER_SIZE / builtTime / 1e6);
+	}
+
+	free(buf);
+}
+
+static int compareHashes(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+static double chiSquare(size_t *buckets, size_t count, size_t keys)
+{
+	double expected = (double)keys / count, sum = 0;
+	for (size_t i = 0; i < count; i++)
+		sum += (buckets[i] - expected) * (buckets[i] - expected) / expected;
+	return sum / count;
+}
+
+// hashes as the map uses them: the low 7 bits are the control byte, the rest picks the group
+static void quality(const char *name, uint32_t *hashes, size_t n, size_t cap)
+{
+	size_t groups = cap / MS_MAP_GROUP_WIDTH;
+	size_t *groupKeys = calloc(groups, sizeof(size_t));
+	size_t ctrlKeys[128] = {0};
+	for (size_t i = 0; i < n; i++)
+	{
+		groupKeys[(hashes[i] >> 7) & (groups - 1)]++;
+		ctrlKeys[hashes[i] & 0x7f]++;
+	}
+
+	qsort(hashes, n, sizeof *hashes, compareHashes);
+	size_t collisions = 0;
+	for (size_t i = 1; i < n; i++) collisions += hashes[i] == hashes[i - 1];
+
+	printf("%-8s %12zu %12.3f %12.3f\n", name, collisions,
+		chiSquare(groupKeys, groups, n), chiSquare(ctrlKeys, 128, n));
+	free(groupKeys);
+}
+
+static void collisionCheck(void)
+{
+	ms_VM *vm = ms_newVM(NULL);
+	ms_setHashSeed(vm, 0x1234);
+	// the strings are only referenced by the table
+	ms_setGCMinThreshold(vm, SIZE_MAX);
+
+	// names that differ in a character or two, like a program's identifiers do
+	char buf[32];
+	for (int i = 0; i < IDENTIFIERS; i++)
+	{
+		int len = sprintf(buf, i % 2 ? "var%d" : "item_%x", i);
+		ms_copyString(vm, buf, len);
+	}
+
+	ms_Map *strings = &vm->strings;
+	size_t n = strings->count, inHomeGroup = 0, groupMask = strings->cap / MS_MAP_GROUP_WIDTH - 1;
+	uint32_t *built = malloc(n * sizeof(uint32_t));
+	uint32_t *fnv = malloc(n * sizeof(uint32_t));
+
+	for (size_t i = 0, k = 0; i < strings->cap; i++)
+	{
+		if (!ms_isMapSlotUsed(strings, i)) continue;
+		ms_ObjString *str = MS_TO_STRING(strings->entries[i].key);
+		built[k] = str->hash;
+		fnv[k] = fnv1a(str->chars, str->length);
+		k++;
+
+		if (i / MS_MAP_GROUP_WIDTH == ((str->hash >> 7) & groupMask)) inHomeGroup++;
+	}
+
+	printf("\n%zu identifiers in a table of %zu slots (expected collisions: %.2f)\n",
+		n, strings->cap, (double)n * (n - 1) / 2 / 4294967296.0);
+	printf("%-8s %12s %12s %12s\n", "hash", "collisions", "chi2/group", "chi2/ctrl");
+	quality("fnv1a", fnv, n, strings->cap);
+	quality("built", built, n, strings->cap);
+	printf("keys found in their first group: %.2f%%\n", 100.0 * inHomeGroup / n);
+
+	free(built);
+	free(fnv);
+	ms_freeVM(vm);
+}
+
+int main(void)
+{
+#ifdef MS_HASH_FNV1A
+	printf("built hash: fnv1a\n");
+#else
+	printf("built hash: word-at-a-time\n");
+#endif
+
+	throughput();
+	collisionCheck();
+	return 0;
+}
@@ -0,0 +1,87 @@
+// list slicing and indexing. `a = a[1:]` until the list is empty, with
+// slices as views and with slices copied (what they'd cost without views),
+// then scripts reading and writing lists built from big literals
+
+#include "bench.h"
+
+#include "ms_list.h"
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_vm.h"
+
+static const size_t lengths[] = { 100, 1000, 10000, 20000 };
+#define LENGTH_COUNT (sizeof(lengths) / sizeof(*lengths))
+
+// stack slot 0 holds the list being sliced
+static double dropFirst(size_t length, bool copy)
+{
+	ms_VM *vm = ms_newVM(NULL);
+	ms_ObjList *list = ms_newList(vm, length, true);
+	for (size_t i = 0; i < length; i++) list->as.numbers[i] = i;
+	list->count = length;
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(list));
+
+	double start = benchSeconds();
+	while (list->count > 0)
+	{
+		list = copy
+			? ms_newNumericListFrom(vm, list->as.numbers + 1, list->count - 1)
+			: ms_sliceList(vm, list, 1, list->count);
+		vm->stack[0] = MS_FROM_OBJ(list);
+		if (vm->nurseryFull) ms_collectYoung(vm);
+		list = MS_TO_LIST(vm->stack[0]);
+	}
+	double elapsed = benchSeconds() - start;
+
+	ms_freeVM(vm);
+	return elapsed;
+}
+
+// a chunk only holds 256 constants, so the items repeat
+static void literal(BenchSource *src, size_t length)
+{
+	benchAppend(src, "a = [");
+	for (size_t i = 0; i < length; i++) benchAppend(src, i > 0 ? ", %zu" : "%zu", i % 200);
+	benchAppend(src, "]\n");
+}
+
+int main(void)
+{
+	printf("%8s %12s %12s\n", "length", "view ms", "copy ms");
+	for (size_t i = 0; i < LENGTH_COUNT; i++)
+	{
+		size_t length = lengths[i];
+		double view = dropFirst(length, false);
+		double copy = dropFirst(length, true);
+		printf("%8zu %12.3f %12.3f\n", length, view * 1000, copy * 1000);
+	}
+	printf("\n");
+
+	BenchSource src = {0};
+	literal(&src, 10000);
+	benchAppend(&src,
+		"sum = 0\n"
+		"round = 0\n"
+		"while round < 100\n"
+		"i = 0\n"
+		"while i < 10000\n"
+		"sum = sum + a[i]\n"
+		"a[i] = a[-1 - i]\n"
+		"i = i + 1\n"
+		"end while\n"
+		"round = round + 1\n"
+		"end while\n");
+	benchRunScript("index get/set", src.data);
+	benchFreeSource(&src);
+
+	literal(&src, 10000);
+	benchAppend(&src,
+		"b = a\n"
+		"while b\n"
+		"b = b[1:]\n"
+		"end while\n");
+	benchRunScript("slice loop", src.data);
+	benchFreeSource(&src);
+
+	return 0;
+}
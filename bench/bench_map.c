@@ -0,0 +1,165 @@
+// compares the swiss table against the map it replaced (bench/old_map.h)
+// at a few load factors: both tables are kept at the same capacity and
+// filled with interned string keys, then looked up, missed, and churned
+// by deleting and reinserting every key, which leaves tombstones behind.
+// `make bench release=1 features=MS_NO_SIMD` runs the scalar group matching
+
+#include "bench.h"
+
+#include "ms_map.h"
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_vm.h"
+
+#include "old_map.h"
+
+#define CAP (1 << 16)
+#define LOOKUP_ROUNDS 20
+#define CHURN_ROUNDS 4
+
+static const double loads[] = { 0.5, 0.625, 0.75, 0.85 };
+#define LOAD_COUNT (sizeof(loads) / sizeof(*loads))
+
+typedef struct {
+	double insert, hit, miss, churn;
+	size_t cap;
+} Result;
+
+// nanoseconds per operation
+static inline double perOp(double seconds, size_t ops)
+{
+	return seconds * 1e9 / ops;
+}
+
+static volatile double sink;
+
+static Result benchOld(ms_VM *vm, ms_Value *keys, ms_Value *misses, size_t n)
+{
+	Result res;
+	OldMap map;
+	oldInitMap(vm, &map);
+
+	double start = benchSeconds();
+	for (size_t i = 0; i < n; i++) oldSetMapKey(vm, &map, keys[i], MS_FROM_NUM(i));
+	res.insert = perOp(benchSeconds() - start, n);
+
+	ms_Value value = MS_NULL_VAL;
+	double sum = 0;
+	start = benchSeconds();
+	for (int r = 0; r < LOOKUP_ROUNDS; r++)
+		for (size_t i = 0; i < n; i++)
+			if (oldGetMapKey(vm, &map, keys[i], &value)) sum += MS_TO_NUM(value);
+	res.hit = perOp(benchSeconds() - start, n * LOOKUP_ROUNDS);
+
+	start = benchSeconds();
+	for (int r = 0; r < LOOKUP_ROUNDS; r++)
+		for (size_t i = 0; i < n; i++)
+			if (oldGetMapKey(vm, &map, misses[i], &value)) sum += 1;
+	res.miss = perOp(benchSeconds() - start, n * LOOKUP_ROUNDS);
+
+	start = benchSeconds();
+	for (int r = 0; r < CHURN_ROUNDS; r++)
+		for (size_t i = 0; i < n; i++)
+		{
+			oldDeleteFromMap(vm, &map, keys[i]);
+			oldSetMapKey(vm, &map, keys[i], MS_FROM_NUM(i));
+		}
+	res.churn = perOp(benchSeconds() - start, n * CHURN_ROUNDS * 2);
+
+	sink = sum;
+	res.cap = map.cap;
+	oldFreeMap(vm, &map);
+	return res;
+}
+
+static Result benchNew(ms_VM *vm, ms_Value *keys, ms_Value *misses, size_t n)
+{
+	Result res;
+	ms_Map map;
+	ms_initMap(vm, &map);
+
+	double start = benchSeconds();
+	for (size_t i = 0; i < n; i++) ms_setMapKey(vm, &map, keys[i], MS_FROM_NUM(i));
+	res.insert = perOp(benchSeconds() - start, n);
+
+	ms_Value value = MS_NULL_VAL;
+	double sum = 0;
+	start = benchSeconds();
+	for (int r = 0; r < LOOKUP_ROUNDS; r++)
+		for (size_t i = 0; i < n; i++)
+			if (ms_getMapKey(vm, &map, keys[i], &value)) sum += MS_TO_NUM(value);
+	res.hit = perOp(benchSeconds() - start, n * LOOKUP_ROUNDS);
+
+	start = benchSeconds();
+	for (int r = 0; r < LOOKUP_ROUNDS; r++)
+		for (size_t i = 0; i < n; i++)
+			if (ms_getMapKey(vm, &map, misses[i], &value)) sum += 1;
+	res.miss = perOp(benchSeconds() - start, n * LOOKUP_ROUNDS);
+
+	start = benchSeconds();
+	for (int r = 0; r < CHURN_ROUNDS; r++)
+		for (size_t i = 0; i < n; i++)
+		{
+			ms_deleteFromMap(vm, &map, keys[i]);
+			ms_setMapKey(vm, &map, keys[i], MS_FROM_NUM(i));
+		}
+	res.churn = perOp(benchSeconds() - start, n * CHURN_ROUNDS * 2);
+
+	sink = sum;
+	res.cap = map.cap;
+	ms_freeMap(vm, &map);
+	return res;
+}
+
+static void printResult(const char *name, Result *res, double bytesPerSlot)
+{
+	printf("  %-6s %7zu %8.1f %8.1f %8.1f %8.1f %8.1f\n",
+		name, res->cap, res->insert, res->hit, res->miss, res->churn, bytesPerSlot);
+}
+
+int main(void)
+{
+	ms_VM *vm = ms_newVM(NULL);
+	// the keys are only referenced from here
+	ms_setGCMinThreshold(vm, SIZE_MAX);
+
+	size_t maxKeys = CAP;
+	ms_Value *keys = malloc(sizeof(ms_Value) * maxKeys);
+	ms_Value *misses = malloc(sizeof(ms_Value) * maxKeys);
+
+	char buf[32];
+	for (size_t i = 0; i < maxKeys; i++)
+	{
+		int len = sprintf(buf, "key%zu", i);
+		keys[i] = MS_FROM_OBJ(ms_copyString(vm, buf, len));
+		len = sprintf(buf, "miss%zu", i);
+		misses[i] = MS_FROM_OBJ(ms_copyString(vm, buf, len));
+	}
+
+#if defined(__SSE2__) && !defined(MS_NO_SIMD)
+	printf("group matching: sse2\n");
+#else
+	printf("group matching: scalar\n");
+#endif
+	printf("all times in ns/op\n");
+
+	// keep the old map from growing past CAP, so both are measured at the same load
+	oldMaxLoad = 0.95;
+
+	for (size_t l = 0; l < LOAD_COUNT; l++)
+	{
+		size_t n = (size_t)(loads[l] * CAP);
+		printf("load %.3f (%zu keys)\n", loads[l], n);
+		printf("  %-6s %7s %8s %8s %8s %8s %8s\n", "map", "cap", "insert", "hit", "miss", "churn", "B/slot");
+
+		Result old = benchOld(vm, keys, misses, n);
+		Result new = benchNew(vm, keys, misses, n);
+		printResult("old", &old, sizeof(OldMapEntry));
+		printResult("swiss", &new, sizeof(ms_MapEntry) + 1);
+	}
+
+	free(keys);
+	free(misses);
+	ms_freeVM(vm);
+	return 0;
+}
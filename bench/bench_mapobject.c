@@ -0,0 +1,75 @@
+// maps as scripts use them: filling one with string and number keys,
+// reading it back, and looping over it with `for`, next to the same
+// loop over a list of the same length
+
+#include "bench.h"
+
+int main(void)
+{
+	benchRunScript("set string keys",
+		"m = {}\n"
+		"i = 0\n"
+		"while i < 200000\n"
+		"m[\"k\" + (i % 5000)] = i\n"
+		"i = i + 1\n"
+		"end while\n");
+
+	benchRunScript("get/set number keys",
+		"m = {}\n"
+		"i = 0\n"
+		"while i < 5000\n"
+		"m[i] = i\n"
+		"i = i + 1\n"
+		"end while\n"
+		"round = 0\n"
+		"while round < 100\n"
+		"i = 0\n"
+		"while i < 5000\n"
+		"m[i] = m[i] + 1\n"
+		"i = i + 1\n"
+		"end while\n"
+		"round = round + 1\n"
+		"end while\n");
+
+	benchRunScript("small map literals",
+		"i = 0\n"
+		"while i < 100000\n"
+		"p = {\"x\": i, \"y\": i + 1, \"z\": 0}\n"
+		"s = p[\"x\"] + p[\"y\"] + p[\"z\"]\n"
+		"i = i + 1\n"
+		"end while\n");
+
+	const char *fill =
+		"m = {}\n"
+		"l = []\n"
+		"i = 0\n"
+		"while i < 5000\n"
+		"m[i] = i\n"
+		"l = l + [i]\n"
+		"i = i + 1\n"
+		"end while\n"
+		"sum = 0\n"
+		"round = 0\n"
+		"while round < 100\n";
+
+	BenchSource src = {0};
+	benchAppend(&src, "%s%s", fill,
+		"for p in m\n"
+		"sum = sum + p[\"value\"]\n"
+		"end for\n"
+		"round = round + 1\n"
+		"end while\n");
+	benchRunScript("for over a map", src.data);
+	benchFreeSource(&src);
+
+	benchAppend(&src, "%s%s", fill,
+		"for x in l\n"
+		"sum = sum + x\n"
+		"end for\n"
+		"round = round + 1\n"
+		"end while\n");
+	benchRunScript("for over a list", src.data);
+	benchFreeSource(&src);
+
+	return 0;
+}
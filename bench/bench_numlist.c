@@ -0,0 +1,142 @@
+// numeric lists against lists of values holding the same numbers: the
+// whole-list operations in ms_listops.h, then scripts indexing and
+// looping over a list that's numeric, or stopped being numeric
+
+#include "bench.h"
+
+#include "ms_list.h"
+#include "ms_listops.h"
+#include "ms_object.h"
+#include "ms_vm.h"
+
+#define LENGTH 1000000
+#define ROUNDS 20
+
+// stack slots 0 and 1 hold the lists
+static void fill(ms_VM *vm, ms_ObjList **numeric, ms_ObjList **values)
+{
+	*numeric = ms_newList(vm, LENGTH, true);
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(*numeric));
+	*values = ms_newList(vm, LENGTH, false);
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(*values));
+
+	// scrambled, for sorting
+	uint32_t x = 12345;
+	for (size_t i = 0; i < LENGTH; i++)
+	{
+		x = x * 1664525 + 1013904223;
+		double num = (double)(x >> 8) / 1024 - 4096;
+		(*numeric)->as.numbers[i] = num;
+		(*values)->as.values[i] = MS_FROM_NUM(num);
+	}
+	(*numeric)->count = (*values)->count = LENGTH;
+}
+
+static void row(const char *name, double numeric, double values)
+{
+	printf("%-16s %12.3f %12.3f\n", name, numeric * 1000, values * 1000);
+}
+
+int main(void)
+{
+	ms_VM *vm = ms_newVM(NULL);
+	ms_ObjList *numeric, *values;
+	fill(vm, &numeric, &values);
+
+	printf("%-16s %12s %12s\n", "1M items", "numeric ms", "values ms");
+
+	double sums[2] = {0}, times[2];
+	for (int kind = 0; kind < 2; kind++)
+	{
+		double start = benchSeconds();
+		for (int r = 0; r < ROUNDS; r++) sums[kind] += ms_sumList(kind == 0 ? numeric : values);
+		times[kind] = benchSeconds() - start;
+	}
+	row("sum x20", times[0], times[1]);
+
+	double min, max;
+	for (int kind = 0; kind < 2; kind++)
+	{
+		double start = benchSeconds();
+		for (int r = 0; r < ROUNDS; r++) ms_listMinMax(kind == 0 ? numeric : values, &min, &max);
+		times[kind] = benchSeconds() - start;
+	}
+	row("min/max x20", times[0], times[1]);
+
+	size_t found[2];
+	for (int kind = 0; kind < 2; kind++)
+	{
+		double start = benchSeconds();
+		for (int r = 0; r < ROUNDS; r++)
+			found[kind] = ms_listIndexOf(vm, kind == 0 ? numeric : values, MS_FROM_NUM(1e9), 0);
+		times[kind] = benchSeconds() - start;
+	}
+	row("indexOf x20", times[0], times[1]);
+
+	for (int kind = 0; kind < 2; kind++)
+	{
+		double start = benchSeconds();
+		for (int r = 0; r < ROUNDS; r++)
+			ms_combineLists(vm, MS_OP_ADD, kind == 0 ? numeric : values, MS_FROM_NUM(1));
+		times[kind] = benchSeconds() - start;
+	}
+	row("list + 1 x20", times[0], times[1]);
+
+	for (int kind = 0; kind < 2; kind++)
+	{
+		double start = benchSeconds();
+		ms_sortList(vm, kind == 0 ? numeric : values);
+		times[kind] = benchSeconds() - start;
+	}
+	row("sort", times[0], times[1]);
+
+	bool sorted = true;
+	for (size_t i = 1; i < LENGTH; i++)
+		sorted = sorted && numeric->as.numbers[i - 1] <= numeric->as.numbers[i]
+		                && MS_TO_NUM(values->as.values[i]) == numeric->as.numbers[i];
+	printf("(sums %s, %s, sorted %s)\n\n",
+		sums[0] == sums[1] ? "agree" : "differ in the last bits",
+		found[0] == found[1] ? "same indexOf" : "different indexOf",
+		sorted ? "the same" : "differently");
+	ms_freeVM(vm);
+
+	// doubling a one item list, then writing every item
+	const char *prelude =
+		"a = [0]\n"
+		"n = 1\n"
+		"while n < 131072\n"
+		"a = a + a\n"
+		"n = n + n\n"
+		"end while\n"
+		"i = 0\n"
+		"while i < n\n"
+		"a[i] = i\n"
+		"i = i + 1\n"
+		"end while\n";
+	const char *loops =
+		"sum = 0\n"
+		"round = 0\n"
+		"while round < 10\n"
+		"i = 0\n"
+		"while i < n\n"
+		"sum = sum + a[i]\n"
+		"i = i + 1\n"
+		"end while\n"
+		"for x in a\n"
+		"sum = sum + x\n"
+		"end for\n"
+		"round = round + 1\n"
+		"end while\n";
+
+	BenchSource src = {0};
+	benchAppend(&src, "%s%s", prelude, loops);
+	benchRunScript("numeric list", src.data);
+	benchFreeSource(&src);
+
+	// once a string's been in it, it's a list of values for good
+	benchAppend(&src, "%sa[0] = \"x\"\na[0] = 0\n%s", prelude, loops);
+	benchRunScript("list of values", src.data);
+	benchFreeSource(&src);
+
+	return 0;
+}
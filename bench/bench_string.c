@@ -0,0 +1,73 @@
+// appending to a string in a loop, the case ropes are there for: once with
+// the result left as a rope until it's read, once flattening after every
+// append the way copying strings used to. then the same through scripts,
+// with `+` in a loop and with `*`
+
+#include "bench.h"
+
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_string.h"
+#include "ms_vm.h"
+
+static const size_t appendCounts[] = { 1000, 10000, 50000 };
+#define APPEND_COUNT_COUNT (sizeof(appendCounts) / sizeof(*appendCounts))
+
+static volatile size_t sink;
+
+// slot 0 of the stack holds the string being built, slot 1 the piece appended to it
+static double appendLoop(size_t count, bool eager)
+{
+	ms_VM *vm = ms_newVM(NULL);
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(ms_copyString(vm, "", 0)));
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(ms_copyString(vm, "item, ", 6)));
+
+	double start = benchSeconds();
+	for (size_t i = 0; i < count; i++)
+	{
+		ms_Value str = ms_concatStrings(vm, vm->stack[0], vm->stack[1]);
+		vm->stack[0] = str;
+		if (eager && MS_IS_ROPE(str))
+		{
+			ms_ObjString *flat = ms_flattenString(vm, str);
+			vm->stack[0] = MS_FROM_OBJ(flat);
+		}
+		if (vm->nurseryFull) ms_collectYoung(vm);
+	}
+	sink = ms_flattenString(vm, vm->stack[0])->length;
+	double elapsed = benchSeconds() - start;
+
+	ms_freeVM(vm);
+	return elapsed;
+}
+
+int main(void)
+{
+	printf("%8s %12s %12s\n", "appends", "rope ms", "eager ms");
+	for (size_t i = 0; i < APPEND_COUNT_COUNT; i++)
+	{
+		size_t count = appendCounts[i];
+		double rope = appendLoop(count, false);
+		double eager = appendLoop(count, true);
+		printf("%8zu %12.3f %12.3f\n", count, rope * 1000, eager * 1000);
+	}
+	printf("\n");
+
+	benchRunScript("append in a loop",
+		"s = \"\"\n"
+		"i = 0\n"
+		"while i < 200000\n"
+		"s = s + \"item, \"\n"
+		"i = i + 1\n"
+		"end while\n"
+		"s = s - \"item, \"\n");
+
+	benchRunScript("repeat",
+		"i = 0\n"
+		"while i < 200000\n"
+		"s = \"item, \" * 1000\n"
+		"i = i + 1\n"
+		"end while\n");
+
+	return 0;
+}
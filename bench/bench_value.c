@@ -0,0 +1,86 @@
+// measures how the size of ms_Value affects stack-heavy and map-heavy work.
+// compare a plain build against `make bench release=1 features=MS_NAN_BOXING`
+
+#include "bench.h"
+
+#include "ms_map.h"
+#include "ms_object.h"
+#include "ms_vm.h"
+
+#define STACK_DEPTH 200
+#define STACK_ITERATIONS 20000
+
+#define MAP_KEYS 50000
+#define MAP_ROUNDS 20
+
+static void stackHeavy(void)
+{
+	BenchSource src = {0};
+
+	// every nested group keeps its left operand on the stack,
+	// so each iteration walks STACK_DEPTH slots up and back down
+	benchAppend(&src, "i = 0\nwhile i < %d\n  x = ", STACK_ITERATIONS);
+	for (int d = 0; d < STACK_DEPTH; d++) benchAppend(&src, "1 + (");
+	benchAppend(&src, "1");
+	for (int d = 0; d < STACK_DEPTH; d++) benchAppend(&src, ")");
+	benchAppend(&src, "\n  i = i + 1\nend while\n");
+
+	benchRunScript("stack-heavy", src.data);
+	benchFreeSource(&src);
+}
+
+static void mapHeavy(void)
+{
+	ms_VM *vm = ms_newVM(NULL);
+	// the keys below are only referenced from C, keep the collector away from them
+	ms_setGCMinThreshold(vm, SIZE_MAX);
+	ms_Map map;
+	ms_initMap(vm, &map);
+
+	ms_Value *keys = malloc(sizeof(ms_Value) * MAP_KEYS);
+	char name[32];
+	for (int i = 0; i < MAP_KEYS; i++)
+	{
+		int len = sprintf(name, "key%d", i);
+		keys[i] = MS_FROM_OBJ(ms_copyString(vm, name, len));
+	}
+
+	double start = benchSeconds();
+	double sum = 0;
+	for (int r = 0; r < MAP_ROUNDS; r++)
+	{
+		for (int i = 0; i < MAP_KEYS; i++)
+			ms_setMapKey(vm, &map, keys[i], MS_FROM_NUM(i + r));
+
+		for (int i = 0; i < MAP_KEYS; i++)
+		{
+			ms_Value val;
+			if (ms_getMapKey(vm, &map, keys[i], &val)) sum += MS_TO_NUM(val);
+		}
+	}
+	double elapsed = benchSeconds() - start;
+
+	printf("%-24s %8.3f ms (checksum %g)\n", "map-heavy", elapsed * 1000, sum);
+	printf("%-24s %8zu KB\n", "map table footprint", map.cap * (sizeof(ms_MapEntry) + 1) / 1024);
+
+	free(keys);
+	ms_freeMap(vm, &map);
+	ms_freeVM(vm);
+}
+
+int main(void)
+{
+#ifdef MS_NAN_BOXING
+	printf("value representation: NaN-boxed\n");
+#else
+	printf("value representation: tagged struct\n");
+#endif
+	printf("%-24s %8zu bytes\n", "sizeof(ms_Value)", sizeof(ms_Value));
+	printf("%-24s %8zu bytes\n", "sizeof(ms_MapEntry)", sizeof(ms_MapEntry));
+	printf("%-24s %8zu bytes\n", "sizeof(ms_VM)", sizeof(ms_VM));
+	printf("%-24s %8zu bytes\n", "initial value stack", MS_INITIAL_STACK_SIZE * sizeof(ms_Value));
+
+	stackHeavy();
+	mapHeavy();
+	return 0;
+}
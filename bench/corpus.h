@@ -0,0 +1,90 @@
+#ifndef MS_BENCH_CORPUS_H
+#define MS_BENCH_CORPUS_H
+
+// a small corpus of scripts shaped like the workloads we care about.
+// benchmarks that compare dispatch or code generation strategies run these
+
+typedef struct {
+	const char *name;
+	const char *source;
+} BenchScript;
+
+static const BenchScript benchCorpus[] = {
+	{ "global-loop",
+		"i = 0\n"
+		"acc = 0\n"
+		"while i < 1000000\n"
+		"  acc = acc + i * 2 - 1\n"
+		"  i = i + 1\n"
+		"end while\n"
+	},
+	{ "local-loop",
+		"f = function\n"
+		"  i = 0\n"
+		"  acc = 0\n"
+		"  while i < 1000000\n"
+		"    acc = acc + i * 2 - 1\n"
+		"    i = i + 1\n"
+		"  end while\n"
+		"  return acc\n"
+		"end function\n"
+		"result = f\n"
+	},
+	{ "branchy",
+		"f = function\n"
+		"  i = 0\n"
+		"  hits = 0\n"
+		"  while i < 500000\n"
+		"    if i % 3 == 0 then\n"
+		"      hits = hits + 1\n"
+		"    end if\n"
+		"    if i % 5 == 0 and i % 7 != 0 then\n"
+		"      hits = hits + 2\n"
+		"    end if\n"
+		"    i = i + 1\n"
+		"  end while\n"
+		"  return hits\n"
+		"end function\n"
+		"result = f\n"
+	},
+	{ "calls",
+		"step = function\n"
+		"  return 3\n"
+		"end function\n"
+		"i = 0\n"
+		"acc = 0\n"
+		"while i < 300000\n"
+		"  acc = acc + step\n"
+		"  i = i + 1\n"
+		"end while\n"
+	},
+	{ "tail-recursion",
+		"count = function(n, acc)\n"
+		"  if n == 0 then\n"
+		"    return acc\n"
+		"  end if\n"
+		"  return count(n - 1, acc + n)\n"
+		"end function\n"
+		"result = count(300000, 0)\n"
+	},
+	{ "nested-loops",
+		"f = function\n"
+		"  total = 0\n"
+		"  i = 0\n"
+		"  while i < 1000\n"
+		"    j = 0\n"
+		"    while j < 500\n"
+		"      total = total + (i - j) * (i + j) / 2\n"
+		"      j = j + 1\n"
+		"    end while\n"
+		"    i = i + 1\n"
+		"  end while\n"
+		"  return total\n"
+		"end function\n"
+		"result = f\n"
+	},
+};
+
+#define BENCH_CORPUS_SIZE (sizeof benchCorpus / sizeof *benchCorpus)
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef MS_BENCH_OLD_MAP_H
+#define MS_BENCH_OLD_MAP_H
+
+// the map as it was before the swiss table (linear probing, `%` on every
+// step, a used flag in every entry), kept around to benchmark against.
+// its load factor is a variable so both maps can be compared at the same one
+
+#include <string.h>
+
+#include "ms_common.h"
+#include "ms_hash.h"
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_value.h"
+
+typedef struct {
+	ms_Value key, value;
+	bool _isUsed;
+} OldMapEntry;
+
+typedef struct {
+	size_t cap, count;
+	OldMapEntry *entries;
+} OldMap;
+
+static double oldMaxLoad = 0.75;
+
+static void oldInitMap(ms_VM* vm, OldMap *map)
+{
+	MS_UNUSED(vm);
+	map->count = map->cap = 0;
+	map->entries = NULL;
+}
+
+static void oldFreeMap(ms_VM* vm, OldMap *map)
+{
+	MS_MEM_FREE_ARR(vm, OldMapEntry, map->entries, map->cap);
+	oldInitMap(vm, map);
+}
+
+static OldMapEntry *oldFindEntry(OldMapEntry *entries, size_t cap, ms_Value key)
+{
+	uint32_t index;
+
+	if (MS_OBJ_TYPE(key) == MS_OBJ_STRING)
+		index = MS_TO_STRING(key)->hash;
+	else
+		// TODO: cache hash somehow
+		index = ms_hashMem(MS_TO_OBJ(key), sizeof(ms_Object*), 0);
+
+	index %= cap;
+
+	OldMapEntry *tombstone = NULL;
+	for (;;)
+	{
+		OldMapEntry *entry = entries + index;
+
+		if (!entry->_isUsed)
+			if (MS_IS_NULL(entry->value))
+				return tombstone != NULL ? tombstone : entry;
+			else
+			{
+				if (tombstone == NULL) tombstone = entry;
+			}
+		else if (ms_valuesEqual(entry->key, key))
+			return entry;
+
+		index = (index + 1) % cap;
+	}
+}
+
+static void oldAdjustCapacity(ms_VM *vm, OldMap *map, size_t cap)
+{
+	OldMapEntry *entries = MS_MEM_MALLOC_ARR(vm, OldMapEntry, cap);
+
+	for (size_t i = 0; i < cap; i++)
+	{
+		entries[i].key = MS_NULL_VAL;
+		entries[i].value = MS_NULL_VAL;
+		entries[i]._isUsed = false;
+	}
+
+	map->count = 0;
+	for (size_t i = 0; i < map->cap; i++)
+	{
+		OldMapEntry* entry = map->entries + i;
+		if (!entry->_isUsed) continue;
+
+		OldMapEntry *dest = oldFindEntry(entries, cap, entry->key);
+		dest->key = entry->key;
+		dest->value = entry->value;
+		dest->_isUsed = true;
+		map->count++;
+	}
+
+	MS_MEM_FREE_ARR(vm, OldMapEntry, map->entries, map->cap);
+	map->entries = entries;
+	map->cap = cap;
+}
+
+static bool oldSetMapKey(ms_VM* vm, OldMap *map, ms_Value key, ms_Value value)
+{
+	if (map->count + 1 > map->cap * oldMaxLoad)
+	{
+		size_t cap = MS_ARR_GROW_CAP(map->cap);
+		oldAdjustCapacity(vm, map, cap);
+	}
+
+	OldMapEntry *entry = oldFindEntry(map->entries, map->cap, key);
+	bool newKey = !entry->_isUsed;
+	if (newKey && MS_IS_NULL(entry->value)) map->count++;
+
+	entry->key = key;
+	entry->value = value;
+	entry->_isUsed = true;
+	return newKey;
+}
+
+static bool oldGetMapKey(ms_VM *vm, OldMap *map, ms_Value key, ms_Value *value)
+{
+	MS_UNUSED(vm);
+	if (map->count == 0) return false;
+
+	OldMapEntry *entry = oldFindEntry(map->entries, map->cap, key);
+	if (!entry->_isUsed) return false;
+
+	*value = entry->value;
+	return true;
+}
+
+static bool oldDeleteFromMap(ms_VM *vm, OldMap *map, ms_Value key)
+{
+	MS_UNUSED(vm);
+	if (map->count == 0) return false;
+
+	OldMapEntry *entry = oldFindEntry(map->entries, map->cap, key);
+	if (!entry->_isUsed) return false;
+
+	entry->_isUsed = false;
+	entry->value = MS_FROM_NUM(1);
+	return true;
+}
+
+#endif
@@ -1,13 +1,53 @@
+// for mkdir and getpid, has to come before any system header
+#define _POSIX_C_SOURCE 200809L
+
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <inttypes.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define makeDirectory(path) _mkdir(path)
+#define processId() _getpid()
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define makeDirectory(path) mkdir(path, 0755)
+#define processId() getpid()
+#endif
 
 #include "miniscript.h"
 
+// scripts run from a file are compiled once and cached as bytecode in
+// CACHE_DIR next to them, or in the directory CACHE_ENV names. setting
+// it to nothing turns the cache off
+#define CACHE_DIR ".mscache"
+#define CACHE_ENV "MINISCRIPT_CACHE"
+
+// the makefile passes a checksum of every source file the interpreter is
+// built from, and rebuilds this file when any of them changes. builds
+// without it fall back to when this file was compiled
+#ifndef MS_SOURCE_ID
+#define MS_SOURCE_ID __DATE__ " " __TIME__
+#endif
+
+// cached scripts are only looked up by the interpreter that saved them:
+// the same sources, and the same features changing what the compiler emits
+static const char buildId[] = "miniscript " MS_SOURCE_ID
+#ifdef MS_NO_PEEPHOLE
+	" MS_NO_PEEPHOLE"
+#endif
+	;
+
 static char buffer[1024];
 
 static void repl(ms_VM *vm)
 {
+	// every line is run once, there's nothing to gain
+	ms_setOptimizingCompiler(vm, false);
+
 	for (;;)
 	{
 		printf("> ");
@@ -21,7 +61,7 @@ static void repl(ms_VM *vm)
 	}
 }
 
-static void runFile(ms_VM *vm, char *path)
+static char *readFile(const char *path)
 {
 	FILE *fp = fopen(path, "rb");
 	if (fp == NULL)
@@ -47,27 +87,149 @@ static void runFile(ms_VM *vm, char *path)
 		exit(-1);
 	}
 
+	fclose(fp);
 	source[size] = '\0';
-	ms_interpretString(vm, source);
+	return source;
+}
+
+// FNV-1a, continuing from `hash`
+static uint64_t hashString(uint64_t hash, const char *str)
+{
+	for (const char *c = str; *c != '\0'; c++)
+	{
+		hash ^= (uint8_t)*c;
+		hash *= UINT64_C(0x100000001b3);
+	}
+	return hash;
+}
+
+// the build, then the source, so that a script compiled by any other
+// interpreter is never looked up
+static uint64_t hashSource(const char *source)
+{
+	uint64_t hash = UINT64_C(0xcbf29ce484222325) ^ MS_BYTECODE_VERSION;
+	return hashString(hashString(hash, buildId), source);
+}
+
+// NULL if the cache is turned off
+static char *cachePath(const char *path, const char *source)
+{
+	const char *env = getenv(CACHE_ENV);
+	if (env != NULL && *env == '\0') return NULL;
+
+	size_t dirLength;
+	if (env != NULL) dirLength = strlen(env);
+	else
+	{
+		const char *slash = strrchr(path, '/');
+		dirLength = (slash != NULL ? (size_t)(slash - path) + 1 : 0) + strlen(CACHE_DIR);
+	}
+
+	// the directory, a slash, 16 hex digits, ".msc" and the terminator
+	char *cached = malloc(dirLength + 22);
+	if (cached == NULL)
+	{
+		fprintf(stderr, "couldn't allocate enough memory\n");
+		exit(-1);
+	}
+
+	if (env != NULL) memcpy(cached, env, dirLength);
+	else
+	{
+		size_t prefix = dirLength - strlen(CACHE_DIR);
+		memcpy(cached, path, prefix);
+		memcpy(cached + prefix, CACHE_DIR, strlen(CACHE_DIR));
+	}
+	cached[dirLength] = '\0';
+	// fails if it's already there, and if it couldn't be made saving says so
+	makeDirectory(cached);
+
+	sprintf(cached + dirLength, "/%016" PRIx64 ".msc", hashSource(source));
+	return cached;
+}
+
+static void runFile(ms_VM *vm, char *path)
+{
+	// scripts saved with -c run straight from the file
+	if (ms_isBytecodeFile(path))
+	{
+		if (ms_interpretBytecode(vm, path) == MS_INTERPRET_COMPILE_ERROR)
+			fprintf(stderr, "%s isn't a valid bytecode file for this version\n", path);
+		return;
+	}
+
+	char *source = readFile(path);
+	char *cached = cachePath(path, source);
+
+	// a cached file that can't be loaded is quietly compiled and saved
+	// over again, it's only a compile error if the source is one
+	if (cached == NULL)
+		ms_interpretString(vm, source);
+	else if (!ms_isBytecodeFile(cached) || ms_interpretBytecode(vm, cached) == MS_INTERPRET_COMPILE_ERROR)
+	{
+		// saved under a name of its own first, so that another run of the
+		// same script never loads a half written file
+		char *saving = malloc(strlen(cached) + 24);
+		if (saving == NULL)
+		{
+			fprintf(stderr, "couldn't allocate enough memory\n");
+			exit(-1);
+		}
+		sprintf(saving, "%s.%ld", cached, (long)processId());
+
+		ms_InterpretResult res = ms_interpretStringAndSave(vm, source, saving);
+		if (res == MS_INTERPRET_COMPILE_ERROR || rename(saving, cached) != 0) remove(saving);
+		free(saving);
+	}
+
+	free(cached);
+	free(source);
+}
+
+// `out` defaults to the script's path with its extension swapped for .msc
+static int compileFile(ms_VM *vm, char *path, char *out)
+{
+	char *defaultOut = NULL;
+	if (out == NULL)
+	{
+		size_t length = strlen(path);
+		const char *dot = strrchr(path, '.');
+		if (dot != NULL && strchr(dot, '/') == NULL) length = (size_t)(dot - path);
+
+		defaultOut = malloc(length + sizeof ".msc");
+		if (defaultOut == NULL)
+		{
+			fprintf(stderr, "couldn't allocate enough memory\n");
+			exit(-1);
+		}
+		memcpy(defaultOut, path, length);
+		strcpy(defaultOut + length, ".msc");
+		out = defaultOut;
+	}
+
+	char *source = readFile(path);
+	bool ok = ms_compileToBytecode(vm, source, out);
 	free(source);
+	free(defaultOut);
+	return ok ? 0 : 1;
 }
 
 int main(int argc, char *argv[])
 {
 	ms_VM *vm = ms_newVM(NULL);
+	int status = 0;
 
 	if (argc == 1)
 		repl(vm);
+	else if (argc == 2 && !strcmp(argv[1], "--test"))
+		ms_runTestProgram(vm);
 	else if (argc == 2)
-	{
-		if (!strcmp(argv[1], "--test"))
-			ms_runTestProgram(vm);
-		else
-			runFile(vm, argv[1]);
-	}
+		runFile(vm, argv[1]);
+	else if ((argc == 3 || argc == 4) && !strcmp(argv[1], "-c"))
+		status = compileFile(vm, argv[2], argc == 4 ? argv[3] : NULL);
 	else
-		fprintf(stderr, "usage: %s [script]", argv[0]);
+		fprintf(stderr, "usage: %s [script]\n       %s -c script [output]", argv[0], argv[0]);
 
 	ms_freeVM(vm);
-	return 0;
+	return status;
 }
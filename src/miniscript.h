@@ -4,7 +4,9 @@
 // this is intended to be the public API's header file.
 // it's a bit, uhm... lacking atm...
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct ms_VM ms_VM;
 
@@ -16,10 +18,68 @@ typedef enum {
 	MS_INTERPRET_RUNTIME_ERROR,
 } ms_InterpretResult;
 
+typedef struct {
+	size_t cycles;
+	// size of the heap before and after the last cycle, in bytes
+	size_t bytesBefore, bytesAfter;
+	// pause times, in seconds
+	double lastPause, maxPause, totalPause;
+
+	// same as above, for collections of the nursery only
+	size_t minorCycles, bytesPromoted;
+	double lastMinorPause, maxMinorPause, totalMinorPause;
+} ms_GCStats;
+
 ms_VM *ms_newVM(ms_ReallocFn reallocFn);
 void ms_freeVM(ms_VM *vm);
 
+// how many calls can be nested before a stack overflow error (1024 by default)
+void ms_setMaxCallDepth(ms_VM *vm, int depth);
+// every VM picks its own seed for hashing strings; this fixes it instead,
+// e.g. to get the same hashes on every run. has to be called before any string exists
+void ms_setHashSeed(ms_VM *vm, uint64_t seed);
+// after compiling, drop code that can't run, thread jumps through each
+// other, and get rid of copies and stores to locals nobody reads. on by
+// default; worth turning off where compiling has to be quick, like the REPL
+void ms_setOptimizingCompiler(ms_VM *vm, bool enable);
+
+void ms_collectGarbage(ms_VM *vm);
+// the heap may grow up to `factor` times its live size before the next collection
+void ms_setGCGrowthFactor(ms_VM *vm, double factor);
+// no collection will happen while the heap is smaller than `bytes`
+void ms_setGCMinThreshold(ms_VM *vm, size_t bytes);
+const ms_GCStats *ms_getGCStats(ms_VM *vm);
+
+typedef struct {
+	size_t blockSize;
+	// blocks handed out, and blocks in every page of this class
+	size_t blocksUsed, blocksTotal;
+	// what was actually asked for out of the blocks in use
+	size_t bytesRequested;
+} ms_SlabStats;
+
+// serve small allocations from per-size-class pages instead of calling
+// reallocFn for each one. has to be picked before the VM allocates anything
+void ms_useSlabAllocator(ms_VM *vm, bool enable);
+// fills up to `max` entries, one per size class, and returns how many it filled
+size_t ms_getSlabStats(ms_VM *vm, ms_SlabStats *stats, size_t max);
+void ms_printSlabReport(ms_VM *vm);
+
 ms_InterpretResult ms_interpretString(ms_VM *vm, char *str);
+// bumped whenever the bytecode file format or the opcodes change
+#define MS_BYTECODE_VERSION 1
+
+// compiles the script and saves it to `path` instead of running it,
+// false if it didn't compile or couldn't be saved
+bool ms_compileToBytecode(ms_VM *vm, char *str, const char *path);
+// runs a script saved by ms_compileToBytecode. a file that can't be
+// loaded counts as a compile error, and isn't reported
+ms_InterpretResult ms_interpretBytecode(ms_VM *vm, const char *path);
+// ms_interpretString, saving the script to `path` once it's compiled and
+// before it runs. it still runs, without a word, if it couldn't be saved
+ms_InterpretResult ms_interpretStringAndSave(ms_VM *vm, char *str, const char *path);
+// whether the file starts like a saved script, without loading it
+bool ms_isBytecodeFile(const char *path);
 
 void ms_runTestProgram(ms_VM *vm);
 
@@ -0,0 +1,725 @@
+// for mmap and friends, has to come before any system header
+#define _POSIX_C_SOURCE 200809L
+
+#include "ms_bytecode.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ms_code.h"
+#include "ms_list.h"
+#include "ms_map.h"
+#include "ms_mem.h"
+#include "ms_vm.h"
+
+#if !defined(MS_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define MS_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define MAGIC "MSBC"
+// reads back differently on a machine with another byte order
+#define BYTE_ORDER_MARK 0x01020304u
+#define ALIGNMENT 8
+
+typedef struct {
+	char magic[4];
+	uint32_t version, byteOrder;
+	uint32_t stringCount, charCount;
+	uint32_t globalCount, functionCount;
+	uint32_t padding;
+	// of the whole file, to catch truncated ones
+	uint64_t size;
+} FileHeader;
+
+// where a string's characters are, after the table
+typedef struct {
+	uint32_t offset, length;
+} FileString;
+
+typedef struct {
+	uint32_t arity, maxStack;
+	uint32_t codeLength, lineCount, constantCount;
+	uint32_t padding;
+} FileFunction;
+
+enum { CONST_NULL, CONST_NUMBER, CONST_STRING, CONST_FUNCTION };
+
+// strings and functions are indices into the string table and into the
+// functions saved before this one
+typedef struct {
+	uint32_t type, index;
+	double number;
+} FileConstant;
+
+typedef struct ms_Mapping {
+	struct ms_Mapping *next;
+	uint8_t *data;
+	size_t size;
+} ms_Mapping;
+
+typedef struct {
+	ms_VM *vm;
+	// everything that goes in the file, with maps back to their positions
+	ms_ObjString **strings;
+	size_t stringCount, stringCap;
+	ms_Map stringIndex;
+	ms_ObjFunction **functions;
+	size_t functionCount, functionCap;
+	ms_Map functionIndex;
+	bool failed;
+
+	uint8_t *data;
+	size_t size, cap;
+} Writer;
+
+static uint32_t addString(Writer *w, ms_ObjString *str)
+{
+	ms_Value index;
+	if (ms_getMapKey(w->vm, &w->stringIndex, MS_FROM_OBJ(str), &index))
+		return (uint32_t)MS_TO_NUM(index);
+
+	if (w->stringCount == w->stringCap)
+	{
+		size_t oldCap = w->stringCap;
+		w->stringCap = MS_ARR_GROW_CAP(oldCap);
+		w->strings = MS_MEM_REALLOC_ARR(w->vm, ms_ObjString*, w->strings, oldCap, w->stringCap);
+	}
+	w->strings[w->stringCount] = str;
+	ms_setMapKey(w->vm, &w->stringIndex, MS_FROM_OBJ(str), MS_FROM_NUM(w->stringCount));
+	return (uint32_t)w->stringCount++;
+}
+
+// post-order, so that a function's constants can only refer to ones loaded before it
+static void addFunction(Writer *w, ms_ObjFunction *function)
+{
+	ms_Value index;
+	if (ms_getMapKey(w->vm, &w->functionIndex, MS_FROM_OBJ(function), &index)) return;
+
+	ms_List *constants = &function->code.constants;
+	for (size_t i = 0; i < constants->count; i++)
+	{
+		ms_Value constant = constants->data[i];
+		if (MS_IS_FUNCTION(constant)) addFunction(w, MS_TO_FUNCTION(constant));
+		else if (MS_IS_STRING(constant)) addString(w, MS_TO_STRING(constant));
+		else if (!MS_IS_NULL(constant) && !MS_IS_NUM(constant)) w->failed = true;
+	}
+
+	if (w->functionCount == w->functionCap)
+	{
+		size_t oldCap = w->functionCap;
+		w->functionCap = MS_ARR_GROW_CAP(oldCap);
+		w->functions = MS_MEM_REALLOC_ARR(w->vm, ms_ObjFunction*, w->functions, oldCap, w->functionCap);
+	}
+	w->functions[w->functionCount] = function;
+	ms_setMapKey(w->vm, &w->functionIndex, MS_FROM_OBJ(function), MS_FROM_NUM(w->functionCount));
+	w->functionCount++;
+}
+
+// returns where the bytes went, since they may be fixed up afterwards
+static size_t writeBytes(Writer *w, const void *bytes, size_t size)
+{
+	if (w->size + size > w->cap)
+	{
+		size_t oldCap = w->cap;
+		while (w->size + size > w->cap) w->cap = MS_ARR_GROW_CAP(w->cap);
+		w->data = MS_MEM_REALLOC_ARR(w->vm, uint8_t, w->data, oldCap, w->cap);
+	}
+
+	size_t at = w->size;
+	if (size != 0) memcpy(w->data + at, bytes, size);
+	w->size += size;
+	return at;
+}
+
+static void writeAlign(Writer *w)
+{
+	static const uint8_t zeros[ALIGNMENT] = {0};
+	if (w->size % ALIGNMENT != 0) writeBytes(w, zeros, ALIGNMENT - w->size % ALIGNMENT);
+}
+
+static void writeFunction(Writer *w, ms_ObjFunction *function)
+{
+	ms_Code *code = &function->code;
+	FileFunction header = {
+		.arity = (uint32_t)function->arity,
+		.maxStack = (uint32_t)function->maxStack,
+		.codeLength = (uint32_t)code->count,
+		.lineCount = (uint32_t)code->lineCount,
+		.constantCount = (uint32_t)code->constants.count,
+	};
+	writeBytes(w, &header, sizeof header);
+	writeBytes(w, code->lines, code->lineCount * sizeof *code->lines);
+
+	for (size_t i = 0; i < code->constants.count; i++)
+	{
+		ms_Value value = code->constants.data[i];
+		FileConstant constant = {0};
+		ms_Value index;
+
+		if (MS_IS_NUM(value))
+		{
+			constant.type = CONST_NUMBER;
+			constant.number = MS_TO_NUM(value);
+		}
+		else if (MS_IS_STRING(value))
+		{
+			constant.type = CONST_STRING;
+			ms_getMapKey(w->vm, &w->stringIndex, value, &index);
+			constant.index = (uint32_t)MS_TO_NUM(index);
+		}
+		else if (MS_IS_FUNCTION(value))
+		{
+			constant.type = CONST_FUNCTION;
+			ms_getMapKey(w->vm, &w->functionIndex, value, &index);
+			constant.index = (uint32_t)MS_TO_NUM(index);
+		}
+		else constant.type = CONST_NULL;
+
+		writeBytes(w, &constant, sizeof constant);
+	}
+
+	// quickening is undone, the file shouldn't depend on what already ran
+	size_t at = writeBytes(w, code->data, code->count);
+	for (size_t i = 0; i < code->count; i += 1 + ms_opcodeInfo[code->data[i]].operandBytes)
+		w->data[at + i] = (uint8_t)ms_genericOpcode(code->data[i]);
+	writeAlign(w);
+}
+
+bool ms_saveBytecode(ms_VM *vm, ms_ObjFunction *script, const char *path)
+{
+	bool wasPaused = vm->gcPaused;
+	vm->gcPaused = true;
+
+	Writer w = { .vm = vm };
+	ms_initMap(vm, &w.stringIndex);
+	ms_initMap(vm, &w.functionIndex);
+
+	// every global this VM knows of, by slot, since that's what the code refers to
+	size_t globalCount = vm->globalValues.count;
+	uint32_t *globals = MS_MEM_MALLOC_ARR(vm, uint32_t, globalCount);
+	for (size_t i = 0; i < vm->globalNames.cap; i++)
+	{
+		if (!ms_isMapSlotUsed(&vm->globalNames, i)) continue;
+		ms_MapEntry *entry = vm->globalNames.entries + i;
+		globals[(size_t)MS_TO_NUM(entry->value)] = addString(&w, MS_TO_STRING(entry->key));
+	}
+
+	addFunction(&w, script);
+
+	bool ok = !w.failed;
+	if (ok)
+	{
+		FileHeader header = {
+			.version = MS_BYTECODE_VERSION,
+			.byteOrder = BYTE_ORDER_MARK,
+			.stringCount = (uint32_t)w.stringCount,
+			.globalCount = (uint32_t)globalCount,
+			.functionCount = (uint32_t)w.functionCount,
+		};
+		memcpy(header.magic, MAGIC, sizeof header.magic);
+		for (size_t i = 0; i < w.stringCount; i++) header.charCount += (uint32_t)w.strings[i]->length;
+		writeBytes(&w, &header, sizeof header);
+
+		uint32_t offset = 0;
+		for (size_t i = 0; i < w.stringCount; i++)
+		{
+			FileString str = { offset, (uint32_t)w.strings[i]->length };
+			writeBytes(&w, &str, sizeof str);
+			offset += str.length;
+		}
+		for (size_t i = 0; i < w.stringCount; i++)
+			writeBytes(&w, w.strings[i]->chars, w.strings[i]->length);
+		writeAlign(&w);
+
+		writeBytes(&w, globals, globalCount * sizeof *globals);
+		writeAlign(&w);
+
+		for (size_t i = 0; i < w.functionCount; i++) writeFunction(&w, w.functions[i]);
+
+		uint64_t size = w.size;
+		memcpy(w.data + offsetof(FileHeader, size), &size, sizeof size);
+
+		FILE *fp = fopen(path, "wb");
+		if (fp == NULL) ok = false;
+		else
+		{
+			if (fwrite(w.data, 1, w.size, fp) != w.size) ok = false;
+			if (fclose(fp) != 0) ok = false;
+		}
+	}
+
+	MS_MEM_FREE_ARR(vm, uint8_t, w.data, w.cap);
+	MS_MEM_FREE_ARR(vm, uint32_t, globals, globalCount);
+	MS_MEM_FREE_ARR(vm, ms_ObjString*, w.strings, w.stringCap);
+	MS_MEM_FREE_ARR(vm, ms_ObjFunction*, w.functions, w.functionCap);
+	ms_freeMap(vm, &w.stringIndex);
+	ms_freeMap(vm, &w.functionIndex);
+	vm->gcPaused = wasPaused;
+	return ok;
+}
+
+static ms_Mapping *mapFile(ms_VM *vm, const char *path)
+{
+	ms_Mapping *mapping = MS_MEM_MALLOC(vm, sizeof *mapping);
+	mapping->next = NULL;
+	mapping->data = NULL;
+
+#ifdef MS_USE_MMAP
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		mapping->size = (size_t)st.st_size;
+		// private and writable, so that quickening and fixing up global
+		// slots only ever copy the pages they touch
+		void *data = mmap(NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) mapping->data = data;
+	}
+	if (fd >= 0) close(fd);
+#else
+	FILE *fp = fopen(path, "rb");
+	if (fp != NULL)
+	{
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		rewind(fp);
+		if (size > 0)
+		{
+			mapping->size = (size_t)size;
+			mapping->data = MS_MEM_MALLOC(vm, mapping->size);
+			if (fread(mapping->data, 1, mapping->size, fp) != mapping->size)
+			{
+				MS_MEM_FREE(vm, mapping->data, mapping->size);
+				mapping->data = NULL;
+			}
+		}
+		fclose(fp);
+	}
+#endif
+
+	if (mapping->data == NULL)
+	{
+		MS_MEM_FREE(vm, mapping, sizeof *mapping);
+		return NULL;
+	}
+	return mapping;
+}
+
+static void unmapFile(ms_VM *vm, ms_Mapping *mapping)
+{
+#ifdef MS_USE_MMAP
+	munmap(mapping->data, mapping->size);
+#else
+	MS_MEM_FREE(vm, mapping->data, mapping->size);
+#endif
+	MS_MEM_FREE(vm, mapping, sizeof *mapping);
+}
+
+typedef struct {
+	uint8_t *data;
+	size_t size, pos;
+} Reader;
+
+// NULL if there aren't that many bytes left
+static uint8_t *take(Reader *r, size_t size)
+{
+	if (size > r->size - r->pos) return NULL;
+	uint8_t *bytes = r->data + r->pos;
+	r->pos += size;
+	return bytes;
+}
+
+static void readAlign(Reader *r)
+{
+	size_t padding = (ALIGNMENT - r->pos % ALIGNMENT) % ALIGNMENT;
+	r->pos = padding > r->size - r->pos ? r->size : r->pos + padding;
+}
+
+// `globals` maps the slots in the file to the ones in this VM
+static bool checkCode(ms_Code *code, const int *globals, size_t globalCount)
+{
+	uint8_t *data = code->data;
+	size_t count = code->count;
+
+	for (size_t i = 0; i < count; )
+	{
+		ms_Opcode op = data[i];
+		if (op >= MS_OP__END) return false;
+		size_t length = 1 + ms_opcodeInfo[op].operandBytes;
+		if (length > count - i) return false;
+
+		size_t operand = 0;
+		for (size_t b = 1; b < length; b++) operand = operand << 8 | data[i + b];
+		size_t next = i + length;
+
+		switch (op)
+		{
+			case MS_OP_CONST:
+			case MS_OP_CONST_LONG:
+			case MS_OP_ADD_CONST:
+			case MS_OP_ADD_CONST_NUM:
+				if (operand >= code->constants.count) return false;
+				break;
+
+			case MS_OP_SET_GLOBAL:
+			case MS_OP_GET_GLOBAL:
+			case MS_OP_GET_GLOBAL_INVOKE:
+				if (operand >= globalCount) return false;
+				if ((size_t)globals[operand] != operand)
+				{
+					data[i + 1] = (uint8_t)(globals[operand] >> 8);
+					data[i + 2] = (uint8_t)globals[operand];
+				}
+				break;
+
+			case MS_OP_JUMP:
+			case MS_OP_JUMP_IF_FALSE:
+			case MS_OP_FOR_ITER:
+			case MS_OP_JUMP_LONG:
+			case MS_OP_JUMP_IF_FALSE_LONG:
+			case MS_OP_FOR_ITER_LONG:
+			case MS_OP_POP_JUMP_IF_FALSE:
+			case MS_OP_LESS_JUMP_IF_FALSE:
+			case MS_OP_LESS_NUM_JUMP_IF_FALSE:
+				if (operand > count - next) return false;
+				break;
+
+			case MS_OP_LOOP:
+			case MS_OP_LOOP_LONG:
+				if (operand > next) return false;
+				break;
+
+			default: break;
+		}
+
+		i = next;
+	}
+
+	// the line runs are binary searched, they have to start at the beginning and go up
+	if (count != 0 && (code->lineCount == 0 || code->lines[0].offset != 0)) return false;
+	for (size_t i = 1; i < code->lineCount; i++)
+		if (code->lines[i].offset <= code->lines[i - 1].offset) return false;
+
+	return true;
+}
+
+// how many values off the top of the stack an instruction reads,
+// whether it pops them or not
+static size_t stackReads(ms_Opcode op, size_t operand)
+{
+	switch (op)
+	{
+		case MS_OP_INVOKE:
+		case MS_OP_TAIL_INVOKE: return operand + 1;
+		case MS_OP_BUILD_LIST:  return operand;
+		case MS_OP_BUILD_MAP:   return 2 * operand;
+
+		case MS_OP_SET_INDEX:
+		case MS_OP_SLICE:
+			return 3;
+
+		case MS_OP_ADD:
+		case MS_OP_SUBTRACT:
+		case MS_OP_MULTIPLY:
+		case MS_OP_DIVIDE:
+		case MS_OP_POWER:
+		case MS_OP_MODULO:
+		case MS_OP_EQUAL:
+		case MS_OP_NOT_EQUAL:
+		case MS_OP_LESS:
+		case MS_OP_LESS_EQUAL:
+		case MS_OP_GREATER:
+		case MS_OP_GREATER_EQUAL:
+		case MS_OP_AND:
+		case MS_OP_OR:
+		case MS_OP_GET_INDEX:
+		case MS_OP_LESS_JUMP_IF_FALSE:
+		// the sequence and the position
+		case MS_OP_FOR_ITER:
+		case MS_OP_FOR_ITER_LONG:
+			return 2;
+
+		case MS_OP_NEGATE:
+		case MS_OP_SQUARE:
+		case MS_OP_NOT:
+		case MS_OP_SET_GLOBAL:
+		case MS_OP_SET_LOCAL:
+		case MS_OP_POP:
+		case MS_OP_RETURN:
+		case MS_OP_JUMP_IF_FALSE:
+		case MS_OP_JUMP_IF_FALSE_LONG:
+		case MS_OP_POP_JUMP_IF_FALSE:
+		case MS_OP_ADD_CONST:
+			return 1;
+
+		default: return 0;
+	}
+}
+
+// walks every path through the code like computeMaxStack in the compiler,
+// but to make sure that the file's code can't take more off the stack than
+// there is, grow it past maxStack, read a local that isn't there yet or run
+// off the end. paths that meet have to agree on how deep the stack is.
+// checkCode has already made sure that every instruction is whole
+static bool checkStack(ms_VM *vm, ms_Code *code, size_t arity, size_t maxStack)
+{
+	size_t count = code->count;
+	if (count == 0) return false;
+
+	// -2 for the bytes that don't start an instruction, -1 for the ones not reached yet
+	int *depths = MS_MEM_MALLOC_ARR(vm, int, count);
+	size_t *pending = MS_MEM_MALLOC_ARR(vm, size_t, count);
+	size_t pendingCount = 0;
+	bool ok = false;
+
+	for (size_t i = 0; i < count; )
+	{
+		size_t length = 1 + ms_opcodeInfo[code->data[i]].operandBytes;
+		depths[i++] = -1;
+		for (size_t b = 1; b < length; b++) depths[i++] = -2;
+	}
+
+#define VISIT(offset, d) do {                                   \
+    size_t o = (offset);                                        \
+    int v = (d);                                                \
+    if (o >= count || depths[o] == -2) goto done;               \
+    if (depths[o] == -1)                                        \
+    {                                                           \
+      depths[o] = v;                                            \
+      pending[pendingCount++] = o;                              \
+    }                                                           \
+    else if (depths[o] != v) goto done;                         \
+  } while(0)
+
+	VISIT(0, (int)arity + 1);
+
+	while (pendingCount > 0)
+	{
+		size_t offset = pending[--pendingCount];
+		uint8_t *ip = code->data + offset;
+		ms_Opcode op = ms_genericOpcode(*ip);
+		const ms_OpcodeInfo *info = &ms_opcodeInfo[op];
+
+		size_t operand = 0;
+		for (size_t b = 1; b <= info->operandBytes; b++) operand = operand << 8 | ip[b];
+		size_t next = offset + 1 + info->operandBytes;
+
+		int depth = depths[offset];
+		if ((size_t)depth < stackReads(op, operand)) goto done;
+
+		switch (op)
+		{
+			case MS_OP_GET_LOCAL:
+			case MS_OP_GET_LOCAL_INVOKE:
+				if (operand >= (size_t)depth) goto done;
+				break;
+
+			// the value's popped before it's stored
+			case MS_OP_SET_LOCAL:
+				if (operand >= (size_t)depth - 1) goto done;
+				break;
+
+			default: break;
+		}
+
+		depth += info->stackEffect;
+		if (op == MS_OP_INVOKE || op == MS_OP_TAIL_INVOKE) depth -= (int)operand;
+		if (op == MS_OP_BUILD_LIST) depth -= (int)operand;
+		if (op == MS_OP_BUILD_MAP) depth -= 2 * (int)operand;
+		if ((size_t)depth > maxStack) goto done;
+
+		switch (op)
+		{
+			case MS_OP_RETURN: break;
+
+			case MS_OP_JUMP:
+			case MS_OP_JUMP_LONG:
+				VISIT(next + operand, depth);
+				break;
+
+			case MS_OP_LOOP:
+			case MS_OP_LOOP_LONG:
+				VISIT(next - operand, depth);
+				break;
+
+			case MS_OP_JUMP_IF_FALSE:
+			case MS_OP_JUMP_IF_FALSE_LONG:
+			case MS_OP_POP_JUMP_IF_FALSE:
+			case MS_OP_LESS_JUMP_IF_FALSE:
+				VISIT(next + operand, depth);
+				VISIT(next, depth);
+				break;
+
+			// nothing's pushed when it jumps out of the loop
+			case MS_OP_FOR_ITER:
+			case MS_OP_FOR_ITER_LONG:
+				VISIT(next + operand, depth - 1);
+				VISIT(next, depth);
+				break;
+
+			default: VISIT(next, depth); break;
+		}
+	}
+
+#undef VISIT
+
+	ok = true;
+
+done:
+	MS_MEM_FREE_ARR(vm, size_t, pending, count);
+	MS_MEM_FREE_ARR(vm, int, depths, count);
+	return ok;
+}
+
+static ms_ObjFunction *loadFunctions(ms_VM *vm, Reader *r)
+{
+	FileHeader *header = (FileHeader*)take(r, sizeof *header);
+	if (header == NULL || memcmp(header->magic, MAGIC, sizeof header->magic) != 0) return NULL;
+	if (header->byteOrder != BYTE_ORDER_MARK || header->version != MS_BYTECODE_VERSION) return NULL;
+	if (header->size != r->size || header->functionCount == 0) return NULL;
+
+	FileString *table = (FileString*)take(r, header->stringCount * sizeof *table);
+	const char *chars = (const char*)take(r, header->charCount);
+	readAlign(r);
+	uint32_t *names = (uint32_t*)take(r, header->globalCount * sizeof *names);
+	readAlign(r);
+	if (table == NULL || chars == NULL || names == NULL) return NULL;
+	// checked before it's used to allocate anything
+	if (header->functionCount > (r->size - r->pos) / sizeof(FileFunction)) return NULL;
+
+	size_t stringCount = header->stringCount, globalCount = header->globalCount;
+	size_t functionCount = header->functionCount;
+	ms_ObjString **strings = MS_MEM_MALLOC_ARR(vm, ms_ObjString*, stringCount);
+	int *globals = MS_MEM_MALLOC_ARR(vm, int, globalCount);
+	ms_ObjFunction **functions = MS_MEM_MALLOC_ARR(vm, ms_ObjFunction*, functionCount);
+	ms_ObjFunction *script = NULL;
+
+	for (size_t i = 0; i < stringCount; i++)
+	{
+		if (table[i].offset > header->charCount || table[i].length > header->charCount - table[i].offset)
+			goto done;
+		strings[i] = ms_copyString(vm, chars + table[i].offset, table[i].length);
+	}
+
+	for (size_t i = 0; i < globalCount; i++)
+	{
+		if (names[i] >= stringCount) goto done;
+		globals[i] = ms_declareGlobal(vm, strings[names[i]]);
+		if (globals[i] > UINT16_MAX) goto done;
+	}
+
+	for (size_t f = 0; f < functionCount; f++)
+	{
+		FileFunction *info = (FileFunction*)take(r, sizeof *info);
+		if (info == NULL) goto done;
+		ms_LineRun *lines = (ms_LineRun*)take(r, info->lineCount * sizeof *lines);
+		FileConstant *constants = (FileConstant*)take(r, info->constantCount * sizeof *constants);
+		uint8_t *data = take(r, info->codeLength);
+		readAlign(r);
+		if (lines == NULL || constants == NULL || data == NULL) goto done;
+
+		// call() makes room for maxStack slots and then fills in the missing
+		// arguments, the callee and every parameter have to fit in them
+		if (info->arity > UINT8_MAX || info->arity + 1 > info->maxStack
+		 || info->maxStack > MS_MAX_STACK_SIZE(vm->maxFrames))
+			goto done;
+
+		ms_ObjFunction *function = functions[f] = ms_newFunction(vm);
+		function->arity = (int)info->arity;
+		function->maxStack = (int)info->maxStack;
+
+		// borrowed from the mapping, a zero capacity keeps ms_freeCode off them
+		ms_Code *code = &function->code;
+		code->data = data;
+		code->count = info->codeLength;
+		code->lines = lines;
+		code->lineCount = info->lineCount;
+
+		for (size_t i = 0; i < info->constantCount; i++)
+		{
+			ms_Value value;
+			switch (constants[i].type)
+			{
+				case CONST_NULL: value = MS_NULL_VAL; break;
+				case CONST_NUMBER: value = MS_FROM_NUM(constants[i].number); break;
+
+				case CONST_STRING:
+					if (constants[i].index >= stringCount) goto done;
+					value = MS_FROM_OBJ(strings[constants[i].index]);
+					break;
+
+				case CONST_FUNCTION:
+					if (constants[i].index >= f) goto done;
+					value = MS_FROM_OBJ(functions[constants[i].index]);
+					break;
+
+				default: goto done;
+			}
+
+			ms_addValueToList(vm, &code->constants, value);
+			ms_writeBarrier(vm, (ms_Object*)function, value);
+		}
+
+		if (!checkCode(code, globals, globalCount)) goto done;
+		if (!checkStack(vm, code, info->arity, info->maxStack)) goto done;
+	}
+
+	if (r->pos == r->size) script = functions[functionCount - 1];
+
+done:
+	MS_MEM_FREE_ARR(vm, ms_ObjString*, strings, stringCount);
+	MS_MEM_FREE_ARR(vm, int, globals, globalCount);
+	MS_MEM_FREE_ARR(vm, ms_ObjFunction*, functions, functionCount);
+	return script;
+}
+
+ms_ObjFunction *ms_loadBytecode(ms_VM *vm, const char *path)
+{
+	ms_Mapping *mapping = mapFile(vm, path);
+	if (mapping == NULL) return NULL;
+
+	// nothing loaded is reachable until it's returned
+	bool wasPaused = vm->gcPaused;
+	vm->gcPaused = true;
+	Reader r = { mapping->data, mapping->size, 0 };
+	ms_ObjFunction *script = loadFunctions(vm, &r);
+	vm->gcPaused = wasPaused;
+
+	if (script == NULL)
+	{
+		// whatever was loaded before it failed is garbage now, and
+		// garbage with a zero capacity never touches the code it pointed to
+		unmapFile(vm, mapping);
+		return NULL;
+	}
+
+	mapping->next = vm->mappings;
+	vm->mappings = mapping;
+	return script;
+}
+
+bool ms_isBytecodeFile(const char *path)
+{
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL) return false;
+
+	char magic[sizeof MAGIC - 1];
+	bool is = fread(magic, 1, sizeof magic, fp) == sizeof magic
+		&& memcmp(magic, MAGIC, sizeof magic) == 0;
+	fclose(fp);
+	return is;
+}
+
+void ms_freeMappings(ms_VM *vm)
+{
+	while (vm->mappings != NULL)
+	{
+		ms_Mapping *next = vm->mappings->next;
+		unmapFile(vm, vm->mappings);
+		vm->mappings = next;
+	}
+}
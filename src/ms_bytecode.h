@@ -0,0 +1,32 @@
+#ifndef MS_BYTECODE_H
+#define MS_BYTECODE_H
+
+#include "ms_object.h"
+
+// compiled scripts saved to .msc files, so they can be run again without
+// scanning and compiling them. a file holds a header, a table with every
+// string in it, the names of the globals in the order their slots were
+// given out, then every function, nested ones before the ones holding them
+// and the script itself last. each function has its line runs, its
+// constants and its code, 8-byte aligned so they can be used right where
+// they are in the file. everything is in the byte order of the machine
+// that saved it, files from another one are rejected. files are trusted
+// not to be malicious, but anything that'd make the loader itself read
+// out of bounds is checked, and so is every path through the code, for
+// it to stay inside the constants, the globals and its own stack frame
+
+// writes the script's function tree to `path`, false if it couldn't.
+// quickened instructions are saved as the generic ones they came from.
+// neither this nor loading prints anything, callers say what went wrong
+bool ms_saveBytecode(ms_VM *vm, ms_ObjFunction *script, const char *path);
+
+// NULL if the file couldn't be read or isn't valid.
+// the file is mapped into memory where possible, and the code and line
+// runs of every function point straight into it. the globals it uses are
+// declared, their slots in the code are fixed up if they differ from the
+// ones in the VM that saved it. the mapping stays until the VM is freed
+ms_ObjFunction *ms_loadBytecode(ms_VM *vm, const char *path);
+
+void ms_freeMappings(ms_VM *vm);
+
+#endif
@@ -1,18 +1,117 @@
+#include <math.h>
+#include <string.h>
+
 #include "ms_code.h"
 #include "ms_mem.h"
+#include "ms_vm.h"
+
+const ms_OpcodeInfo ms_opcodeInfo[MS_OP__END] = {
+	[MS_OP_CONST]         = { 1, +1 },
+	[MS_OP_NULL]          = { 0, +1 },
+	[MS_OP_TRUE]          = { 0, +1 },
+	[MS_OP_FALSE]         = { 0, +1 },
+
+	[MS_OP_ADD]           = { 0, -1 },
+	[MS_OP_SUBTRACT]      = { 0, -1 },
+	[MS_OP_MULTIPLY]      = { 0, -1 },
+	[MS_OP_DIVIDE]        = { 0, -1 },
+	[MS_OP_POWER]         = { 0, -1 },
+	[MS_OP_MODULO]        = { 0, -1 },
+	[MS_OP_NEGATE]        = { 0,  0 },
+	[MS_OP_SQUARE]        = { 0,  0 },
+
+	[MS_OP_EQUAL]         = { 0, -1 },
+	[MS_OP_NOT_EQUAL]     = { 0, -1 },
+	[MS_OP_LESS]          = { 0, -1 },
+	[MS_OP_LESS_EQUAL]    = { 0, -1 },
+	[MS_OP_GREATER]       = { 0, -1 },
+	[MS_OP_GREATER_EQUAL] = { 0, -1 },
+
+	[MS_OP_AND]           = { 0, -1 },
+	[MS_OP_OR]            = { 0, -1 },
+	[MS_OP_NOT]           = { 0,  0 },
+
+	[MS_OP_BUILD_LIST]    = { 2, +1 },
+	[MS_OP_GET_INDEX]     = { 0, -1 },
+	[MS_OP_SET_INDEX]     = { 0, -3 },
+	[MS_OP_SLICE]         = { 0, -2 },
+	[MS_OP_BUILD_MAP]     = { 2, +1 },
+
+	[MS_OP_SET_GLOBAL]    = { 2, -1 },
+	[MS_OP_GET_GLOBAL]    = { 2, +1 },
+	[MS_OP_SET_LOCAL]     = { 1, -1 },
+	[MS_OP_GET_LOCAL]     = { 1, +1 },
+	[MS_OP_INVOKE]        = { 1,  0 },
+	[MS_OP_TAIL_INVOKE]   = { 1,  0 },
+
+	[MS_OP_JUMP]          = { 2,  0 },
+	[MS_OP_JUMP_IF_FALSE] = { 2,  0 },
+	[MS_OP_LOOP]          = { 2,  0 },
+	[MS_OP_FOR_ITER]      = { 2, +1 },
+
+	[MS_OP_CONST_LONG]         = { 3, +1 },
+	[MS_OP_JUMP_LONG]          = { 3,  0 },
+	[MS_OP_JUMP_IF_FALSE_LONG] = { 3,  0 },
+	[MS_OP_LOOP_LONG]          = { 3,  0 },
+	[MS_OP_FOR_ITER_LONG]      = { 3, +1 },
+
+	[MS_OP_POP]           = { 0, -1 },
+	[MS_OP_RETURN]        = { 0, -1 },
+
+	[MS_OP_GET_LOCAL_INVOKE]   = { 1, +1 },
+	[MS_OP_GET_GLOBAL_INVOKE]  = { 2, +1 },
+	[MS_OP_ADD_CONST]          = { 1,  0 },
+	[MS_OP_POP_JUMP_IF_FALSE]  = { 2, -1 },
+	[MS_OP_LESS_JUMP_IF_FALSE] = { 2, -2 },
+
+	[MS_OP_ADD_NUM_NUM]            = { 0, -1 },
+	[MS_OP_SUBTRACT_NUM_NUM]       = { 0, -1 },
+	[MS_OP_MULTIPLY_NUM_NUM]       = { 0, -1 },
+	[MS_OP_DIVIDE_NUM_NUM]         = { 0, -1 },
+	[MS_OP_EQUAL_NUM_NUM]          = { 0, -1 },
+	[MS_OP_NOT_EQUAL_NUM_NUM]      = { 0, -1 },
+	[MS_OP_LESS_NUM_NUM]           = { 0, -1 },
+	[MS_OP_LESS_EQUAL_NUM_NUM]     = { 0, -1 },
+	[MS_OP_GREATER_NUM_NUM]        = { 0, -1 },
+	[MS_OP_GREATER_EQUAL_NUM_NUM]  = { 0, -1 },
+	[MS_OP_ADD_CONST_NUM]          = { 1,  0 },
+	[MS_OP_LESS_NUM_JUMP_IF_FALSE] = { 2, -2 },
+};
+
+ms_Opcode ms_genericOpcode(ms_Opcode op)
+{
+	switch (op)
+	{
+		case MS_OP_ADD_NUM_NUM:            return MS_OP_ADD;
+		case MS_OP_SUBTRACT_NUM_NUM:       return MS_OP_SUBTRACT;
+		case MS_OP_MULTIPLY_NUM_NUM:       return MS_OP_MULTIPLY;
+		case MS_OP_DIVIDE_NUM_NUM:         return MS_OP_DIVIDE;
+		case MS_OP_EQUAL_NUM_NUM:          return MS_OP_EQUAL;
+		case MS_OP_NOT_EQUAL_NUM_NUM:      return MS_OP_NOT_EQUAL;
+		case MS_OP_LESS_NUM_NUM:           return MS_OP_LESS;
+		case MS_OP_LESS_EQUAL_NUM_NUM:     return MS_OP_LESS_EQUAL;
+		case MS_OP_GREATER_NUM_NUM:        return MS_OP_GREATER;
+		case MS_OP_GREATER_EQUAL_NUM_NUM:  return MS_OP_GREATER_EQUAL;
+		case MS_OP_ADD_CONST_NUM:          return MS_OP_ADD_CONST;
+		case MS_OP_LESS_NUM_JUMP_IF_FALSE: return MS_OP_LESS_JUMP_IF_FALSE;
+		default: return op;
+	}
+}
 
 void ms_initCode(ms_VM *vm, ms_Code *code)
 {
 	code->data = NULL;
 	code->lines = NULL;
 	code->count = code->cap = 0;
+	code->lineCount = code->lineCap = 0;
 	ms_initList(vm, &code->constants);
 }
 
 void ms_freeCode(ms_VM *vm, ms_Code *code)
 {
-	MS_MEM_FREE_ARR(vm, uint8_t, code->data, code->cap);
-	MS_MEM_FREE_ARR(vm, int, code->lines, code->cap);
+	// code loaded from a bytecode file borrows both from the mapping
+	if (code->cap != 0) MS_MEM_FREE_ARR(vm, uint8_t, code->data, code->cap);
+	if (code->lineCap != 0) MS_MEM_FREE_ARR(vm, ms_LineRun, code->lines, code->lineCap);
 	ms_freeList(vm, &code->constants);
 	ms_initCode(vm, code);
 }
@@ -24,19 +123,78 @@ void ms_addByteToCode(ms_VM *vm, ms_Code *code, uint8_t byte, int line)
 		int oldCap = code->cap;
 		code->cap = MS_ARR_GROW_CAP(oldCap);
 		code->data = MS_MEM_REALLOC_ARR(vm, uint8_t, code->data, oldCap, code->cap);
-		code->lines = MS_MEM_REALLOC_ARR(vm, int, code->lines, oldCap, code->cap);
 	}
 
-	int index = code->count++;
-	code->data[index] = byte;
-	code->lines[index] = line;
+	if (code->lineCount == 0 || code->lines[code->lineCount - 1].line != line)
+	{
+		if (code->lineCount == code->lineCap)
+		{
+			size_t oldCap = code->lineCap;
+			code->lineCap = MS_ARR_GROW_CAP(oldCap);
+			code->lines = MS_MEM_REALLOC_ARR(vm, ms_LineRun, code->lines, oldCap, code->lineCap);
+		}
+
+		ms_LineRun *run = &code->lines[code->lineCount++];
+		run->offset = (uint32_t)code->count;
+		run->line = line;
+	}
+
+	code->data[code->count++] = byte;
+}
+
+void ms_truncateCode(ms_Code *code, size_t count)
+{
+	if (count >= code->count) return;
+	code->count = count;
+	while (code->lineCount > 0 && code->lines[code->lineCount - 1].offset >= count)
+		code->lineCount--;
+}
+
+int ms_getCodeLine(ms_Code *code, size_t offset)
+{
+	if (code->lineCount == 0) return 0;
+
+	// the last run starting at or before offset
+	size_t lo = 0, hi = code->lineCount;
+	while (hi - lo > 1)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (code->lines[mid].offset <= offset) lo = mid;
+		else hi = mid;
+	}
+	return code->lines[lo].line;
+}
+
+// the index compares numbers like `==` does, so it can't tell -0 from 0
+// and never finds NaN. both are rare, they're looked for by their bits instead
+static bool isUnindexable(ms_Value constant)
+{
+	if (!MS_IS_NUM(constant)) return false;
+	double num = MS_TO_NUM(constant);
+	return (num == 0 && signbit(num)) || num != num;
 }
 
-size_t ms_addConstToCode(ms_VM *vm, ms_Code *code, ms_Value constant)
+static bool sameBits(ms_Value a, ms_Value b)
 {
-	int idx = ms_findValueInList(&code->constants, constant);
-	if (idx == -1)
-		return ms_addValueToList(vm, &code->constants, constant);
+	if (!MS_IS_NUM(a) || !MS_IS_NUM(b)) return false;
+	double x = MS_TO_NUM(a), y = MS_TO_NUM(b);
+	return memcmp(&x, &y, sizeof x) == 0;
+}
+
+size_t ms_addConstToCode(ms_VM *vm, ms_Code *code, ms_Map *index, ms_Value constant)
+{
+	bool indexed = !isUnindexable(constant);
+	ms_Value found;
+	if (indexed && ms_getMapKey(vm, index, constant, &found)) return (size_t)MS_TO_NUM(found);
+	if (!indexed)
+		for (size_t i = 0; i < code->constants.count; i++)
+			if (sameBits(code->constants.data[i], constant)) return i;
+
+	// growing the list or the index may collect garbage before the constant is stored
+	ms_pushValueIntoVM(vm, constant);
+	size_t idx = ms_addValueToList(vm, &code->constants, constant);
+	if (indexed) ms_setMapKey(vm, index, constant, MS_FROM_NUM((double)idx));
+	ms_popValueFromVM(vm);
 
 	return idx;
 }
@@ -2,6 +2,7 @@
 #define MS_CODE_H
 
 #include "miniscript.h"
+#include "ms_map.h"
 #include "ms_value.h"
 
 typedef enum {
@@ -10,16 +11,48 @@ typedef enum {
 	#undef OPCODE
 } ms_Opcode;
 
+typedef struct {
+	uint8_t operandBytes;
+	// net effect on the stack, INVOKE additionally pops its arguments,
+	// BUILD_LIST and BUILD_MAP the values going into the list or map,
+	// and FOR_ITER doesn't push anything when it jumps
+	int8_t stackEffect;
+} ms_OpcodeInfo;
+
+// the largest constant index or jump offset the _LONG opcodes can take
+#define MS_MAX_LONG_OPERAND 0xffffff
+
+extern const ms_OpcodeInfo ms_opcodeInfo[MS_OP__END];
+
+// the opcode a quickened one was rewritten from while running, or `op`
+// itself if it isn't quickened
+ms_Opcode ms_genericOpcode(ms_Opcode op);
+
+// the code from `offset` up to the next run's came from `line`.
+// one of these per line instead of an int for every byte of code
+typedef struct {
+	uint32_t offset;
+	int line;
+} ms_LineRun;
+
 typedef struct {
 	size_t count, cap;
 	uint8_t *data;
-	int *lines;
+	ms_LineRun *lines;
+	size_t lineCount, lineCap;
 	ms_List constants;
 } ms_Code;
 
 void ms_initCode(ms_VM *vm, ms_Code *code);
 void ms_freeCode(ms_VM *vm, ms_Code *code);
 void ms_addByteToCode(ms_VM *vm, ms_Code *code, uint8_t byte, int line);
-size_t ms_addConstToCode(ms_VM *vm, ms_Code *code, ms_Value constant);
+// drops everything from `count` on, for the compiler to replace code it just emitted
+void ms_truncateCode(ms_Code *code, size_t count);
+// the line the byte at `offset` came from, a binary search over the runs
+int ms_getCodeLine(ms_Code *code, size_t offset);
+// `index` maps the constants already in the code to their position,
+// so that each one is only added once without searching the whole list.
+// numbers are told apart by their bits: -0 isn't 0, and NaN is itself
+size_t ms_addConstToCode(ms_VM *vm, ms_Code *code, ms_Map *index, ms_Value constant);
 
 #endif
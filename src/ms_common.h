@@ -11,10 +11,43 @@
 #define MS_DEBUG_PRINT_CODE
 #define MS_DEBUG_ASSERTIONS
 #define MS_DEBUG_COMPILATION
+#define MS_DEBUG_LOG_GC
 #endif
 
+// collect garbage on every allocation, to shake out missing roots.
+// not part of MS_DEBUG since it's *really* slow, add it to `debug-flags`
+// #define MS_DEBUG_STRESS_GC
+
+// build-time features, pass them through the `features` variable in the makefile:
+//  - MS_NAN_BOXING: pack every ms_Value into a single 64-bit word (see ms_value.h)
+//  - MS_NO_COMPUTED_GOTO: dispatch opcodes through a plain switch, even if
+//    the compiler supports labels as values
+//  - MS_NO_PEEPHOLE: emit bytecode as-is, without fusing superinstructions
+//  - MS_NO_QUICKENING: never rewrite arithmetic and comparisons into their
+//    number-only forms while running
+//  - MS_PROFILE_OPCODES: count how often each pair of opcodes runs back to back
+//  - MS_NO_NURSERY: allocate every object straight into the old generation
+//  - MS_NO_MMAP: read bytecode files into memory instead of mapping them
+//  - MS_NO_SIMD: use the portable versions of code that has SSE2 paths
+//  - MS_HASH_FNV1A: hash strings a byte at a time with FNV-1a instead of 8 bytes at a time
+
 #define MS_UNUSED(x) ((void)(x))
 
+#if defined(__GNUC__) && !defined(MS_NO_COMPUTED_GOTO)
+#define MS_COMPUTED_GOTO
+#endif
+
+// hints to keep rarely taken paths (mostly errors) out of the hot code
+#ifdef __GNUC__
+#define MS_COLD __attribute__((cold, noinline))
+#define MS_LIKELY(x) __builtin_expect(!!(x), 1)
+#define MS_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define MS_COLD
+#define MS_LIKELY(x) (x)
+#define MS_UNLIKELY(x) (x)
+#endif
+
 #ifdef MS_DEBUG_ASSERTIONS
 
 #include <stdlib.h>
@@ -55,8 +88,10 @@
 
 #else
 
-#define MS_ASSERT_REASON(cond, reason) exit(-1)
-#define MS_ASSERT(cond) exit(-1)
+#include <stdlib.h>
+
+#define MS_ASSERT_REASON(cond, reason) ((void)0)
+#define MS_ASSERT(cond) ((void)0)
 #define MS_UNREACHABLE(place) exit(-1)
 
 #endif // MS_DEBUG_ASSERTIONS
@@ -8,7 +8,11 @@
 #include "ms_scanner.h"
 #include "ms_value.h"
 #include "ms_code.h"
+#include "ms_hash.h"
 #include "ms_mem.h"
+#include "ms_string.h"
+#include "ms_optimizer.h"
+#include "ms_vm.h"
 
 #ifdef MS_DEBUG_PRINT_CODE
 #include "ms_debug.h"
@@ -44,11 +48,46 @@ typedef struct {
 	ParsePrecedence precedence;
 } ParseRule;
 
+struct Record;
+
 typedef struct {
 	ms_Token name;
 	int depth;
+	// the symbol for its name (-1 for hidden locals), and the local
+	// that symbol resolved to before this one came along
+	int symbol;
+	struct Record *shadowedRecord;
+	int shadowed;
 } Local;
 
+// every name the compiler comes across, looked up by its slice of the
+// source. that way resolving a variable doesn't turn its name into a
+// string (hashing it, probing the interned strings, maybe allocating)
+// nor go through every local; only declaring a global interns the name
+typedef struct {
+	const char *start;
+	int length;
+	// the same hash the name gets once interned
+	uint32_t hash;
+	// the global's slot, -1 if there isn't one, or SYMBOL_UNRESOLVED
+	int global;
+	// the innermost local with this name, only if it's in `record`
+	struct Record *record;
+	int local;
+} Symbol;
+
+#define SYMBOL_UNRESOLVED -2
+#define SYMBOL_EMPTY UINT32_MAX
+
+typedef struct {
+	// in the order they were found. the index is open addressed, with
+	// the position of each symbol in the array, and is never over half full
+	Symbol *symbols;
+	size_t count, cap;
+	uint32_t *index;
+	size_t indexCap;
+} SymbolTable;
+
 typedef enum {
 	TYPE_FUNCTION,
 	TYPE_SCRIPT,
@@ -57,6 +96,17 @@ typedef enum {
 typedef struct Record {
 	struct Record *enclosing;
 	ms_ObjFunction *function;
+	// where each constant already is in the function's constants
+	ms_Map constantIndex;
+	// for folding: where the last constant pushed starts (SIZE_MAX if
+	// nothing was pushed yet) and whether it was new to the constant pool,
+	// then where the last expression known to give a number ends
+	// and whether that number could be -0
+	size_t constantStart, numberEnd;
+	bool constantAdded, mayBeNegZero;
+	// offset of the last INVOKE emitted, to spot calls in tail position.
+	// kept per function, a nested one's offsets mean nothing out here
+	size_t lastInvoke;
 	FunctionType type;
 	Local locals[UINT8_COUNT];
 	int localCount, scopeDepth;
@@ -68,7 +118,11 @@ struct ms_Compiler {
 	ms_Token previous, current;
 	ms_Code *currentCode;
 	Record *currentRecord;
+	// forward jumps are emitted with 16-bit offsets until one doesn't fit,
+	// then the whole script gets compiled again with 24-bit ones
+	bool wideJumps, needsWideJumps;
 	bool hadError;
+	SymbolTable symbols;
 };
 
 static void initCompiler
@@ -78,6 +132,18 @@ static void initCompiler
 	compiler->scanner = scanner;
 	compiler->vm = vm;
 	compiler->currentRecord = NULL;
+	compiler->wideJumps = compiler->needsWideJumps = false;
+	compiler->symbols.symbols = NULL;
+	compiler->symbols.count = compiler->symbols.cap = 0;
+	compiler->symbols.index = NULL;
+	compiler->symbols.indexCap = 0;
+}
+
+static void freeCompiler(ms_Compiler *compiler)
+{
+	SymbolTable *table = &compiler->symbols;
+	MS_MEM_FREE_ARR(compiler->vm, Symbol, table->symbols, table->cap);
+	MS_MEM_FREE_ARR(compiler->vm, uint32_t, table->index, table->indexCap);
 }
 
 static void initRecord(ms_Compiler *compiler, Record *rec, FunctionType type)
@@ -88,6 +154,8 @@ static void initRecord(ms_Compiler *compiler, Record *rec, FunctionType type)
 	rec->localCount = 0;
 	rec->scopeDepth = 0;
 	rec->function = ms_newFunction(compiler->vm);
+	ms_initMap(compiler->vm, &rec->constantIndex);
+	rec->constantStart = rec->numberEnd = rec->lastInvoke = SIZE_MAX;
 
 	compiler->currentRecord = rec;
 	compiler->currentCode = &rec->function->code;
@@ -96,6 +164,7 @@ static void initRecord(ms_Compiler *compiler, Record *rec, FunctionType type)
 	local->depth = 0;
 	local->name.start = "";
 	local->name.length = 0;
+	local->symbol = -1;
 }
 
 static void advance(ms_Compiler *compiler);
@@ -183,20 +252,41 @@ static void emitBytes(ms_Compiler *compiler, uint8_t byte1, uint8_t byte2)
 	ms_addByteToCode(compiler->vm, compiler->currentCode, byte2, line);
 }
 
-static void emitLoop(ms_Compiler *compiler, int loopStart)
+static void emitLoop(ms_Compiler *compiler, size_t loopStart)
 {
-	emitByte(compiler, MS_OP_LOOP);
-
-	int offset = compiler->currentCode->count - loopStart + 2;
-	if (offset > UINT16_MAX) error(compiler, "Loop body too large");
+	// the loop's start is already known, so only the loops that need it get the long form
+	size_t offset = compiler->currentCode->count - loopStart + 3;
+	if (offset <= UINT16_MAX)
+	{
+		emitByte(compiler, MS_OP_LOOP);
+		emitByte(compiler, (offset >> 8) & 0xff);
+		emitByte(compiler,  offset       & 0xff);
+		return;
+	}
 
-	emitByte(compiler, (offset >> 8) & 0xff);
-	emitByte(compiler,  offset       & 0xff);
+	offset++;
+	if (offset > MS_MAX_LONG_OPERAND) error(compiler, "Loop body too large");
+	emitByte(compiler, MS_OP_LOOP_LONG);
+	emitByte(compiler, (offset >> 16) & 0xff);
+	emitByte(compiler, (offset >>  8) & 0xff);
+	emitByte(compiler,  offset        & 0xff);
 }
 
 static size_t emitJump(ms_Compiler *compiler, uint8_t instruction)
 {
-	emitByte(compiler, instruction);
+	if (compiler->wideJumps)
+	{
+		switch (instruction)
+		{
+			case MS_OP_JUMP:          instruction = MS_OP_JUMP_LONG;          break;
+			case MS_OP_JUMP_IF_FALSE: instruction = MS_OP_JUMP_IF_FALSE_LONG; break;
+			case MS_OP_FOR_ITER:      instruction = MS_OP_FOR_ITER_LONG;      break;
+		}
+		emitByte(compiler, instruction);
+		emitByte(compiler, 0xff);
+	}
+	else emitByte(compiler, instruction);
+
 	emitByte(compiler, 0xff);
 	emitByte(compiler, 0xff);
 	return compiler->currentCode->count - 2;
@@ -207,39 +297,158 @@ static void emitReturn(ms_Compiler *compiler)
 	emitBytes(compiler, MS_OP_NULL, MS_OP_RETURN);
 }
 
-static uint8_t makeConstant(ms_Compiler *compiler, ms_Value value)
+static size_t makeConstant(ms_Compiler *compiler, ms_Value value)
 {
-	// TODO: make the operand a 16 bit index
-	size_t constant = ms_addConstToCode(compiler->vm, compiler->currentCode, value);
-	if (constant > UINT8_MAX)
+	Record *rec = compiler->currentRecord;
+	size_t constant = ms_addConstToCode(compiler->vm, compiler->currentCode, &rec->constantIndex, value);
+	ms_writeBarrier(compiler->vm, (ms_Object*)rec->function, value);
+	if (constant > MS_MAX_LONG_OPERAND)
 	{
 		error(compiler, "Too many constants in one chunk");
 		return 0;
 	}
-	return (uint8_t)constant;
+	return constant;
+}
+
+static void markNumber(ms_Compiler *compiler, bool mayBeNegZero)
+{
+	Record *rec = compiler->currentRecord;
+	rec->numberEnd = compiler->currentCode->count;
+	rec->mayBeNegZero = mayBeNegZero;
 }
 
 static void emitConstant(ms_Compiler *compiler, ms_Value value)
 {
-	emitBytes(compiler, MS_OP_CONST, makeConstant(compiler, value));
+	Record *rec = compiler->currentRecord;
+	size_t poolSize = compiler->currentCode->constants.count;
+	size_t constant = makeConstant(compiler, value);
+	rec->constantStart = compiler->currentCode->count;
+	rec->constantAdded = compiler->currentCode->constants.count > poolSize;
+
+	if (constant <= UINT8_MAX) emitBytes(compiler, MS_OP_CONST, (uint8_t)constant);
+	else
+	{
+		emitByte(compiler, MS_OP_CONST_LONG);
+		emitByte(compiler, (constant >> 16) & 0xff);
+		emitByte(compiler, (constant >>  8) & 0xff);
+		emitByte(compiler,  constant        & 0xff);
+	}
+
+	if (MS_IS_NUM(value)) markNumber(compiler, MS_TO_NUM(value) == 0 && signbit(MS_TO_NUM(value)));
 }
 
+// `offset` is where the last two bytes of the operand are, as returned by emitJump
 static void patchJump(ms_Compiler *compiler, size_t offset)
 {
 	size_t jump = compiler->currentCode->count - offset - 2;
-	if (jump > UINT16_MAX) error(compiler, "Too much jump to code over");
+	uint8_t *operand = compiler->currentCode->data + offset;
+
+	if (compiler->wideJumps)
+	{
+		if (jump > MS_MAX_LONG_OPERAND) error(compiler, "Too much jump to code over");
+		operand[-1] = (jump >> 16) & 0xff;
+	}
+	else if (jump > UINT16_MAX)
+	{
+		// keep going to find any errors, the code's thrown away anyways
+		compiler->needsWideJumps = true;
+		return;
+	}
 
-	compiler->currentCode->data[offset] = (jump >> 8) & 0xff;
-	compiler->currentCode->data[offset + 1] = jump & 0xff;
+	operand[0] = (jump >> 8) & 0xff;
+	operand[1] = jump & 0xff;
 }
 
+// walks every path through the code to find out how deep the stack can get,
+// so that the VM only has to check for an overflow once per call
+static int computeMaxStack(ms_Compiler *compiler, ms_Code *code, int initialDepth)
+{
+	if (code->count == 0) return initialDepth;
+
+	int *depths = MS_MEM_MALLOC_ARR(compiler->vm, int, code->count);
+	size_t *pending = MS_MEM_MALLOC_ARR(compiler->vm, size_t, code->count);
+	size_t pendingCount = 0;
+
+	for (size_t i = 0; i < code->count; i++) depths[i] = -1;
+
+#define VISIT(offset, depth) do {                               \
+    size_t o = (offset);                                        \
+    if (o < code->count && depths[o] == -1)                     \
+    {                                                           \
+      depths[o] = (depth);                                      \
+      pending[pendingCount++] = o;                              \
+    }                                                           \
+  } while(0)
+
+	int maxDepth = initialDepth;
+	VISIT(0, initialDepth);
+
+	while (pendingCount > 0)
+	{
+		size_t offset = pending[--pendingCount];
+		uint8_t *ip = code->data + offset;
+		const ms_OpcodeInfo *info = &ms_opcodeInfo[*ip];
+
+		int depth = depths[offset] + info->stackEffect;
+		if (*ip == MS_OP_INVOKE || *ip == MS_OP_TAIL_INVOKE) depth -= ip[1];
+		if (*ip == MS_OP_BUILD_LIST) depth -= ip[1] << 8 | ip[2];
+		if (*ip == MS_OP_BUILD_MAP) depth -= 2 * (ip[1] << 8 | ip[2]);
+		if (depth > maxDepth) maxDepth = depth;
+
+		size_t next = offset + 1 + info->operandBytes;
+		size_t jump = 0;
+		if (info->operandBytes == 2) jump = ip[1] << 8 | ip[2];
+		else if (info->operandBytes == 3) jump = (size_t)ip[1] << 16 | ip[2] << 8 | ip[3];
+		switch (*ip)
+		{
+			case MS_OP_RETURN: break;
+			case MS_OP_JUMP: case MS_OP_JUMP_LONG: VISIT(next + jump, depth); break;
+			case MS_OP_LOOP: case MS_OP_LOOP_LONG: VISIT(next - jump, depth); break;
+
+			case MS_OP_JUMP_IF_FALSE:
+			case MS_OP_JUMP_IF_FALSE_LONG:
+				VISIT(next + jump, depth);
+				VISIT(next, depth);
+				break;
+
+			// nothing's pushed when it jumps out of the loop
+			case MS_OP_FOR_ITER:
+			case MS_OP_FOR_ITER_LONG:
+				VISIT(next + jump, depth - 1);
+				VISIT(next, depth);
+				break;
+
+			default: VISIT(next, depth); break;
+		}
+	}
+
+#undef VISIT
+
+	MS_MEM_FREE_ARR(compiler->vm, size_t, pending, code->count);
+	MS_MEM_FREE_ARR(compiler->vm, int, depths, code->count);
+	return maxDepth;
+}
+
+static void removeLocal(ms_Compiler *compiler);
+
 static ms_ObjFunction *endCompiler(ms_Compiler *compiler)
 {
 	emitReturn(compiler);
 	ms_ObjFunction *function = compiler->currentRecord->function;
+	ms_freeMap(compiler->vm, &compiler->currentRecord->constantIndex);
+	while (compiler->currentRecord->localCount > 0) removeLocal(compiler);
+
+	// the jumps that didn't fit were left pointing nowhere
+	if (!compiler->hadError && !compiler->needsWideJumps)
+	{
+		function->maxStack = computeMaxStack(compiler, &function->code, 1 + function->arity);
+#ifndef MS_NO_PEEPHOLE
+		ms_optimizeCode(compiler->vm, &function->code, 1 + function->arity);
+#endif
+	}
 
 #ifdef MS_DEBUG_PRINT_CODE
-	if (!compiler->hadError)
+	if (!compiler->hadError && !compiler->needsWideJumps)
 	{
 		fprintf(stderr, "compiler: code disassembly:\n");
 		ms_disassembleCode(compiler->currentCode, "code");
@@ -266,7 +475,7 @@ static void endScope(ms_Compiler *compiler)
 	   &&  rec->locals[rec->localCount - 1].depth > rec->scopeDepth)
 	{
 		emitByte(compiler, MS_OP_POP);
-		rec->localCount--;
+		removeLocal(compiler);
 	}
 }
 
@@ -276,7 +485,8 @@ static void endScope(ms_Compiler *compiler)
   beginScope(compiler);                                                         \
   skipNewlines(compiler);                                                       \
   int numArgs = sizeof((ms_TokenType[]){__VA_ARGS__})/sizeof(ms_TokenType);     \
-  while (!vcheck(compiler, numArgs+1, MS_TOK_EOF, __VA_ARGS__)) {               \
+  while (!compiler->hadError                                                    \
+      && !vcheck(compiler, numArgs+1, MS_TOK_EOF, __VA_ARGS__)) {               \
     statement(compiler);                                                        \
     skipNewlines(compiler);                                                     \
   }                                                                             \
@@ -288,35 +498,105 @@ static void expression(ms_Compiler *compiler);
 static ParseRule *getRule(ms_TokenType type);
 static void parsePrecedence(ms_Compiler* compiler, ParsePrecedence precedence);
 
-static ms_Value identifierObject(ms_Compiler *compiler, ms_Token *name)
+static void growSymbolIndex(ms_Compiler *compiler)
 {
-	return MS_FROM_OBJ(ms_copyString(compiler->vm, name->start, name->length));
+	SymbolTable *table = &compiler->symbols;
+	MS_MEM_FREE_ARR(compiler->vm, uint32_t, table->index, table->indexCap);
+
+	table->indexCap = table->indexCap < 64 ? 64 : table->indexCap * 2;
+	table->index = MS_MEM_MALLOC_ARR(compiler->vm, uint32_t, table->indexCap);
+	for (size_t i = 0; i < table->indexCap; i++) table->index[i] = SYMBOL_EMPTY;
+
+	size_t mask = table->indexCap - 1;
+	for (size_t s = 0; s < table->count; s++)
+	{
+		size_t i = table->symbols[s].hash & mask;
+		while (table->index[i] != SYMBOL_EMPTY) i = (i + 1) & mask;
+		table->index[i] = (uint32_t)s;
+	}
 }
 
-static inline uint8_t identifierConstant(ms_Compiler *compiler, ms_Token *name)
+// the position of the name's symbol, which is added if it's new
+static int findSymbol(ms_Compiler *compiler, ms_Token *name)
 {
-	return makeConstant(compiler, identifierObject(compiler, name));
-}
+	SymbolTable *table = &compiler->symbols;
+	if ((table->count + 1) * 2 > table->indexCap) growSymbolIndex(compiler);
 
-static bool identifiersEqual(ms_Token* a, ms_Token* b) {
-  if (a->length != b->length) return false;
-  return memcmp(a->start, b->start, a->length) == 0;
+	uint32_t hash = ms_hashMem(name->start, name->length, compiler->vm->hashSeed);
+	size_t mask = table->indexCap - 1;
+	size_t i = hash & mask;
+	for (; table->index[i] != SYMBOL_EMPTY; i = (i + 1) & mask)
+	{
+		Symbol *symbol = &table->symbols[table->index[i]];
+		if (symbol->hash == hash && symbol->length == name->length
+		 && memcmp(symbol->start, name->start, name->length) == 0)
+			return (int)table->index[i];
+	}
+
+	if (table->count == table->cap)
+	{
+		size_t oldCap = table->cap;
+		table->cap = MS_ARR_GROW_CAP(oldCap);
+		table->symbols = MS_MEM_REALLOC_ARR(compiler->vm, Symbol, table->symbols, oldCap, table->cap);
+	}
+
+	Symbol *symbol = &table->symbols[table->count];
+	symbol->start = name->start;
+	symbol->length = name->length;
+	symbol->hash = hash;
+	symbol->global = SYMBOL_UNRESOLVED;
+	symbol->record = NULL;
+	symbol->local = -1;
+	table->index[i] = (uint32_t)table->count;
+	return (int)table->count++;
 }
 
 static int resolveLocal(ms_Compiler *compiler, ms_Token *name)
 {
-	Record *rec = compiler->currentRecord;
-	for (int i = rec->localCount - 1; i >= 0; i--)
+	int s = findSymbol(compiler, name);
+	Symbol *symbol = &compiler->symbols.symbols[s];
+	return symbol->record == compiler->currentRecord ? symbol->local : -1;
+}
+
+// returns the global's slot, or -1 if no global with that name was ever assigned
+static int resolveGlobal(ms_Compiler *compiler, ms_Token *name)
+{
+	int s = findSymbol(compiler, name);
+	Symbol *symbol = &compiler->symbols.symbols[s];
+	if (symbol->global != SYMBOL_UNRESOLVED) return symbol->global;
+
+	// globals are only declared through declareGlobal while compiling,
+	// so what's found here stays true until the end.
+	// if the name was never interned, there's no global with it either
+	ms_ObjString *str = ms_findStringInMap(compiler->vm, &compiler->vm->strings,
+		name->start, name->length, symbol->hash);
+	symbol->global = str == NULL ? -1 : ms_findGlobal(compiler->vm, str);
+	return symbol->global;
+}
+
+static int declareGlobal(ms_Compiler *compiler, ms_Token *name)
+{
+	int slot = resolveGlobal(compiler, name);
+	if (slot != -1) return slot;
+
+	int s = findSymbol(compiler, name);
+	ms_ObjString *str = ms_copyString(compiler->vm, name->start, name->length);
+	slot = ms_declareGlobal(compiler->vm, str);
+	compiler->symbols.symbols[s].global = slot;
+	return slot;
+}
+
+static void emitGlobal(ms_Compiler *compiler, uint8_t op, int slot)
+{
+	if (slot > UINT16_MAX)
 	{
-		Local* local = &rec->locals[i];
-		if (identifiersEqual(name, &local->name))
-			return i;
+		error(compiler, "Too many global variables");
+		return;
 	}
 
-	int idx = ms_findValueInList(&compiler->currentCode->constants, identifierObject(compiler, name));
-	if (idx == -1) return -2; // undefined
-
-	return -1; // global
+	emitByte(compiler, op);
+	emitByte(compiler, (slot >> 8) & 0xff);
+	emitByte(compiler,  slot       & 0xff);
 }
 
 static int addLocal(ms_Compiler *compiler, ms_Token name)
@@ -332,35 +612,247 @@ static int addLocal(ms_Compiler *compiler, ms_Token name)
 	Local *local = &rec->locals[idx];
 	local->name = name;
 	local->depth = rec->scopeDepth;
+	local->symbol = -1;
+
+	// the hidden ones can't be referred to
+	if (name.length > 0)
+	{
+		local->symbol = findSymbol(compiler, &name);
+		Symbol *symbol = &compiler->symbols.symbols[local->symbol];
+		local->shadowedRecord = symbol->record;
+		local->shadowed = symbol->local;
+		symbol->record = rec;
+		symbol->local = (int)idx;
+	}
 	return idx;
 }
 
+// the last local goes out of scope, what its name referred to before is back
+static void removeLocal(ms_Compiler *compiler)
+{
+	Record *rec = compiler->currentRecord;
+	Local *local = &rec->locals[--rec->localCount];
+	if (local->symbol == -1) return;
+
+	Symbol *symbol = &compiler->symbols.symbols[local->symbol];
+	symbol->record = local->shadowedRecord;
+	symbol->local = local->shadowed;
+}
+
+////////////////////////////
+
+// constant folding. the last constant pushed is folded into what's
+// applied to it while it's still the last thing in the code. only
+// numbers, strings and null are folded, the same way the VM would do it
+
+// whether the code ends with pushing a constant that can be folded
+static bool constantOnTop(ms_Compiler *compiler, ms_Value *value)
+{
+	size_t start = compiler->currentRecord->constantStart;
+	ms_Code *code = compiler->currentCode;
+	if (start == SIZE_MAX) return false;
+
+	uint8_t *ip = code->data + start;
+	if (start + 1 + ms_opcodeInfo[*ip].operandBytes != code->count) return false;
+
+	switch (*ip)
+	{
+		case MS_OP_CONST: *value = code->constants.data[ip[1]]; break;
+		case MS_OP_CONST_LONG:
+			*value = code->constants.data[(size_t)ip[1] << 16 | ip[2] << 8 | ip[3]];
+			break;
+		case MS_OP_TRUE:  *value = MS_FROM_NUM(1); break;
+		case MS_OP_FALSE: *value = MS_FROM_NUM(0); break;
+		case MS_OP_NULL:  *value = MS_NULL_VAL;    break;
+		default: return false;
+	}
+
+	return MS_IS_NUM(*value) || MS_IS_NULL(*value) || MS_IS_STRING(*value);
+}
+
+// takes back the code from `start` on, along with the last `added`
+// constants, which were new to the pool and only used by that code
+static void dropConstants(ms_Compiler *compiler, size_t start, int added)
+{
+	Record *rec = compiler->currentRecord;
+	ms_Code *code = compiler->currentCode;
+
+	ms_truncateCode(code, start);
+	if (rec->constantStart != SIZE_MAX && rec->constantStart >= start) rec->constantStart = SIZE_MAX;
+	if (rec->lastInvoke != SIZE_MAX && rec->lastInvoke >= start) rec->lastInvoke = SIZE_MAX;
+	if (rec->numberEnd != SIZE_MAX && rec->numberEnd > start) rec->numberEnd = SIZE_MAX;
+
+	while (added-- > 0)
+	{
+		// -0 and NaN were never put in the index, and 0 may be there instead
+		ms_Value value = code->constants.data[--code->constants.count], found;
+		if (ms_getMapKey(compiler->vm, &rec->constantIndex, value, &found)
+		 && (size_t)MS_TO_NUM(found) == code->constants.count)
+			ms_deleteFromMap(compiler->vm, &rec->constantIndex, value);
+	}
+}
+
+// false if it can't be folded, and has to be left for the VM to do (or fail at)
+static bool foldBinary(ms_Compiler *compiler, ms_Opcode op, ms_Value a, ms_Value b, ms_Value *result)
+{
+	bool numbers = MS_IS_NUM(a) && MS_IS_NUM(b);
+	bool strings = MS_IS_STRING(a) && MS_IS_STRING(b);
+	double x = numbers ? MS_TO_NUM(a) : 0, y = numbers ? MS_TO_NUM(b) : 0;
+
+	switch (op)
+	{
+		case MS_OP_ADD:
+			if (strings)
+			{
+				ms_ObjString *sa = MS_TO_STRING(a), *sb = MS_TO_STRING(b);
+				if (sa->length + sb->length > MS_MAX_STRING_LENGTH) return false;
+
+				// both are still in the constant pool, which keeps them alive
+				ms_ObjString *str = ms_allocateString(compiler->vm, sa->length + sb->length);
+				memcpy(str->chars, sa->chars, sa->length);
+				memcpy(str->chars + sa->length, sb->chars, sb->length);
+				*result = MS_FROM_OBJ(ms_internString(compiler->vm, str));
+				return true;
+			}
+			if (!numbers) return false;
+			*result = MS_FROM_NUM(x + y);
+			return true;
+
+		case MS_OP_SUBTRACT: if (!numbers) return false; *result = MS_FROM_NUM(x - y);      return true;
+		case MS_OP_MULTIPLY: if (!numbers) return false; *result = MS_FROM_NUM(x * y);      return true;
+		case MS_OP_DIVIDE:   if (!numbers) return false; *result = MS_FROM_NUM(x / y);      return true;
+		case MS_OP_MODULO:   if (!numbers) return false; *result = MS_FROM_NUM(fmod(x, y)); return true;
+		case MS_OP_POWER:    if (!numbers) return false; *result = MS_FROM_NUM(pow(x, y));  return true;
+
+		case MS_OP_EQUAL:
+		case MS_OP_NOT_EQUAL: {
+			bool equal = strings ? ms_stringsEqual(compiler->vm, a, b) : ms_valuesEqual(a, b);
+			*result = MS_FROM_NUM(equal == (op == MS_OP_EQUAL));
+			return true;
+		}
+
+		case MS_OP_LESS:
+		case MS_OP_LESS_EQUAL:
+		case MS_OP_GREATER:
+		case MS_OP_GREATER_EQUAL: {
+			if (!numbers && !strings) return false;
+			int cmp = strings ? ms_compareStrings(compiler->vm, a, b) : 0;
+#define COMPARE(op) (numbers ? x op y : cmp op 0)
+			bool res = op == MS_OP_LESS       ? COMPARE(<)
+			         : op == MS_OP_LESS_EQUAL ? COMPARE(<=)
+			         : op == MS_OP_GREATER    ? COMPARE(>)
+			         :                          COMPARE(>=);
+#undef COMPARE
+			*result = MS_FROM_NUM(res);
+			return true;
+		}
+
+		case MS_OP_AND:
+			*result = MS_FROM_NUM(ms_absClamp01(ms_getBoolVal(a) * ms_getBoolVal(b)));
+			return true;
+
+		case MS_OP_OR: {
+			double p = ms_getBoolVal(a), q = ms_getBoolVal(b);
+			*result = MS_FROM_NUM(ms_absClamp01(p + q - p * q));
+			return true;
+		}
+
+		default: return false;
+	}
+}
+
 static void binary(ms_Compiler *compiler)
 {
 	ms_TokenType operatorType = compiler->previous.type;
 	ParseRule *rule = getRule(operatorType);
+	Record *rec = compiler->currentRecord;
+
+	// what's known about the left operand has to be kept before compiling the right one
+	size_t lhsEnd = compiler->currentCode->count;
+	ms_Value a, b;
+	bool lhsConstant = constantOnTop(compiler, &a);
+	size_t lhsStart = rec->constantStart;
+	bool lhsAdded = rec->constantAdded;
+	bool lhsNumber = rec->numberEnd == lhsEnd, lhsNegZero = rec->mayBeNegZero;
+
 	parsePrecedence(compiler, (ParsePrecedence)(rule->precedence + 1));
 
+	ms_Opcode op;
 	switch (operatorType)
 	{
-		case MS_TOK_PLUS:    emitByte(compiler, MS_OP_ADD);           break;
-		case MS_TOK_MINUS:   emitByte(compiler, MS_OP_SUBTRACT);      break;
-		case MS_TOK_STAR:    emitByte(compiler, MS_OP_MULTIPLY);      break;
-		case MS_TOK_SLASH:   emitByte(compiler, MS_OP_DIVIDE);        break;
-		case MS_TOK_PERCENT: emitByte(compiler, MS_OP_MODULO);        break;
-		case MS_TOK_CARET:   emitByte(compiler, MS_OP_POWER);         break;
-
-		case MS_TOK_NEQ:     emitByte(compiler, MS_OP_NOT_EQUAL);     break;
-		case MS_TOK_EQUAL:   emitByte(compiler, MS_OP_EQUAL);         break;
-		case MS_TOK_LESS:    emitByte(compiler, MS_OP_LESS);          break;
-		case MS_TOK_GREATER: emitByte(compiler, MS_OP_GREATER);       break;
-		case MS_TOK_LEQ:     emitByte(compiler, MS_OP_LESS_EQUAL);    break;
-		case MS_TOK_GEQ:     emitByte(compiler, MS_OP_GREATER_EQUAL); break;
-
-		case MS_TOK_AND:     emitByte(compiler, MS_OP_AND);           break;
-		case MS_TOK_OR:      emitByte(compiler, MS_OP_OR);            break;
+		case MS_TOK_PLUS:    op = MS_OP_ADD;           break;
+		case MS_TOK_MINUS:   op = MS_OP_SUBTRACT;      break;
+		case MS_TOK_STAR:    op = MS_OP_MULTIPLY;      break;
+		case MS_TOK_SLASH:   op = MS_OP_DIVIDE;        break;
+		case MS_TOK_PERCENT: op = MS_OP_MODULO;        break;
+		case MS_TOK_CARET:   op = MS_OP_POWER;         break;
+
+		case MS_TOK_NEQ:     op = MS_OP_NOT_EQUAL;     break;
+		case MS_TOK_EQUAL:   op = MS_OP_EQUAL;         break;
+		case MS_TOK_LESS:    op = MS_OP_LESS;          break;
+		case MS_TOK_GREATER: op = MS_OP_GREATER;       break;
+		case MS_TOK_LEQ:     op = MS_OP_LESS_EQUAL;    break;
+		case MS_TOK_GEQ:     op = MS_OP_GREATER_EQUAL; break;
+
+		case MS_TOK_AND:     op = MS_OP_AND;           break;
+		case MS_TOK_OR:      op = MS_OP_OR;            break;
 		default: return; // unreachable
 	}
+
+	bool rhsConstant = rec->constantStart == lhsEnd && constantOnTop(compiler, &b);
+	bool rhsAdded = rec->constantAdded;
+	bool rhsNumber = rec->numberEnd == compiler->currentCode->count;
+
+	ms_Value result;
+	if (lhsConstant && rhsConstant && foldBinary(compiler, op, a, b, &result))
+	{
+		dropConstants(compiler, lhsStart, lhsAdded + rhsAdded);
+		emitConstant(compiler, result);
+		return;
+	}
+
+	if (rhsConstant && MS_IS_NUM(b))
+	{
+		// x * 1, x / 1, x - 0 and x + -0 are x for any number, x + 0 too unless x is -0
+		double y = MS_TO_NUM(b);
+		bool identity = lhsNumber
+			&& (((op == MS_OP_MULTIPLY || op == MS_OP_DIVIDE) && y == 1)
+			 || (op == MS_OP_SUBTRACT && y == 0 && !signbit(y))
+			 || (op == MS_OP_ADD && y == 0 && (signbit(y) || !lhsNegZero)));
+
+		if (identity)
+		{
+			dropConstants(compiler, lhsEnd, rhsAdded);
+			markNumber(compiler, lhsNegZero);
+			return;
+		}
+
+		if (op == MS_OP_POWER && y == 2)
+		{
+			dropConstants(compiler, lhsEnd, rhsAdded);
+			emitByte(compiler, MS_OP_SQUARE);
+			markNumber(compiler, true);
+			return;
+		}
+	}
+
+	emitByte(compiler, op);
+	switch (op)
+	{
+		case MS_OP_ADD:
+		case MS_OP_SUBTRACT:
+		case MS_OP_MULTIPLY:
+		case MS_OP_DIVIDE:
+			// strings and lists can be added and such too
+			if (lhsNumber && rhsNumber) markNumber(compiler, true);
+			break;
+
+		case MS_OP_MODULO:
+		case MS_OP_POWER: markNumber(compiler, true); break;
+
+		// comparisons and the fuzzy logic never give -0
+		default: markNumber(compiler, false); break;
+	}
 }
 
 static void grouping(ms_Compiler *compiler)
@@ -377,22 +869,43 @@ static void number(ms_Compiler *compiler)
 
 static void string(ms_Compiler *compiler)
 {
-	char* str = MS_MEM_MALLOC_ARR(compiler->vm, char, compiler->previous.length);
-	size_t realLen = 0;
-
 	ms_Token tok = compiler->previous;
-	for (int i = 1; i < tok.length-1; i++)
+	const char *start = tok.start + 1;
+	int length = tok.length - 2;
+
+	int quotes = 0;
+	for (int i = 0; i < length; i++)
+		if (start[i] == '"') quotes++, i++;
+
+	// without escaped quotes the literal is already the string's contents
+	if (quotes == 0)
+	{
+		emitConstant(compiler, MS_FROM_OBJ(ms_copyString(compiler->vm, start, length)));
+		return;
+	}
+
+	ms_ObjString *str = ms_allocateString(compiler->vm, length - quotes);
+	for (int i = 0, realLen = 0; i < length; i++)
 	{
-		char c = tok.start[i];
-		if (c == '"' && tok.start[i+1] == '"') i++;
-		str[realLen] = c;
-		realLen++;
+		if (start[i] == '"') i++;
+		str->chars[realLen++] = start[i];
 	}
 
-	str = MS_MEM_REALLOC_ARR(compiler->vm, char, str, tok.length, realLen + 1);
-	str[realLen] = '\0';
+	emitConstant(compiler, MS_FROM_OBJ(ms_internString(compiler->vm, str)));
+}
 
-	emitConstant(compiler, MS_FROM_OBJ(ms_newString(compiler->vm, str, realLen)));
+// pushes the variable's value as is, without calling it
+static void getVariable(ms_Compiler *compiler, ms_Token *name)
+{
+	int arg = resolveLocal(compiler, name);
+	if (arg != -1)
+		emitBytes(compiler, MS_OP_GET_LOCAL, arg);
+	else
+	{
+		arg = resolveGlobal(compiler, name);
+		if (arg == -1) error(compiler, "Undefined variable");
+		emitGlobal(compiler, MS_OP_GET_GLOBAL, arg);
+	}
 }
 
 static void variable(ms_Compiler *compiler)
@@ -400,24 +913,103 @@ static void variable(ms_Compiler *compiler)
 	ms_TokenType prefix = compiler->previous.type;
 	if (prefix == MS_TOK_AT_SIGN) advance(compiler);
 
-	uint8_t get;
-	int arg = resolveLocal(compiler, &compiler->previous);
+	getVariable(compiler, &compiler->previous);
+	if (prefix == MS_TOK_AT_SIGN) return;
 
-	if (arg == -2) error(compiler, "Undefined variable");
+	int argCount = 0;
+	if (match(compiler, MS_TOK_LPAREN) && !match(compiler, MS_TOK_RPAREN))
+	{
+		do
+		{
+			expression(compiler);
+			if (argCount == UINT8_MAX) error(compiler, "Too many arguments");
+			argCount++;
+		} while (match(compiler, MS_TOK_COMMA));
+		consume(compiler, MS_TOK_RPAREN, "Expected ')' after arguments");
+	}
 
-	if (arg != -1)
-		get = MS_OP_GET_LOCAL;
+	compiler->currentRecord->lastInvoke = compiler->currentCode->count;
+	emitBytes(compiler, MS_OP_INVOKE, (uint8_t)argCount);
+}
+
+static void list(ms_Compiler *compiler)
+{
+	// items can go over several lines
+	size_t count = 0;
+	skipNewlines(compiler);
+	while (!check(compiler, MS_TOK_RSQUARE))
+	{
+		expression(compiler);
+		count++;
+		skipNewlines(compiler);
+		if (!match(compiler, MS_TOK_COMMA)) break;
+		skipNewlines(compiler);
+	}
+	consume(compiler, MS_TOK_RSQUARE, "Expected ']' after list items");
+
+	if (count > UINT16_MAX)
+	{
+		error(compiler, "Too many items in a list literal");
+		return;
+	}
+
+	emitByte(compiler, MS_OP_BUILD_LIST);
+	emitByte(compiler, (count >> 8) & 0xff);
+	emitByte(compiler,  count       & 0xff);
+}
+
+static void map(ms_Compiler *compiler)
+{
+	// like list items, pairs can go over several lines
+	size_t count = 0;
+	skipNewlines(compiler);
+	while (!check(compiler, MS_TOK_RBRACE))
+	{
+		expression(compiler);
+		skipNewlines(compiler);
+		consume(compiler, MS_TOK_COLON, "Expected ':' after map key");
+		skipNewlines(compiler);
+		expression(compiler);
+		count++;
+		skipNewlines(compiler);
+		if (!match(compiler, MS_TOK_COMMA)) break;
+		skipNewlines(compiler);
+	}
+	consume(compiler, MS_TOK_RBRACE, "Expected '}' after map items");
+
+	if (count > UINT16_MAX)
+	{
+		error(compiler, "Too many items in a map literal");
+		return;
+	}
+
+	emitByte(compiler, MS_OP_BUILD_MAP);
+	emitByte(compiler, (count >> 8) & 0xff);
+	emitByte(compiler,  count       & 0xff);
+}
+
+// `a[i]`, or a slice: `a[i:j]`, where either end can be left out
+static void subscript(ms_Compiler *compiler)
+{
+	if (check(compiler, MS_TOK_COLON))
+		emitByte(compiler, MS_OP_NULL);
 	else
+		expression(compiler);
+
+	if (!match(compiler, MS_TOK_COLON))
 	{
-		arg = identifierConstant(compiler, &compiler->previous);
-		get = MS_OP_GET_GLOBAL;
+		consume(compiler, MS_TOK_RSQUARE, "Expected ']' after index");
+		emitByte(compiler, MS_OP_GET_INDEX);
+		return;
 	}
 
-	emitBytes(compiler, get, arg);
+	if (check(compiler, MS_TOK_RSQUARE))
+		emitByte(compiler, MS_OP_NULL);
+	else
+		expression(compiler);
 
-	if (prefix != MS_TOK_AT_SIGN)
-		// TODO: arguments
-		emitBytes(compiler, MS_OP_INVOKE, 0);
+	consume(compiler, MS_TOK_RSQUARE, "Expected ']' after slice");
+	emitByte(compiler, MS_OP_SLICE);
 }
 
 static void function(ms_Compiler *compiler)
@@ -426,7 +1018,18 @@ static void function(ms_Compiler *compiler)
 	initRecord(compiler, &record, TYPE_FUNCTION);
 	beginScope(compiler);
 
-	// no params for now
+	// TODO: default values
+	if (match(compiler, MS_TOK_LPAREN) && !match(compiler, MS_TOK_RPAREN))
+	{
+		do
+		{
+			consume(compiler, MS_TOK_ID, "Expected parameter name");
+			if (addLocal(compiler, compiler->previous) != -1)
+				record.function->arity++;
+		} while (match(compiler, MS_TOK_COMMA));
+		consume(compiler, MS_TOK_RPAREN, "Expected ')' after parameters");
+	}
+
 	consume(compiler, MS_TOK_NEWLINE, "Expected newline after 'function'");
 
 	block(compiler, MS_TOK_END_FUNC);
@@ -434,17 +1037,21 @@ static void function(ms_Compiler *compiler)
 	consume(compiler, MS_TOK_END_FUNC, "Expected 'end function'");
 	
 	ms_ObjFunction *function = endCompiler(compiler);
-	emitBytes(compiler, MS_OP_CONST, makeConstant(compiler, MS_FROM_OBJ(function)));
+	emitConstant(compiler, MS_FROM_OBJ(function));
 }
 
 static void literal(ms_Compiler *compiler)
 {
+	Record *rec = compiler->currentRecord;
+	rec->constantStart = compiler->currentCode->count;
+	rec->constantAdded = false;
+
 	ms_TokenType operatorType = compiler->previous.type;
 	switch (operatorType)
 	{
 		case MS_TOK_NULL:  emitByte(compiler, MS_OP_NULL);  break;
-		case MS_TOK_TRUE:  emitByte(compiler, MS_OP_TRUE);  break;
-		case MS_TOK_FALSE: emitByte(compiler, MS_OP_FALSE); break;
+		case MS_TOK_TRUE:  emitByte(compiler, MS_OP_TRUE);  markNumber(compiler, false); break;
+		case MS_TOK_FALSE: emitByte(compiler, MS_OP_FALSE); markNumber(compiler, false); break;
 		default: return; // unreachable
 	}
 }
@@ -452,13 +1059,32 @@ static void literal(ms_Compiler *compiler)
 static void unary(ms_Compiler *compiler)
 {
 	ms_TokenType operatorType = compiler->previous.type;
+	size_t start = compiler->currentCode->count;
 	parsePrecedence(compiler, PREC_UNARY);
+
+	ms_Opcode op;
 	switch (operatorType)
 	{
-		case MS_TOK_MINUS: emitByte(compiler, MS_OP_NEGATE); break;
-		case MS_TOK_NOT:   emitByte(compiler, MS_OP_NOT);    break;
+		case MS_TOK_MINUS: op = MS_OP_NEGATE; break;
+		case MS_TOK_NOT:   op = MS_OP_NOT;    break;
 		default: MS_UNREACHABLE("unary");
 	}
+
+	Record *rec = compiler->currentRecord;
+	ms_Value value;
+	if (rec->constantStart == start && constantOnTop(compiler, &value)
+	 && (op == MS_OP_NOT || MS_IS_NUM(value)))
+	{
+		double result = op == MS_OP_NEGATE
+			? -ms_absClamp01(MS_TO_NUM(value))
+			: 1 - ms_absClamp01(ms_getBoolVal(value));
+		dropConstants(compiler, start, rec->constantAdded);
+		emitConstant(compiler, MS_FROM_NUM(result));
+		return;
+	}
+
+	emitByte(compiler, op);
+	markNumber(compiler, op == MS_OP_NEGATE);
 }
 
 ParseRule rules[MS_TOK__END] = {
@@ -483,6 +1109,8 @@ ParseRule rules[MS_TOK__END] = {
 	[MS_TOK_AT_SIGN] = {variable, NULL,   PREC_NONE      },
 
 	[MS_TOK_LPAREN]  = {grouping, NULL,   PREC_NONE      },
+	[MS_TOK_LSQUARE] = {list,     subscript, PREC_CALL      },
+	[MS_TOK_LBRACE]  = {map,      NULL,   PREC_NONE      },
 
 	[MS_TOK_TRUE]    = {literal,  NULL,   PREC_NONE      },
 	[MS_TOK_FALSE]   = {literal,  NULL,   PREC_NONE      },
@@ -524,30 +1152,59 @@ static void expression(ms_Compiler *compiler)
 
 ////////////////////////////
 
+// `a[i] = x`, with as many indices as needed. all but the last are read as usual
+static void indexAssignment(ms_Compiler *compiler, ms_Token *name)
+{
+	getVariable(compiler, name);
+
+	consume(compiler, MS_TOK_LSQUARE, "Expected '['");
+	expression(compiler);
+	consume(compiler, MS_TOK_RSQUARE, "Expected ']' after index");
+
+	while (match(compiler, MS_TOK_LSQUARE))
+	{
+		emitByte(compiler, MS_OP_GET_INDEX);
+		expression(compiler);
+		consume(compiler, MS_TOK_RSQUARE, "Expected ']' after index");
+	}
+
+	consume(compiler, MS_TOK_ASSIGN, "Expected '=' after index");
+	expression(compiler);
+	emitByte(compiler, MS_OP_SET_INDEX);
+	consume(compiler, MS_TOK_NEWLINE, "Expected newline after expression");
+}
+
 static void assignment(ms_Compiler *compiler)
 {
 	if (check(compiler, MS_TOK_ID))
 	{
 		advance(compiler);
 
-		uint8_t set = MS_OP_SET_LOCAL;
-		int arg = resolveLocal(compiler, &compiler->previous);
-		if ((arg == -2 && compiler->currentRecord->scopeDepth == 0) || arg == -1)
-		{
-			arg = identifierConstant(compiler, &compiler->previous);
-			set = MS_OP_SET_GLOBAL;
-		}
-		else
+		ms_Token name = compiler->previous;
+		if (check(compiler, MS_TOK_LSQUARE))
 		{
-			arg = -3;
-			addLocal(compiler, compiler->previous);
+			indexAssignment(compiler, &name);
+			return;
 		}
 
+		// assignments at the top level always go to globals, while
+		// in functions they create a local unless one already exists
+		int local = resolveLocal(compiler, &name);
+		int global = -1;
+		if (local == -1 && compiler->currentRecord->type == TYPE_SCRIPT)
+			global = declareGlobal(compiler, &name);
+
 		consume(compiler, MS_TOK_ASSIGN, "Expected '=' after variable name");
 		expression(compiler);
 		consume(compiler, MS_TOK_NEWLINE, "Expected newline after expression");
 
-		if (arg != -3) emitBytes(compiler, set, arg);
+		if (global != -1)
+			emitGlobal(compiler, MS_OP_SET_GLOBAL, global);
+		else if (local != -1)
+			emitBytes(compiler, MS_OP_SET_LOCAL, local);
+		else
+			// the value is already sitting in the new local's slot
+			addLocal(compiler, name);
 	}
 	else errorAtCurrent(compiler, "Expected identifier");
 }
@@ -571,6 +1228,51 @@ static void ifStatement(ms_Compiler *compiler)
 	patchJump(compiler, endJump);
 }
 
+// `for x in seq`. the sequence and how far into it the loop got are kept in
+// two hidden locals, right above the loop variable's slot if it needs a new one
+static void forStatement(ms_Compiler *compiler)
+{
+	consume(compiler, MS_TOK_ID, "Expected variable name after 'for'");
+	ms_Token name = compiler->previous;
+	consume(compiler, MS_TOK_IN, "Expected 'in' after variable name");
+
+	beginScope(compiler);
+
+	// the same rules as for assignments
+	int local = resolveLocal(compiler, &name);
+	int global = -1;
+	if (local == -1 && compiler->currentRecord->type == TYPE_SCRIPT)
+		global = declareGlobal(compiler, &name);
+	bool newLocal = local == -1 && global == -1;
+	if (newLocal) emitByte(compiler, MS_OP_NULL);
+
+	expression(compiler);
+	emitByte(compiler, MS_OP_FALSE);
+
+	// only declared now, so the sequence can't refer to the loop variable's new slot
+	ms_Token hidden = { .start = "", .length = 0, .line = name.line };
+	if (newLocal) local = addLocal(compiler, name);
+	addLocal(compiler, hidden);
+	addLocal(compiler, hidden);
+
+	size_t loopStart = compiler->currentCode->count;
+	size_t exitJump = emitJump(compiler, MS_OP_FOR_ITER);
+	// after the jump, so that errors while iterating point at the `for`
+	consume(compiler, MS_TOK_NEWLINE, "Expected newline after expression");
+	if (global != -1)
+		emitGlobal(compiler, MS_OP_SET_GLOBAL, global);
+	else
+		emitBytes(compiler, MS_OP_SET_LOCAL, (uint8_t)local);
+
+	block(compiler, MS_TOK_END_FOR);
+
+	consume(compiler, MS_TOK_END_FOR, "Expected 'end for'");
+
+	emitLoop(compiler, loopStart);
+	patchJump(compiler, exitJump);
+	endScope(compiler);
+}
+
 static void statement(ms_Compiler *compiler)
 {
 	if (checkKeyword(compiler)
@@ -586,7 +1288,7 @@ static void statement(ms_Compiler *compiler)
 				break;
 
 			case MS_TOK_WHILE: {
-				int loopStart = compiler->currentCode->count;
+				size_t loopStart = compiler->currentCode->count;
 				expression(compiler);
 				consume(compiler, MS_TOK_NEWLINE, "Expected newline after expression");
 
@@ -603,6 +1305,10 @@ static void statement(ms_Compiler *compiler)
 				emitByte(compiler, MS_OP_POP);
 			} break;
 
+			case MS_TOK_FOR:
+				forStatement(compiler);
+				break;
+
 			case MS_TOK_RETURN: {
 				if (match(compiler, MS_TOK_NEWLINE))
 					emitReturn(compiler);
@@ -610,6 +1316,13 @@ static void statement(ms_Compiler *compiler)
 				{
 					expression(compiler);
 					consume(compiler, MS_TOK_NEWLINE, "Expected newline after expression");
+
+					// the call's result would be returned as is, so the callee can take
+					// over this frame. the RETURN is still needed when it's not a function
+					ms_Code *code = compiler->currentCode;
+					size_t invoke = compiler->currentRecord->lastInvoke;
+					if (invoke == code->count - 2 && code->data[invoke] == MS_OP_INVOKE)
+						code->data[invoke] = MS_OP_TAIL_INVOKE;
 					emitByte(compiler, MS_OP_RETURN);
 				}
 			} break;
@@ -627,13 +1340,24 @@ static void statement(ms_Compiler *compiler)
 static void program(ms_Compiler *compiler)
 {
 	skipNewlines(compiler);
-	while (!match(compiler, MS_TOK_EOF))
+	// only the first error is reported, and the parser doesn't try to resync
+	// after it, so there's no point in going on (it could get stuck, even)
+	while (!compiler->hadError && !match(compiler, MS_TOK_EOF))
 	{
 		statement(compiler);
 		skipNewlines(compiler);
 	}
 }
 
+void ms_markCompilerRoots(ms_VM *vm)
+{
+	ms_Compiler *compiler = vm->compiler;
+	if (compiler == NULL) return;
+
+	for (Record *rec = compiler->currentRecord; rec != NULL; rec = rec->enclosing)
+		ms_markObject(vm, (ms_Object*)rec->function);
+}
+
 ms_ObjFunction *ms_compileString(ms_VM* vm, char *source)
 {
 #ifdef MS_DEBUG_COMPILATION
@@ -641,29 +1365,50 @@ ms_ObjFunction *ms_compileString(ms_VM* vm, char *source)
 #endif
 	ms_Scanner scanner;
 	ms_initScanner(&scanner, source);
+#ifdef MS_DEBUG_COMPILATION
 	ms_debugScanner(source);
+#endif
 
 	ms_Compiler compiler;
-	initCompiler(&compiler, vm, scanner);
+	ms_Compiler *enclosingCompiler = vm->compiler;
+	vm->compiler = &compiler;
+
+	bool wideJumps = false;
+	ms_ObjFunction *function;
+	for (;;)
+	{
+		initCompiler(&compiler, vm, scanner);
+		compiler.wideJumps = wideJumps;
 
-	Record rec;
-	initRecord(&compiler, &rec, TYPE_SCRIPT);
+		Record rec;
+		initRecord(&compiler, &rec, TYPE_SCRIPT);
 
-	advance(&compiler);
+		advance(&compiler);
 
 #ifdef MS_DEBUG_COMPILATION
-	fprintf(stderr, "compiler: set-up complete, starting compilation...\n");
+		fprintf(stderr, "compiler: set-up complete, starting compilation...\n");
 #endif
 
-	program(&compiler);
+		program(&compiler);
 
 #ifdef MS_DEBUG_COMPILATION
-	fprintf(stderr,
-		"compiler: compilation finished %ssuccessfully\n",
-		compiler.hadError ? "un" : ""
-	);
+		fprintf(stderr,
+			"compiler: compilation finished %ssuccessfully\n",
+			compiler.hadError ? "un" : ""
+		);
 #endif
 
-	ms_ObjFunction *function = endCompiler(&compiler);
+		function = endCompiler(&compiler);
+		freeCompiler(&compiler);
+		if (compiler.hadError || !compiler.needsWideJumps) break;
+
+		// rare enough that it's not worth patching the code in place:
+		// globals are already declared, so it compiles to the same slots
+#ifdef MS_DEBUG_COMPILATION
+		fprintf(stderr, "compiler: a jump didn't fit, compiling again with wide jumps\n");
+#endif
+		wideJumps = true;
+	}
+	vm->compiler = enclosingCompiler;
 	return compiler.hadError ? NULL : function;
 }
@@ -4,5 +4,6 @@
 #include "ms_object.h"
 
 ms_ObjFunction *ms_compileString(ms_VM* vm, char *source);
+void ms_markCompilerRoots(ms_VM *vm);
 
 #endif
@@ -28,12 +28,27 @@ static size_t constantInstruction(uint8_t *code, ms_List constants, size_t offse
 	return offset + 2;
 }
 
+static size_t longConstantInstruction(uint8_t *code, ms_List constants, size_t offset)
+{
+	size_t index = (size_t)code[1] << 16 | code[2] << 8 | code[3];
+	printf("%s %zu '", ms_getOpcodeName(*code), index);
+	ms_printValue(constants.data[index]);
+	printf("'");
+	return offset + 4;
+}
+
 static size_t byteInstruction(uint8_t *code, size_t offset)
 {
 	printf("%s %4d", ms_getOpcodeName(*code), code[1]);
 	return offset + 2;
 }
 
+static size_t shortInstruction(uint8_t *code, size_t offset)
+{
+	printf("%s %4d", ms_getOpcodeName(*code), (uint16_t)(code[1] << 8) | code[2]);
+	return offset + 3;
+}
+
 static size_t jumpInstruction(uint8_t *code, size_t offset, int sign)
 {
 	uint16_t jump = (uint16_t)(code[1] << 8) | code[2];
@@ -41,29 +56,62 @@ static size_t jumpInstruction(uint8_t *code, size_t offset, int sign)
 	return offset + 3;
 }
 
+static size_t longJumpInstruction(uint8_t *code, size_t offset, int sign)
+{
+	size_t jump = (size_t)code[1] << 16 | code[2] << 8 | code[3];
+	printf("%s %zu -> %zu", ms_getOpcodeName(*code), offset, offset + 4 + sign * jump);
+	return offset + 4;
+}
+
 size_t ms_disassembleInstruction(ms_Code *code, size_t offset)
 {
 	printf("%zu | ", offset);
+	int line = ms_getCodeLine(code, offset);
+	if (offset > 0 && line == ms_getCodeLine(code, offset - 1)) printf("   | ");
+	else printf("%4d ", line);
 	uint8_t *off = code->data + offset;
 	switch (*off)
 	{
 		case MS_OP_CONST:
+		case MS_OP_ADD_CONST:
+		case MS_OP_ADD_CONST_NUM:
+			return constantInstruction(off, code->constants, offset);
+		case MS_OP_CONST_LONG:
+			return longConstantInstruction(off, code->constants, offset);
+
 		case MS_OP_SET_GLOBAL:
 		case MS_OP_GET_GLOBAL:
-			return constantInstruction(off, code->constants, offset);
+		case MS_OP_GET_GLOBAL_INVOKE:
+		case MS_OP_BUILD_LIST:
+		case MS_OP_BUILD_MAP:
+			return shortInstruction(off, offset);
 
 		case MS_OP_SET_LOCAL:
 		case MS_OP_GET_LOCAL:
 		case MS_OP_INVOKE:
+		case MS_OP_TAIL_INVOKE:
+		case MS_OP_GET_LOCAL_INVOKE:
 			return byteInstruction(off, offset);
 
 		case MS_OP_JUMP:
 		case MS_OP_JUMP_IF_FALSE:
+		case MS_OP_POP_JUMP_IF_FALSE:
+		case MS_OP_LESS_JUMP_IF_FALSE:
+		case MS_OP_LESS_NUM_JUMP_IF_FALSE:
+		case MS_OP_FOR_ITER:
 			return jumpInstruction(off, offset, 1);
 
 		case MS_OP_LOOP:
 			return jumpInstruction(off, offset, -1);
 
+		case MS_OP_JUMP_LONG:
+		case MS_OP_JUMP_IF_FALSE_LONG:
+		case MS_OP_FOR_ITER_LONG:
+			return longJumpInstruction(off, offset, 1);
+
+		case MS_OP_LOOP_LONG:
+			return longJumpInstruction(off, offset, -1);
+
 		case MS_OP_TRUE:
 		case MS_OP_FALSE:
 		case MS_OP_NULL:
@@ -72,6 +120,7 @@ size_t ms_disassembleInstruction(ms_Code *code, size_t offset)
 		case MS_OP_MULTIPLY:
 		case MS_OP_DIVIDE:
 		case MS_OP_NEGATE:
+		case MS_OP_SQUARE:
 		case MS_OP_MODULO:
 		case MS_OP_POWER:
 		case MS_OP_EQUAL:
@@ -83,8 +132,21 @@ size_t ms_disassembleInstruction(ms_Code *code, size_t offset)
 		case MS_OP_AND:
 		case MS_OP_OR:
 		case MS_OP_NOT:
+		case MS_OP_GET_INDEX:
+		case MS_OP_SET_INDEX:
+		case MS_OP_SLICE:
 		case MS_OP_POP:
 		case MS_OP_RETURN:
+		case MS_OP_ADD_NUM_NUM:
+		case MS_OP_SUBTRACT_NUM_NUM:
+		case MS_OP_MULTIPLY_NUM_NUM:
+		case MS_OP_DIVIDE_NUM_NUM:
+		case MS_OP_EQUAL_NUM_NUM:
+		case MS_OP_NOT_EQUAL_NUM_NUM:
+		case MS_OP_LESS_NUM_NUM:
+		case MS_OP_LESS_EQUAL_NUM_NUM:
+		case MS_OP_GREATER_NUM_NUM:
+		case MS_OP_GREATER_EQUAL_NUM_NUM:
 			return simpleInstruction(off, offset);
 
 		default:
@@ -105,3 +167,39 @@ void ms_disassembleCode(ms_Code *code, const char *name)
 		putchar('\n');
 	}
 }
+
+#ifdef MS_PROFILE_OPCODES
+uint64_t ms_opcodePairCounts[MS_OP__END][MS_OP__END];
+
+void ms_printOpcodePairProfile(int top)
+{
+	uint64_t total = 0;
+	for (int a = 0; a < MS_OP__END; a++)
+		for (int b = 0; b < MS_OP__END; b++)
+			total += ms_opcodePairCounts[a][b];
+
+	printf("---- opcode pairs (%llu executed) ----\n", (unsigned long long)total);
+
+	// selection is fine, there are less than a thousand pairs
+	bool printed[MS_OP__END][MS_OP__END] = {{false}};
+	for (int i = 0; i < top; i++)
+	{
+		int bestA = -1, bestB = -1;
+		for (int a = 0; a < MS_OP__END; a++)
+			for (int b = 0; b < MS_OP__END; b++)
+				if (!printed[a][b] && ms_opcodePairCounts[a][b] > 0
+				&& (bestA == -1 || ms_opcodePairCounts[a][b] > ms_opcodePairCounts[bestA][bestB]))
+				{
+					bestA = a;
+					bestB = b;
+				}
+
+		if (bestA == -1) break;
+		printed[bestA][bestB] = true;
+
+		uint64_t count = ms_opcodePairCounts[bestA][bestB];
+		printf("%5.2f%% %-22s %s\n", 100.0 * count / total,
+			ms_getOpcodeName(bestA), ms_getOpcodeName(bestB));
+	}
+}
+#endif
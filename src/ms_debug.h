@@ -7,4 +7,10 @@ const char *ms_getOpcodeName(ms_Opcode op);
 size_t ms_disassembleInstruction(ms_Code *code, size_t offset);
 void ms_disassembleCode(ms_Code *code, const char *name);
 
+#ifdef MS_PROFILE_OPCODES
+// how many times each opcode (second index) ran right after another (first index)
+extern uint64_t ms_opcodePairCounts[MS_OP__END][MS_OP__END];
+void ms_printOpcodePairProfile(int top);
+#endif
+
 #endif
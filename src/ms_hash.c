@@ -0,0 +1,159 @@
+#include <string.h>
+#include <time.h>
+
+#include "ms_common.h"
+#include "ms_hash.h"
+
+// splitmix64's finalizer, good enough to spread a seed over all 64 bits
+static inline uint64_t mixSeed(uint64_t x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+uint64_t ms_newHashSeed(const void *vm)
+{
+	// the VM's address changes from run to run with ASLR, the time covers the rest
+	return ms_prepareHashSeed((uint64_t)(uintptr_t)vm ^ mixSeed((uint64_t)time(NULL)));
+}
+
+#ifdef MS_HASH_FNV1A
+
+uint64_t ms_prepareHashSeed(uint64_t seed)
+{
+	return mixSeed(seed);
+}
+
+uint32_t ms_hashMem(const void *ptr, size_t length, uint64_t seed)
+{
+	const uint8_t *p = ptr;
+
+	uint32_t hash = 2166136261u ^ (uint32_t)(seed ^ (seed >> 32));
+	for (size_t i = 0; i < length; i++)
+		hash = (hash ^ p[i]) * 16777619;
+
+	return hash;
+}
+
+#else
+
+// the structure is wyhash's (https://github.com/wangyi-fudan/wyhash,
+// public domain): everything goes through 64x64->128 bit multiplies,
+// folded back to 64 bits, eating 16 or 48 bytes per round
+
+static const uint64_t secret[4] = {
+	0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+	0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull,
+};
+
+// multiplies a and b, leaving the low half in a and the high half in b
+static inline void mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+	__extension__ unsigned __int128 r = (unsigned __int128)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b)
+{
+	mum(&a, &b);
+	return a ^ b;
+}
+
+// unaligned little-endian-ish reads; on big endian machines the hash
+// values differ, which is fine since they never leave the process
+static inline uint64_t read64(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof v);
+	return v;
+}
+
+static inline uint64_t read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof v);
+	return v;
+}
+
+// 1 to 3 bytes, reading the first, middle and last one
+static inline uint64_t read3(const uint8_t *p, size_t k)
+{
+	return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+uint64_t ms_prepareHashSeed(uint64_t seed)
+{
+	return seed ^ mix(seed ^ secret[0], secret[1]);
+}
+
+uint32_t ms_hashMem(const void *ptr, size_t length, uint64_t seed)
+{
+	const uint8_t *p = ptr;
+	uint64_t a, b;
+
+	if (length <= 16)
+	{
+		if (length >= 4)
+		{
+			// two overlapping pairs of 4 byte reads cover anything from 4 to 16
+			size_t mid = (length >> 3) << 2;
+			a = (read32(p) << 32) | read32(p + mid);
+			b = (read32(p + length - 4) << 32) | read32(p + length - 4 - mid);
+		}
+		else if (length > 0)
+		{
+			a = read3(p, length);
+			b = 0;
+		}
+		else a = b = 0;
+	}
+	else
+	{
+		size_t i = length;
+		if (i > 48)
+		{
+			// three independent lanes, so the multiplies can overlap
+			uint64_t see1 = seed, see2 = seed;
+			do
+			{
+				seed = mix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+				see1 = mix(read64(p + 16) ^ secret[2], read64(p + 24) ^ see1);
+				see2 = mix(read64(p + 32) ^ secret[3], read64(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+
+		while (i > 16)
+		{
+			seed = mix(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+
+		// the last 16 bytes, overlapping what was already eaten if needed
+		a = read64(p + i - 16);
+		b = read64(p + i - 8);
+	}
+
+	a ^= secret[1];
+	b ^= seed;
+	mum(&a, &b);
+	uint64_t hash = mix(a ^ secret[0] ^ length, b ^ secret[1]);
+	return (uint32_t)(hash ^ (hash >> 32));
+}
+
+#endif // MS_HASH_FNV1A
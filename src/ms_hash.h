@@ -0,0 +1,18 @@
+#ifndef MS_HASH_H
+#define MS_HASH_H
+
+#include "ms_common.h"
+
+// string hashing. by default strings are hashed 8 bytes at a time with a
+// wyhash-style function; building with MS_HASH_FNV1A goes back to hashing
+// them a byte at a time with FNV-1a. either way the seed comes from the VM,
+// so the same string hashes differently in different VMs
+uint32_t ms_hashMem(const void *ptr, size_t length, uint64_t seed);
+
+// turns a user-given seed into what ms_hashMem takes, doing the
+// part of the work that only depends on the seed once instead of per string
+uint64_t ms_prepareHashSeed(uint64_t seed);
+// picks a seed for a new VM, already prepared
+uint64_t ms_newHashSeed(const void *vm);
+
+#endif
@@ -0,0 +1,196 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ms_common.h"
+#include "ms_list.h"
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_string.h"
+#include "ms_value.h"
+#include "ms_vm.h"
+
+static size_t resolveBound(ms_Value bound, size_t count, size_t ifNull)
+{
+	if (MS_IS_NULL(bound)) return ifNull;
+
+	double index = trunc(MS_TO_NUM(bound));
+	if (index < 0) index += count;
+	// NaN ends up here too
+	if (!(index > 0)) return 0;
+	if (index > count) return count;
+	return (size_t)index;
+}
+
+void ms_resolveSlice(ms_Value from, ms_Value to, size_t count, size_t *start, size_t *end)
+{
+	*start = resolveBound(from, count, 0);
+	*end = resolveBound(to, count, count);
+	if (*end < *start) *end = *start;
+}
+
+static inline size_t itemSize(bool numeric)
+{
+	return numeric ? sizeof(double) : sizeof(ms_Value);
+}
+
+// the list may be old while the values are young, which
+// happens whenever it was made with the nursery full
+static void rememberValues(ms_VM *vm, ms_ObjList *list)
+{
+	if (list->isNumeric) return;
+	for (size_t i = 0; i < list->count && !list->obj.isRemembered; i++)
+		ms_writeBarrier(vm, &list->obj, list->as.values[i]);
+}
+
+ms_ObjList *ms_newListFrom(ms_VM *vm, ms_Value *values, size_t count)
+{
+	bool numeric = true;
+	for (size_t i = 0; i < count && numeric; i++) numeric = MS_IS_NUM(values[i]);
+
+	ms_ObjList *list = ms_newList(vm, count, numeric);
+	if (count == 0) return list;
+
+	// collecting doesn't move the stack, `values` is still good
+	if (numeric)
+		for (size_t i = 0; i < count; i++) list->as.numbers[i] = MS_TO_NUM(values[i]);
+	else
+		memcpy(list->as.values, values, count * sizeof(ms_Value));
+	list->count = count;
+	rememberValues(vm, list);
+	return list;
+}
+
+ms_ObjList *ms_newNumericListFrom(ms_VM *vm, const double *numbers, size_t count)
+{
+	ms_ObjList *list = ms_newList(vm, count, true);
+	if (count > 0) memcpy(list->as.numbers, numbers, count * sizeof(double));
+	list->count = count;
+	return list;
+}
+
+// hands the list's items over to a new base, turning it into a view of all of them
+static void share(ms_VM *vm, ms_ObjList *list)
+{
+	ms_ObjList *base = ms_newList(vm, 0, list->isNumeric);
+	base->as = list->as;
+	base->count = list->count;
+	base->cap = list->cap;
+	rememberValues(vm, base);
+
+	list->cap = 0;
+	list->base = base;
+	ms_writeBarrier(vm, &list->obj, MS_FROM_OBJ(base));
+}
+
+ms_ObjList *ms_sliceList(ms_VM *vm, ms_ObjList *list, size_t start, size_t end)
+{
+	size_t count = end - start;
+	if (count <= MS_LIST_MIN_VIEW)
+	{
+		if (list->isNumeric) return ms_newNumericListFrom(vm, list->as.numbers + start, count);
+		return ms_newListFrom(vm, list->as.values + start, count);
+	}
+
+	if (list->base == NULL) share(vm, list);
+
+	ms_ObjList *slice = ms_newList(vm, 0, list->isNumeric);
+	slice->base = list->base;
+	if (list->isNumeric)
+		slice->as.numbers = list->as.numbers + start;
+	else
+		slice->as.values = list->as.values + start;
+	slice->count = count;
+	ms_writeBarrier(vm, &slice->obj, MS_FROM_OBJ(slice->base));
+	return slice;
+}
+
+// copies the list's items to `dest` as values
+static void copyValues(ms_Value *dest, ms_ObjList *list)
+{
+	if (list->isNumeric)
+		for (size_t i = 0; i < list->count; i++) dest[i] = MS_FROM_NUM(list->as.numbers[i]);
+	else if (list->count > 0)
+		memcpy(dest, list->as.values, list->count * sizeof(ms_Value));
+}
+
+ms_ObjList *ms_concatLists(ms_VM *vm, ms_ObjList *a, ms_ObjList *b)
+{
+	bool numeric = a->isNumeric && b->isNumeric;
+	ms_ObjList *list = ms_newList(vm, a->count + b->count, numeric);
+	if (numeric)
+	{
+		if (a->count > 0) memcpy(list->as.numbers, a->as.numbers, a->count * sizeof(double));
+		if (b->count > 0) memcpy(list->as.numbers + a->count, b->as.numbers, b->count * sizeof(double));
+	}
+	else
+	{
+		copyValues(list->as.values, a);
+		copyValues(list->as.values + a->count, b);
+	}
+	list->count = a->count + b->count;
+	rememberValues(vm, list);
+	return list;
+}
+
+void ms_ownListItems(ms_VM *vm, ms_ObjList *list)
+{
+	if (list->base == NULL) return;
+
+	size_t size = itemSize(list->isNumeric);
+	void *items = list->count > 0 ? MS_MEM_MALLOC(vm, list->count * size) : NULL;
+	if (list->count > 0) memcpy(items, list->as.values, list->count * size);
+
+	list->as.values = items;
+	list->cap = list->count;
+	list->base = NULL;
+	rememberValues(vm, list);
+}
+
+// turns a numeric list into a list of values, for good
+static void unspecialize(ms_VM *vm, ms_ObjList *list)
+{
+#ifdef MS_NAN_BOXING
+	// a boxed number is the number itself, the items can stay where they are
+	if (list->base == NULL)
+	{
+		list->isNumeric = false;
+		return;
+	}
+#endif
+
+	ms_Value *values = list->count > 0 ? MS_MEM_MALLOC_ARR(vm, ms_Value, list->count) : NULL;
+	copyValues(values, list);
+
+	if (list->base == NULL) MS_MEM_FREE_ARR(vm, double, list->as.numbers, list->cap);
+	list->as.values = values;
+	list->cap = list->count;
+	list->isNumeric = false;
+	list->base = NULL;
+}
+
+void ms_setListItem(ms_VM *vm, ms_ObjList *list, size_t index, ms_Value value)
+{
+	if (list->isNumeric && MS_IS_NUM(value))
+	{
+		ms_ownListItems(vm, list);
+		list->as.numbers[index] = MS_TO_NUM(value);
+		return;
+	}
+
+	if (list->isNumeric) unspecialize(vm, list);
+	else ms_ownListItems(vm, list);
+	list->as.values[index] = value;
+	ms_writeBarrier(vm, &list->obj, value);
+}
+
+void ms_printList(ms_ObjList *list)
+{
+	printf("[");
+	for (size_t i = 0; i < list->count; i++)
+	{
+		if (i > 0) printf(", ");
+		ms_printNestedValue(ms_getListItem(list, i));
+	}
+	printf("]");
+}
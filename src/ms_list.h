@@ -0,0 +1,70 @@
+#ifndef MS_LIST_H
+#define MS_LIST_H
+
+#include "ms_common.h"
+#include "ms_object.h"
+#include "ms_value.h"
+
+// what list literals, indexing and slicing build on.
+//
+// slicing a list makes a view instead of copying: the first time a list
+// is sliced its values are handed over to a hidden base list, which
+// nothing ever writes to, and both the list and the slice read them from
+// there. a view copies its values out for itself once it's written to,
+// so `a = a[1:]` in a loop costs the same however long `a` is
+//
+// lists made of nothing but numbers are numeric: they store plain doubles,
+// half the size of values (unless values are NaN-boxed), which the
+// collector doesn't have to look through and loops over them can be
+// vectorized (see ms_listops.h). writing anything but a number to one
+// turns it into a list of values for good
+//
+// like in ms_string.h, everything that takes a VM may collect: the lists
+// passed in have to be reachable from the VM's stack
+
+// slices up to this long are copied right away, a view isn't worth it
+#define MS_LIST_MIN_VIEW 16
+
+// turns a script's index into a position in something `count` long,
+// counting from the end when it's negative. false if it's out of range.
+// fractions are truncated first, like the reference implementation does
+static inline bool ms_resolveIndex(double index, size_t count, size_t *pos)
+{
+	if (index >= 0)
+	{
+		if (!(index < (double)count)) return false;
+		*pos = (size_t)index;
+		return true;
+	}
+
+	// also false for NaN
+	if (!(index > -(double)count - 1)) return false;
+	size_t back = (size_t)-index;
+	*pos = back == 0 ? 0 : count - back;
+	return *pos < count;
+}
+
+static inline ms_Value ms_getListItem(ms_ObjList *list, size_t index)
+{
+	return list->isNumeric ? MS_FROM_NUM(list->as.numbers[index]) : list->as.values[index];
+}
+
+// clamps a slice's bounds to [0, count] the same way, null meaning either end
+void ms_resolveSlice(ms_Value from, ms_Value to, size_t count, size_t *start, size_t *end);
+
+// a list with the `count` values starting at `values`, which may be on the
+// stack. it's numeric if they're all numbers
+ms_ObjList *ms_newListFrom(ms_VM *vm, ms_Value *values, size_t count);
+ms_ObjList *ms_newNumericListFrom(ms_VM *vm, const double *numbers, size_t count);
+// the values from `start` up to `end`, as a view when that's worth it
+ms_ObjList *ms_sliceList(ms_VM *vm, ms_ObjList *list, size_t start, size_t end);
+ms_ObjList *ms_concatLists(ms_VM *vm, ms_ObjList *a, ms_ObjList *b);
+// gives a view its own copy of the items, for before changing them
+void ms_ownListItems(ms_VM *vm, ms_ObjList *list);
+// a view stops sharing its items before being written to,
+// and a numeric list stops being one if `value` isn't a number
+void ms_setListItem(ms_VM *vm, ms_ObjList *list, size_t index, ms_Value value);
+
+void ms_printList(ms_ObjList *list);
+
+#endif
@@ -0,0 +1,352 @@
+#include <math.h>
+#include <string.h>
+
+#include "ms_common.h"
+#include "ms_list.h"
+#include "ms_listops.h"
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_string.h"
+#include "ms_value.h"
+
+// so that the additions don't all depend on the one before, which would
+// keep them from running at the same time. the result may differ from
+// adding left to right in the last bits
+static double sumNumbers(const double *restrict numbers, size_t count)
+{
+	double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		s0 += numbers[i];
+		s1 += numbers[i + 1];
+		s2 += numbers[i + 2];
+		s3 += numbers[i + 3];
+	}
+	for (; i < count; i++) s0 += numbers[i];
+	return (s0 + s1) + (s2 + s3);
+}
+
+double ms_sumList(ms_ObjList *list)
+{
+	if (list->isNumeric) return sumNumbers(list->as.numbers, list->count);
+
+	double sum = 0;
+	for (size_t i = 0; i < list->count; i++)
+		if (MS_IS_NUM(list->as.values[i])) sum += MS_TO_NUM(list->as.values[i]);
+	return sum;
+}
+
+// NaNs are skipped, every comparison with them is false
+#define MIN(a, b) ((b) < (a) ? (b) : (a))
+#define MAX(a, b) ((b) > (a) ? (b) : (a))
+
+static void minMaxNumbers(const double *restrict numbers, size_t count, double *min, double *max)
+{
+	double lo[4] = { INFINITY, INFINITY, INFINITY, INFINITY };
+	double hi[4] = { -INFINITY, -INFINITY, -INFINITY, -INFINITY };
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		for (int j = 0; j < 4; j++)
+		{
+			lo[j] = MIN(lo[j], numbers[i + j]);
+			hi[j] = MAX(hi[j], numbers[i + j]);
+		}
+	for (; i < count; i++)
+	{
+		lo[0] = MIN(lo[0], numbers[i]);
+		hi[0] = MAX(hi[0], numbers[i]);
+	}
+
+	*min = MIN(MIN(lo[0], lo[1]), MIN(lo[2], lo[3]));
+	*max = MAX(MAX(hi[0], hi[1]), MAX(hi[2], hi[3]));
+}
+
+bool ms_listMinMax(ms_ObjList *list, double *min, double *max)
+{
+	if (list->isNumeric)
+	{
+		if (list->count == 0) return false;
+		minMaxNumbers(list->as.numbers, list->count, min, max);
+		return true;
+	}
+
+	bool found = false;
+	*min = INFINITY;
+	*max = -INFINITY;
+	for (size_t i = 0; i < list->count; i++)
+	{
+		if (!MS_IS_NUM(list->as.values[i])) continue;
+		double num = MS_TO_NUM(list->as.values[i]);
+		*min = MIN(*min, num);
+		*max = MAX(*max, num);
+		found = true;
+	}
+	return found;
+}
+
+#undef MIN
+#undef MAX
+
+// four at a time, only looking closer at the ones that had a match
+static size_t findNumber(const double *numbers, size_t count, double num, size_t start)
+{
+	size_t i = start;
+	for (; i + 4 <= count; i += 4)
+		if ((numbers[i] == num) | (numbers[i + 1] == num) | (numbers[i + 2] == num) | (numbers[i + 3] == num))
+			break;
+	for (; i < count; i++)
+		if (numbers[i] == num) return i;
+	return SIZE_MAX;
+}
+
+size_t ms_listIndexOf(ms_VM *vm, ms_ObjList *list, ms_Value value, size_t start)
+{
+	if (start >= list->count) return SIZE_MAX;
+	if (list->isNumeric)
+		return MS_IS_NUM(value) ? findNumber(list->as.numbers, list->count, MS_TO_NUM(value), start) : SIZE_MAX;
+
+	bool isString = MS_IS_ANY_STRING(value);
+	for (size_t i = start; i < list->count; i++)
+	{
+		ms_Value item = list->as.values[i];
+		if (isString && MS_IS_ANY_STRING(item) ? ms_stringsEqual(vm, item, value) : ms_valuesEqual(item, value))
+			return i;
+	}
+	return SIZE_MAX;
+}
+
+////////////////////////////
+
+// numeric lists are sorted by radix: the bits of a double sort in the same
+// order as the number itself once the sign bit is flipped for positive
+// numbers and every bit is flipped for negative ones. lists this short
+// aren't worth it
+#define RADIX_MIN_COUNT 64
+#define SIGN_BIT ((uint64_t)1 << 63)
+
+static void insertionSort(double *numbers, size_t count)
+{
+	for (size_t i = 1; i < count; i++)
+	{
+		double num = numbers[i];
+		size_t j = i;
+		for (; j > 0 && num < numbers[j - 1]; j--) numbers[j] = numbers[j - 1];
+		numbers[j] = num;
+	}
+}
+
+static void radixSort(ms_VM *vm, double *numbers, size_t count)
+{
+	uint64_t *keys = MS_MEM_MALLOC_ARR(vm, uint64_t, 2 * count);
+	uint64_t *tmp = keys + count;
+
+	// counting every byte of every key in one go
+	size_t counts[8][256] = {{0}};
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t bits;
+		memcpy(&bits, numbers + i, sizeof bits);
+		bits = bits & SIGN_BIT ? ~bits : bits ^ SIGN_BIT;
+		keys[i] = bits;
+		for (int pass = 0; pass < 8; pass++) counts[pass][(bits >> (pass * 8)) & 0xff]++;
+	}
+
+	for (int pass = 0; pass < 8; pass++)
+	{
+		size_t *bucket = counts[pass];
+		int shift = pass * 8;
+		// every key has the same byte here, nothing would move
+		if (bucket[(keys[0] >> shift) & 0xff] == count) continue;
+
+		size_t offset = 0;
+		for (int b = 0; b < 256; b++)
+		{
+			size_t n = bucket[b];
+			bucket[b] = offset;
+			offset += n;
+		}
+
+		for (size_t i = 0; i < count; i++) tmp[bucket[(keys[i] >> shift) & 0xff]++] = keys[i];
+
+		uint64_t *swap = keys;
+		keys = tmp;
+		tmp = swap;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t bits = keys[i] & SIGN_BIT ? keys[i] ^ SIGN_BIT : ~keys[i];
+		memcpy(numbers + i, &bits, sizeof bits);
+	}
+
+	// one of the halves, depending on how many passes were done
+	MS_MEM_FREE_ARR(vm, uint64_t, keys < tmp ? keys : tmp, 2 * count);
+}
+
+static int rank(ms_Value value)
+{
+	if (MS_IS_NULL(value)) return 0;
+	if (MS_IS_NUM(value)) return 1;
+	if (MS_IS_STRING(value)) return 2;
+	return 3;
+}
+
+// every string has been flattened by now, so this doesn't allocate
+static bool lessThan(ms_Value a, ms_Value b)
+{
+	int ra = rank(a), rb = rank(b);
+	if (ra != rb) return ra < rb;
+	if (ra == 1) return MS_TO_NUM(a) < MS_TO_NUM(b);
+	if (ra != 2) return false;
+
+	ms_ObjString *sa = MS_TO_STRING(a), *sb = MS_TO_STRING(b);
+	size_t length = sa->length < sb->length ? sa->length : sb->length;
+	int cmp = memcmp(sa->chars, sb->chars, length);
+	return cmp < 0 || (cmp == 0 && sa->length < sb->length);
+}
+
+// a stable merge sort, merging runs of doubling width back and forth
+static void mergeSort(ms_VM *vm, ms_Value *values, size_t count)
+{
+	ms_Value *buffer = MS_MEM_MALLOC_ARR(vm, ms_Value, count);
+	ms_Value *from = values, *to = buffer;
+
+	for (size_t width = 1; width < count; width *= 2)
+	{
+		for (size_t lo = 0; lo < count; lo += 2 * width)
+		{
+			size_t mid = lo + width < count ? lo + width : count;
+			size_t hi = lo + 2 * width < count ? lo + 2 * width : count;
+			size_t i = lo, j = mid, k = lo;
+			while (i < mid && j < hi) to[k++] = lessThan(from[j], from[i]) ? from[j++] : from[i++];
+			while (i < mid) to[k++] = from[i++];
+			while (j < hi) to[k++] = from[j++];
+		}
+
+		ms_Value *swap = from;
+		from = to;
+		to = swap;
+	}
+
+	if (from != values) memcpy(values, from, count * sizeof(ms_Value));
+	MS_MEM_FREE_ARR(vm, ms_Value, buffer, count);
+}
+
+void ms_sortList(ms_VM *vm, ms_ObjList *list)
+{
+	if (list->count < 2) return;
+	ms_ownListItems(vm, list);
+
+	if (list->isNumeric)
+	{
+		if (list->count < RADIX_MIN_COUNT)
+			insertionSort(list->as.numbers, list->count);
+		else
+			radixSort(vm, list->as.numbers, list->count);
+		return;
+	}
+
+	for (size_t i = 0; i < list->count; i++)
+	{
+		if (!MS_IS_ROPE(list->as.values[i])) continue;
+		ms_Value flat = MS_FROM_OBJ(ms_flattenString(vm, list->as.values[i]));
+		list->as.values[i] = flat;
+		ms_writeBarrier(vm, &list->obj, flat);
+	}
+	mergeSort(vm, list->as.values, list->count);
+}
+
+////////////////////////////
+
+#define MAX_RANGE_LENGTH ((size_t)1 << 28)
+
+ms_ObjList *ms_newRange(ms_VM *vm, double from, double to, double step)
+{
+	if (step == 0) return NULL;
+
+	double length = floor((to - from) / step) + 1;
+	// also catches NaNs
+	if (!(length >= 1)) return ms_newList(vm, 0, true);
+	if (length > MAX_RANGE_LENGTH) return NULL;
+
+	size_t count = (size_t)length;
+	ms_ObjList *list = ms_newList(vm, count, true);
+	double *restrict numbers = list->as.numbers;
+	for (size_t i = 0; i < count; i++) numbers[i] = from + (double)i * step;
+	list->count = count;
+	return list;
+}
+
+// the list's items as doubles, copied into `*copy` when it isn't numeric.
+// NULL if there's anything else in it
+static const double *numbersOf(ms_VM *vm, ms_ObjList *list, double **copy)
+{
+	static const double none = 0;
+	*copy = NULL;
+	if (list->isNumeric) return list->as.numbers;
+	if (list->count == 0) return &none;
+
+	for (size_t i = 0; i < list->count; i++)
+		if (!MS_IS_NUM(list->as.values[i])) return NULL;
+
+	*copy = MS_MEM_MALLOC_ARR(vm, double, list->count);
+	for (size_t i = 0; i < list->count; i++) (*copy)[i] = MS_TO_NUM(list->as.values[i]);
+	return *copy;
+}
+
+#define COMBINE(op, y) \
+	for (size_t i = 0; i < count; i++) out[i] = x[i] op (y)
+
+static void combine(ms_Opcode op, double *restrict out, const double *restrict x,
+                    const double *restrict y, size_t count)
+{
+	switch (op)
+	{
+		case MS_OP_ADD:      COMBINE(+, y[i]); break;
+		case MS_OP_SUBTRACT: COMBINE(-, y[i]); break;
+		case MS_OP_MULTIPLY: COMBINE(*, y[i]); break;
+		case MS_OP_DIVIDE:   COMBINE(/, y[i]); break;
+		default: MS_UNREACHABLE("combine"); break;
+	}
+}
+
+static void combineScalar(ms_Opcode op, double *restrict out, const double *restrict x,
+                          double y, size_t count)
+{
+	switch (op)
+	{
+		case MS_OP_ADD:      COMBINE(+, y); break;
+		case MS_OP_SUBTRACT: COMBINE(-, y); break;
+		case MS_OP_MULTIPLY: COMBINE(*, y); break;
+		case MS_OP_DIVIDE:   COMBINE(/, y); break;
+		default: MS_UNREACHABLE("combineScalar"); break;
+	}
+}
+
+#undef COMBINE
+
+ms_ObjList *ms_combineLists(ms_VM *vm, ms_Opcode op, ms_ObjList *a, ms_Value b)
+{
+	if (!MS_IS_NUM(b) && (!MS_IS_LIST(b) || MS_TO_LIST(b)->count != a->count)) return NULL;
+
+	// everything's allocated before the result, which nothing else can see until it's returned
+	double *copyA = NULL, *copyB = NULL;
+	const double *x = numbersOf(vm, a, &copyA), *y = NULL;
+	if (x != NULL && MS_IS_LIST(b)) y = numbersOf(vm, MS_TO_LIST(b), &copyB);
+
+	ms_ObjList *list = NULL;
+	if (x != NULL && (y != NULL || MS_IS_NUM(b)))
+	{
+		list = ms_newList(vm, a->count, true);
+		if (y != NULL)
+			combine(op, list->as.numbers, x, y, a->count);
+		else
+			combineScalar(op, list->as.numbers, x, MS_TO_NUM(b), a->count);
+		list->count = a->count;
+	}
+
+	if (copyA != NULL) MS_MEM_FREE_ARR(vm, double, copyA, a->count);
+	if (copyB != NULL) MS_MEM_FREE_ARR(vm, double, copyB, a->count);
+	return list;
+}
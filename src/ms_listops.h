@@ -0,0 +1,39 @@
+#ifndef MS_LISTOPS_H
+#define MS_LISTOPS_H
+
+#include "ms_code.h"
+#include "ms_common.h"
+#include "ms_object.h"
+#include "ms_value.h"
+
+// operations over whole lists, what `sum`, `indexOf`, `sort`, `range` and
+// friends are going to be built on once there are intrinsics to call.
+//
+// numeric lists go through loops over plain doubles, written so that
+// compilers can vectorize them: no aliasing, several independent
+// accumulators instead of one long chain of additions. other lists take
+// the slow way, through their values. as everywhere else, the ones that
+// take a VM may collect, so the lists and values passed in have to be reachable
+
+// non-numbers count as 0, like the reference implementation does
+double ms_sumList(ms_ObjList *list);
+// false if the list has no numbers in it
+bool ms_listMinMax(ms_ObjList *list, double *min, double *max);
+// the position of the first item equal to `value` at or after `start`,
+// SIZE_MAX if there isn't any. strings are compared by their contents
+size_t ms_listIndexOf(ms_VM *vm, ms_ObjList *list, ms_Value value, size_t start);
+
+// sorts the list in place: null first, then numbers, then strings,
+// then anything else in the order it was in
+void ms_sortList(ms_VM *vm, ms_ObjList *list);
+
+// the numbers from `from` to `to`, both included, `step` apart. NULL
+// if `step` is 0 or there'd be too many; empty if `to` can't be reached
+ms_ObjList *ms_newRange(ms_VM *vm, double from, double to, double step);
+
+// `+ - * /` on every item of `a` and the same item of `b`, or `b`
+// itself if it's a number. NULL if the lengths differ, or if there's
+// anything but numbers in them
+ms_ObjList *ms_combineLists(ms_VM *vm, ms_Opcode op, ms_ObjList *a, ms_Value b);
+
+#endif
@@ -6,122 +6,246 @@
 #include "ms_value.h"
 #include "ms_map.h"
 
-// TODO: this is a constant from Crafting Interpreters, benchmark and tune this
-#define MAP_MAX_LOAD 0.75
+#if defined(__SSE2__) && !defined(MS_NO_SIMD)
+#include <emmintrin.h>
+#define MAP_SSE2
+#endif
+
+// tables are rehashed once 7/8 of their slots are either full or deleted.
+// group probing keeps lookups short up to there, see bench/bench_map.c
+#define MAP_MAX_FILL(cap) ((cap) - (cap) / 8)
+
+#define NOT_FOUND SIZE_MAX
 
 void ms_initMap(ms_VM* vm, ms_Map *map)
 {
 	MS_UNUSED(vm);
-	map->count = map->cap = 0;
+	map->count = map->cap = map->tombstones = 0;
+	map->ctrl = NULL;
 	map->entries = NULL;
 }
 
 void ms_freeMap(ms_VM* vm, ms_Map *map)
 {
+	MS_MEM_FREE_ARR(vm, uint8_t, map->ctrl, map->cap);
 	MS_MEM_FREE_ARR(vm, ms_MapEntry, map->entries, map->cap);
 	ms_initMap(vm, map);
 }
 
-static ms_MapEntry *findEntry(ms_MapEntry *entries, size_t cap, ms_Value key)
+//// group matching
+// each of these returns a bitmask with bit i set if
+// the i-th control byte of the group matches
+
+#ifdef MAP_SSE2
+
+static inline uint32_t matchByte(const uint8_t *group, uint8_t byte)
 {
-	uint32_t index;
+	__m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)byte)));
+}
 
-	if (MS_OBJ_TYPE(key) == MS_OBJ_STRING)
-		index = MS_TO_STRING(key)->hash;
-	else
-		// TODO: cache hash somehow
-		index = ms_hashMem(key.as.object, sizeof(ms_Object*));
+// empty and deleted are the only control bytes with their high bit set
+static inline uint32_t matchFree(const uint8_t *group)
+{
+	return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+}
+
+#else
+
+static inline uint32_t matchByte(const uint8_t *group, uint8_t byte)
+{
+	uint32_t mask = 0;
+	for (int i = 0; i < MS_MAP_GROUP_WIDTH; i++)
+		if (group[i] == byte) mask |= 1u << i;
+	return mask;
+}
+
+static inline uint32_t matchFree(const uint8_t *group)
+{
+	uint32_t mask = 0;
+	for (int i = 0; i < MS_MAP_GROUP_WIDTH; i++)
+		if (group[i] & 0x80) mask |= 1u << i;
+	return mask;
+}
 
-	index %= cap;
+#endif // MAP_SSE2
 
-	ms_MapEntry *tombstone = NULL;
-	for (;;)
+static inline uint32_t matchEmpty(const uint8_t *group)
+{
+	return matchByte(group, MS_MAP_CTRL_EMPTY);
+}
+
+static inline int lowestBit(uint32_t mask)
+{
+#ifdef __GNUC__
+	return __builtin_ctz(mask);
+#else
+	int i = 0;
+	while (!(mask & 1)) mask >>= 1, i++;
+	return i;
+#endif
+}
+
+//// hashing
+// the low 7 bits of the hash go in the control byte, the rest picks the first group
+
+static inline uint32_t mix64(uint64_t bits)
+{
+	bits ^= bits >> 33;
+	bits *= 0xff51afd7ed558ccdull;
+	bits ^= bits >> 33;
+	return (uint32_t)bits;
+}
+
+uint32_t ms_hashValue(ms_Value key)
+{
+	switch (MS_VAL_TYPE(key))
 	{
-		ms_MapEntry *entry = entries + index;
-
-		if (!entry->_isUsed)
-			if (MS_IS_NULL(entry->value))
-				return tombstone != NULL ? tombstone : entry;
-			else
-			{
-				if (tombstone == NULL) tombstone = entry;
-			}
-		else if (ms_valuesEqual(entry->key, key))
-			return entry;
-
-		index = (index + 1) % cap;
+		case MS_TYPE_NUM: {
+			// 0 and -0 are equal, so they must hash the same
+			double num = MS_TO_NUM(key) + 0.0;
+			uint64_t bits;
+			memcpy(&bits, &num, sizeof bits);
+			return mix64(bits);
+		}
+
+		case MS_TYPE_NULL: return 0;
+
+		case MS_TYPE_OBJ:
+			if (MS_OBJ_TYPE(key) == MS_OBJ_STRING) return MS_TO_STRING(key)->hash;
+			return mix64((uintptr_t)MS_TO_OBJ(key));
+
+		default: MS_UNREACHABLE("ms_hashValue"); return 0;
 	}
 }
 
-static void adjustCapacity(ms_VM *vm, ms_Map *map, size_t cap)
+#define H1(hash) ((hash) >> 7)
+#define H2(hash) ((uint8_t)((hash) & 0x7f))
+
+// walks groups in triangular steps (1, 2, 3, ...), which
+// visits every group once when their number is a power of two
+#define FOR_EACH_GROUP(map, hash, group)                                           \
+	for (size_t mask_ = (map)->cap / MS_MAP_GROUP_WIDTH - 1,                       \
+	            group = H1(hash) & mask_, step_ = 1;                               \
+	     ; group = (group + step_++) & mask_)
+
+static size_t findSlot(ms_Map *map, ms_Value key, uint32_t hash)
 {
-	ms_MapEntry *entries = MS_MEM_MALLOC_ARR(vm, ms_MapEntry, cap);
+	if (map->count == 0) return NOT_FOUND;
 
-	for (size_t i = 0; i < cap; i++)
+	FOR_EACH_GROUP(map, hash, group)
 	{
-		entries[i].key = MS_NULL_VAL;
-		entries[i].value = MS_NULL_VAL;
-		entries[i]._isUsed = false;
+		const uint8_t *ctrl = map->ctrl + group * MS_MAP_GROUP_WIDTH;
+		for (uint32_t m = matchByte(ctrl, H2(hash)); m != 0; m &= m - 1)
+		{
+			size_t slot = group * MS_MAP_GROUP_WIDTH + lowestBit(m);
+			if (ms_valuesEqual(map->entries[slot].key, key)) return slot;
+		}
+
+		// the key would have been put in this group if it was in the table
+		if (matchEmpty(ctrl)) return NOT_FOUND;
 	}
+}
 
-	map->count = 0;
-	for (size_t i = 0; i < map->cap; i++)
+// first empty or deleted slot the key's probe sequence runs into
+static size_t findFreeSlot(ms_Map *map, uint32_t hash)
+{
+	FOR_EACH_GROUP(map, hash, group)
 	{
-		ms_MapEntry* entry = map->entries + i;
-		if (!entry->_isUsed) continue;
-
-		ms_MapEntry *dest = findEntry(entries, cap, entry->key);
-		dest->key = entry->key;
-		dest->value = entry->value;
-		dest->_isUsed = true;
-		map->count++;
+		uint32_t m = matchFree(map->ctrl + group * MS_MAP_GROUP_WIDTH);
+		if (m != 0) return group * MS_MAP_GROUP_WIDTH + lowestBit(m);
 	}
+}
 
-	MS_MEM_FREE_ARR(vm, ms_MapEntry, map->entries, map->cap);
+static void resize(ms_VM *vm, ms_Map *map, size_t cap)
+{
+	// allocating may collect, which can delete from this very map
+	// (the strings table), so it has to stay whole until both are ready
+	uint8_t *ctrl = MS_MEM_MALLOC_ARR(vm, uint8_t, cap);
+	ms_MapEntry *entries = MS_MEM_MALLOC_ARR(vm, ms_MapEntry, cap);
+
+	uint8_t *oldCtrl = map->ctrl;
+	ms_MapEntry *oldEntries = map->entries;
+	size_t oldCap = map->cap;
+
+	map->ctrl = ctrl;
 	map->entries = entries;
 	map->cap = cap;
+	map->tombstones = 0;
+	memset(map->ctrl, MS_MAP_CTRL_EMPTY, cap);
+
+	for (size_t i = 0; i < oldCap; i++)
+	{
+		if (oldCtrl[i] >= MS_MAP_CTRL_EMPTY) continue;
+
+		uint32_t hash = ms_hashValue(oldEntries[i].key);
+		size_t slot = findFreeSlot(map, hash);
+		map->ctrl[slot] = H2(hash);
+		map->entries[slot] = oldEntries[i];
+	}
+
+	MS_MEM_FREE_ARR(vm, uint8_t, oldCtrl, oldCap);
+	MS_MEM_FREE_ARR(vm, ms_MapEntry, oldEntries, oldCap);
 }
 
 bool ms_setMapKey(ms_VM* vm, ms_Map *map, ms_Value key, ms_Value value)
 {
-	if (map->count + 1 > map->cap * MAP_MAX_LOAD)
+	uint32_t hash = ms_hashValue(key);
+	size_t slot = findSlot(map, key, hash);
+	if (slot != NOT_FOUND)
 	{
-		size_t cap = MS_ARR_GROW_CAP(map->cap);
-		adjustCapacity(vm, map, cap);
+		map->entries[slot].value = value;
+		return false;
 	}
 
-	ms_MapEntry *entry = findEntry(map->entries, map->cap, key);
-	bool newKey = !entry->_isUsed;
-	if (newKey && MS_IS_NULL(entry->value)) map->count++;
+	if (map->count + map->tombstones + 1 > MAP_MAX_FILL(map->cap))
+	{
+		// when it's mostly tombstones, rehashing at the same size makes enough room
+		size_t cap = map->cap;
+		if (cap == 0)
+			cap = MS_MAP_GROUP_WIDTH;
+		else if (map->count + 1 > MAP_MAX_FILL(cap) / 2)
+			cap *= 2;
+		resize(vm, map, cap);
+	}
 
-	entry->key = key;
-	entry->value = value;
-	entry->_isUsed = true;
-	return newKey;
+	slot = findFreeSlot(map, hash);
+	if (map->ctrl[slot] == MS_MAP_CTRL_DELETED) map->tombstones--;
+	map->ctrl[slot] = H2(hash);
+	map->entries[slot].key = key;
+	map->entries[slot].value = value;
+	map->count++;
+	return true;
 }
 
 bool ms_getMapKey(ms_VM *vm, ms_Map *map, ms_Value key, ms_Value *value)
 {
 	MS_UNUSED(vm);
-	if (map->count == 0) return false;
-
-	ms_MapEntry *entry = findEntry(map->entries, map->cap, key);
-	if (!entry->_isUsed) return false;
+	size_t slot = findSlot(map, key, ms_hashValue(key));
+	if (slot == NOT_FOUND) return false;
 
-	*value = entry->value;
+	*value = map->entries[slot].value;
 	return true;
 }
 
 bool ms_deleteFromMap(ms_VM *vm, ms_Map *map, ms_Value key)
 {
 	MS_UNUSED(vm);
-	if (map->count == 0) return false;
+	size_t slot = findSlot(map, key, ms_hashValue(key));
+	if (slot == NOT_FOUND) return false;
 
-	ms_MapEntry *entry = findEntry(map->entries, map->cap, key);
-	if (!entry->_isUsed) return false;
+	// if the group still has an empty slot no probe ever went past it,
+	// so the slot can go back to empty instead of becoming a tombstone
+	const uint8_t *group = map->ctrl + slot / MS_MAP_GROUP_WIDTH * MS_MAP_GROUP_WIDTH;
+	if (matchEmpty(group))
+		map->ctrl[slot] = MS_MAP_CTRL_EMPTY;
+	else
+	{
+		map->ctrl[slot] = MS_MAP_CTRL_DELETED;
+		map->tombstones++;
+	}
 
-	entry->_isUsed = false;
-	entry->value = MS_FROM_NUM(1);
+	map->count--;
 	return true;
 }
 
@@ -130,24 +254,21 @@ ms_ObjString *ms_findStringInMap(ms_VM *vm, ms_Map *map, const char* str, size_t
 	MS_UNUSED(vm);
 	if (map->count == 0) return NULL;
 
-	uint32_t index = hash % map->cap;
-	for (;;)
+	FOR_EACH_GROUP(map, hash, group)
 	{
-		ms_MapEntry *entry = map->entries + index;
-
-		if (!entry->_isUsed)
+		const uint8_t *ctrl = map->ctrl + group * MS_MAP_GROUP_WIDTH;
+		for (uint32_t m = matchByte(ctrl, H2(hash)); m != 0; m &= m - 1)
 		{
-			if (MS_IS_NULL(entry->value)) return NULL;
-		}
-		else if (MS_IS_STRING(entry->key))
-		{
-			ms_ObjString *strObj = MS_TO_STRING(entry->key);
+			ms_Value key = map->entries[group * MS_MAP_GROUP_WIDTH + lowestBit(m)].key;
+			if (!MS_IS_STRING(key)) continue;
+
+			ms_ObjString *strObj = MS_TO_STRING(key);
 			if (strObj->length == length
 				&& strObj->hash == hash
 				&& !memcmp(strObj->chars, str, length))
 				return strObj;
 		}
 
-		index = (index + 1) % map->cap;
+		if (matchEmpty(ctrl)) return NULL;
 	}
 }
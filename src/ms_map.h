@@ -4,20 +4,43 @@
 #include "ms_common.h"
 #include "ms_value.h"
 
+// open addressing with the metadata split from the entries (a "swiss table").
+// every slot has a control byte: either empty, deleted, or the low 7 bits
+// of the key's hash. lookups scan the control bytes of a whole group of
+// slots at once and only look at the entries whose byte matches.
+// the capacity is always 0 or a power of two, multiple of the group width
+
+#define MS_MAP_GROUP_WIDTH 16
+
+#define MS_MAP_CTRL_EMPTY   ((uint8_t)0x80)
+#define MS_MAP_CTRL_DELETED ((uint8_t)0xfe)
+
 typedef struct {
 	ms_Value key, value;
-	bool _isUsed;
 } ms_MapEntry;
 
 typedef struct {
-	size_t cap, count;
+	// count only includes live entries, tombstones are counted separately
+	size_t cap, count, tombstones;
+	uint8_t *ctrl;
 	ms_MapEntry *entries;
 } ms_Map;
 
+// whether slot `i` holds an entry, for walking over every slot
+static inline bool ms_isMapSlotUsed(ms_Map *map, size_t i)
+{
+	return map->ctrl[i] < MS_MAP_CTRL_EMPTY;
+}
+
+// strings have to be interned, they're hashed by content and that's only
+// computed when interning them. other objects are hashed by their address
+uint32_t ms_hashValue(ms_Value key);
+
 void ms_initMap(ms_VM* vm, ms_Map *map);
 void ms_freeMap(ms_VM* vm, ms_Map *map);
 bool ms_setMapKey(ms_VM* vm, ms_Map *map, ms_Value key, ms_Value value);
 bool ms_getMapKey(ms_VM *vm, ms_Map *map, ms_Value key, ms_Value *value);
+bool ms_deleteFromMap(ms_VM *vm, ms_Map *map, ms_Value key);
 ms_ObjString *ms_findStringInMap(ms_VM *vm, ms_Map *map, const char* str, size_t length, uint32_t hash);
 
 #endif
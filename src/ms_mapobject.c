@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ms_common.h"
+#include "ms_hash.h"
+#include "ms_map.h"
+#include "ms_mapobject.h"
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_string.h"
+#include "ms_value.h"
+#include "ms_vm.h"
+
+#define NOT_FOUND SIZE_MAX
+
+static size_t findItem(ms_ObjMap *map, ms_Value key, uint32_t hash)
+{
+	if (map->index == NULL)
+	{
+		for (size_t i = 0; i < map->count; i++)
+			if (map->items[i].hash == hash && ms_valuesEqual(map->items[i].key, key))
+				return i;
+		return NOT_FOUND;
+	}
+
+	size_t mask = map->indexCap - 1;
+	for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+	{
+		uint32_t pos = map->index[slot];
+		if (pos == 0) return NOT_FOUND;
+
+		ms_MapItem *item = map->items + pos - 1;
+		if (item->hash == hash && ms_valuesEqual(item->key, key)) return pos - 1;
+	}
+}
+
+static void indexItem(ms_ObjMap *map, size_t pos)
+{
+	size_t mask = map->indexCap - 1;
+	size_t slot = map->items[pos].hash & mask;
+	while (map->index[slot] != 0) slot = (slot + 1) & mask;
+	map->index[slot] = (uint32_t)(pos + 1);
+}
+
+static void buildIndex(ms_ObjMap *map)
+{
+	if (map->index == NULL) return;
+
+	memset(map->index, 0, map->indexCap * sizeof(uint32_t));
+	for (size_t i = 0; i < map->count; i++) indexItem(map, i);
+}
+
+void ms_reserveMap(ms_VM *vm, ms_ObjMap *map, size_t cap)
+{
+	if (cap <= map->cap) return;
+
+	size_t newCap = 8;
+	while (newCap < cap) newCap *= 2;
+	// the index is kept at most half full
+	size_t indexCap = newCap > MS_MAP_LINEAR_MAX ? newCap * 2 : 0;
+
+	// allocating may collect, the map has to stay whole until both are ready
+	ms_MapItem *items = MS_MEM_MALLOC_ARR(vm, ms_MapItem, newCap);
+	uint32_t *index = indexCap > 0 ? MS_MEM_MALLOC_ARR(vm, uint32_t, indexCap) : NULL;
+
+	if (map->count > 0) memcpy(items, map->items, map->count * sizeof(ms_MapItem));
+	MS_MEM_FREE_ARR(vm, ms_MapItem, map->items, map->cap);
+	MS_MEM_FREE_ARR(vm, uint32_t, map->index, map->indexCap);
+
+	map->items = items;
+	map->cap = newCap;
+	map->index = index;
+	map->indexCap = indexCap;
+	buildIndex(map);
+}
+
+ms_ObjMap *ms_newMapFrom(ms_VM *vm, ms_Value *pairs, size_t count)
+{
+	ms_ObjMap *map = ms_newMap(vm);
+	// collecting doesn't move the stack, `pairs` is still good after this
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(map));
+
+	ms_reserveMap(vm, map, count);
+	for (size_t i = 0; i < count; i++)
+		ms_setMapItem(vm, map, pairs[2 * i], pairs[2 * i + 1]);
+
+	ms_popValueFromVM(vm);
+	return map;
+}
+
+// an interned string equal to the key, for looking it up. if there
+// isn't one no map can have it, since they keep theirs alive
+static bool findInternedKey(ms_VM *vm, ms_Value *key)
+{
+	if (!MS_IS_ANY_STRING(*key)) return true;
+
+	ms_ObjString *str = ms_flattenString(vm, *key);
+	if (!str->isInterned)
+	{
+		uint32_t hash = ms_hashMem(str->chars, str->length, vm->hashSeed);
+		str = ms_findStringInMap(vm, &vm->strings, str->chars, str->length, hash);
+		if (str == NULL) return false;
+	}
+
+	*key = MS_FROM_OBJ(str);
+	return true;
+}
+
+bool ms_getMapItem(ms_VM *vm, ms_ObjMap *map, ms_Value key, ms_Value *value)
+{
+	if (map->count == 0 || !findInternedKey(vm, &key)) return false;
+
+	size_t pos = findItem(map, key, ms_hashValue(key));
+	if (pos == NOT_FOUND) return false;
+
+	*value = map->items[pos].value;
+	return true;
+}
+
+void ms_setMapItem(ms_VM *vm, ms_ObjMap *map, ms_Value key, ms_Value value)
+{
+	if (MS_IS_ANY_STRING(key))
+		key = MS_FROM_OBJ(ms_internString(vm, ms_flattenString(vm, key)));
+
+	uint32_t hash = ms_hashValue(key);
+	size_t pos = findItem(map, key, hash);
+	if (pos == NOT_FOUND)
+	{
+		if (map->count == map->cap)
+		{
+			// the interned key might not be the string that was passed
+			// in, in which case only the (weak) strings table has it
+			ms_pushValueIntoVM(vm, key);
+			ms_reserveMap(vm, map, map->count + 1);
+			ms_popValueFromVM(vm);
+		}
+
+		pos = map->count++;
+		map->items[pos].key = key;
+		map->items[pos].hash = hash;
+		if (map->index != NULL) indexItem(map, pos);
+		ms_writeBarrier(vm, &map->obj, key);
+	}
+
+	map->items[pos].value = value;
+	ms_writeBarrier(vm, &map->obj, value);
+}
+
+ms_ObjMap *ms_mapItemPair(ms_VM *vm, ms_ObjMap *map, size_t pos)
+{
+	ms_ObjMap *pair = ms_newMap(vm);
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(pair));
+	ms_reserveMap(vm, pair, 2);
+
+	// with the room already there and the names interned, setting
+	// the items doesn't allocate, so the names can't go away meanwhile
+	ms_Value name = MS_FROM_OBJ(ms_copyString(vm, "key", 3));
+	ms_setMapItem(vm, pair, name, map->items[pos].key);
+	name = MS_FROM_OBJ(ms_copyString(vm, "value", 5));
+	ms_setMapItem(vm, pair, name, map->items[pos].value);
+
+	ms_popValueFromVM(vm);
+	return pair;
+}
+
+void ms_rehashMap(ms_ObjMap *map)
+{
+	for (size_t i = 0; i < map->count; i++)
+		map->items[i].hash = ms_hashValue(map->items[i].key);
+	buildIndex(map);
+}
+
+void ms_printMap(ms_ObjMap *map)
+{
+	printf("{");
+	for (size_t i = 0; i < map->count; i++)
+	{
+		if (i > 0) printf(", ");
+		ms_printNestedValue(map->items[i].key);
+		printf(": ");
+		ms_printNestedValue(map->items[i].value);
+	}
+	printf("}");
+}
@@ -0,0 +1,38 @@
+#ifndef MS_MAPOBJECT_H
+#define MS_MAPOBJECT_H
+
+#include "ms_common.h"
+#include "ms_object.h"
+#include "ms_value.h"
+
+// what map literals, indexing maps and iterating over them build on.
+//
+// items are appended to a packed array as they're added, so walking a map
+// goes over them in order without skipping empty slots, and the index table
+// only holds 32-bit positions into that array. maps of up to
+// MS_MAP_LINEAR_MAX items don't have an index, their items are just
+// compared one by one.
+//
+// string keys are interned when they're added, so that keys can always be
+// compared by value. as in ms_list.h, anything that takes a VM may collect:
+// the map and the values passed in have to be reachable from the VM's stack
+
+#define MS_MAP_LINEAR_MAX 8
+
+// makes room for `cap` items in total
+void ms_reserveMap(ms_VM *vm, ms_ObjMap *map, size_t cap);
+// a map with the `count` key and value pairs that start at `pairs`, which may be on the stack
+ms_ObjMap *ms_newMapFrom(ms_VM *vm, ms_Value *pairs, size_t count);
+
+bool ms_getMapItem(ms_VM *vm, ms_ObjMap *map, ms_Value key, ms_Value *value);
+void ms_setMapItem(ms_VM *vm, ms_ObjMap *map, ms_Value key, ms_Value value);
+// what iterating over a map gives: a map with the item at `pos` as its "key" and "value"
+ms_ObjMap *ms_mapItemPair(ms_VM *vm, ms_ObjMap *map, size_t pos);
+
+// recomputes the hashes that depend on where the keys are,
+// for after the collector moved some of them
+void ms_rehashMap(ms_ObjMap *map);
+
+void ms_printMap(ms_ObjMap *map);
+
+#endif
@@ -1,10 +1,15 @@
 #include "ms_code.h"
-#ifdef MS_DEBUG_MEM_ALLOC
+#if defined(MS_DEBUG_MEM_ALLOC) || defined(MS_DEBUG_LOG_GC)
 #include <stdio.h>
 #endif
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "ms_common.h"
+#include "ms_compiler.h"
+#include "ms_map.h"
+#include "ms_mapobject.h"
 #include "ms_object.h"
 #include "ms_vm.h"
 #include "ms_mem.h"
@@ -14,45 +19,528 @@ void *ms_vmRealloc(ms_VM *vm, void *ptr, size_t oldSize, size_t newSize)
 	bool isFreeing = newSize == 0;
 	MS_UNUSED(isFreeing);
 
-	int diff = newSize - oldSize;
-	vm->bytesUsed += diff;
+	// bytesUsed counts what was asked for, not what the allocator rounded it up to
+	vm->bytesUsed += newSize;
+	vm->bytesUsed -= oldSize;
+
+	if (newSize > oldSize && !vm->gcPaused)
+	{
+#ifdef MS_DEBUG_STRESS_GC
+		ms_collectGarbage(vm);
+#else
+		if (vm->bytesUsed > vm->nextGC) ms_collectGarbage(vm);
+#endif
+	}
+
 #ifdef MS_DEBUG_MEM_ALLOC
-	if (diff != 0)
+	if (newSize != oldSize)
 		fprintf(stderr,
-	  "mem: %s %i bytes\n",
-	  diff < 0 ? "freed" : "allocated",
-	  diff < 0 ? -diff : diff
+	  "mem: %s %zu bytes\n",
+	  newSize < oldSize ? "freed" : "allocated",
+	  newSize < oldSize ? oldSize - newSize : newSize - oldSize
 	);
 #endif
-	void *res = vm->reallocFn(ptr, oldSize, newSize);
+	void *res = vm->slabs.enabled
+		? ms_slabRealloc(vm, ptr, oldSize, newSize)
+		: vm->reallocFn(ptr, oldSize, newSize);
 
 	// TODO: throw a proper error? maybe
 	MS_ASSERT_REASON(res != NULL || isFreeing, "pointer is NULL but VM is not requesting a free");
 	return res;
 }
 
-static void freeObject(ms_VM* vm, ms_Object *object)
+#define NURSERY_ALIGN(size) (((size) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+
+static size_t objectSize(ms_Object *object)
+{
+	switch (object->type)
+	{
+		case MS_OBJ_FUNCTION: return sizeof(ms_ObjFunction);
+		case MS_OBJ_STRING:   return MS_STRING_SIZE(((ms_ObjString*)object)->length);
+		case MS_OBJ_ROPE:     return sizeof(ms_ObjRope);
+		case MS_OBJ_LIST:     return sizeof(ms_ObjList);
+		case MS_OBJ_MAP:      return sizeof(ms_ObjMap);
+		default: MS_UNREACHABLE("objectSize"); return 0;
+	}
+}
+
+static size_t youngObjectSize(ms_Object *object)
+{
+	return NURSERY_ALIGN(objectSize(object));
+}
+
+// frees everything an object owns, but not the object itself
+static void releaseObject(ms_VM *vm, ms_Object *object)
 {
 	switch (object->type)
 	{
-		case MS_OBJ_FUNCTION: {
-			ms_ObjFunction *function = (ms_ObjFunction*)object;
-			ms_freeCode(vm, &function->code);
-			MS_MEM_FREE(vm, object, sizeof(ms_ObjFunction));
+		case MS_OBJ_FUNCTION:
+			ms_freeCode(vm, &((ms_ObjFunction*)object)->code);
+			break;
+
+		case MS_OBJ_STRING:
+			// the characters go along with the object
+		case MS_OBJ_ROPE:
+			break;
+
+		case MS_OBJ_LIST: {
+			// views don't own anything
+			ms_ObjList *list = (ms_ObjList*)object;
+			if (list->base == NULL)
+				MS_MEM_FREE(vm, list->as.values,
+					list->cap * (list->isNumeric ? sizeof(double) : sizeof(ms_Value)));
 		} break;
 
-		case MS_OBJ_STRING: {
-			ms_ObjString *str = (ms_ObjString*)object;
-			MS_MEM_FREE_ARR(vm, char, str->chars, str->length + 1);
-			MS_MEM_FREE(vm, str, sizeof(ms_ObjString));
+		case MS_OBJ_MAP: {
+			ms_ObjMap *map = (ms_ObjMap*)object;
+			MS_MEM_FREE_ARR(vm, ms_MapItem, map->items, map->cap);
+			MS_MEM_FREE_ARR(vm, uint32_t, map->index, map->indexCap);
 		} break;
-		
+
 		default:
-			MS_UNREACHABLE("freeObject");
+			MS_UNREACHABLE("releaseObject");
+			break;
+	}
+}
+
+static void freeObject(ms_VM* vm, ms_Object *object)
+{
+	size_t size = objectSize(object);
+	releaseObject(vm, object);
+	MS_MEM_FREE(vm, object, size);
+}
+
+// the gc's own worklists go around ms_vmRealloc, growing them must not start another collection
+static void pushObject(ms_VM *vm, ms_Object ***stack, size_t *count, size_t *cap, ms_Object *object)
+{
+	if (*count + 1 > *cap)
+	{
+		size_t oldCap = *cap;
+		*cap = MS_ARR_GROW_CAP(oldCap);
+		*stack = vm->reallocFn(*stack, oldCap * sizeof(ms_Object*), *cap * sizeof(ms_Object*));
+		MS_ASSERT_REASON(*stack != NULL, "couldn't grow a gc worklist");
+	}
+
+	(*stack)[(*count)++] = object;
+}
+
+//// young generation
+// objects are bump allocated into a fixed size nursery. once it fills up,
+// allocation falls back to the old generation until the interpreter
+// reaches a safepoint and runs a minor collection, which copies the
+// objects that are still reachable out of the nursery and resets it.
+// survivors are promoted straight away, they don't age in the nursery
+
+static inline bool isYoung(ms_VM *vm, ms_Object *object)
+{
+	uint8_t *ptr = (uint8_t*)object;
+	return ptr >= vm->nursery && ptr < vm->nurseryTop;
+}
+
+void *ms_allocateYoung(ms_VM *vm, size_t size)
+{
+#ifdef MS_NO_NURSERY
+	MS_UNUSED(vm);
+	MS_UNUSED(size);
+	return NULL;
+#else
+	// allocated lazily, so VMs that never run anything don't pay for it
+	if (vm->nursery == NULL)
+	{
+		vm->nursery = vm->nurseryTop = MS_MEM_MALLOC(vm, MS_NURSERY_SIZE);
+		vm->nurseryEnd = vm->nursery + MS_NURSERY_SIZE;
+	}
+
+	size = NURSERY_ALIGN(size);
+	if ((size_t)(vm->nurseryEnd - vm->nurseryTop) < size)
+	{
+		vm->nurseryFull = true;
+		return NULL;
+	}
+
+	void *ptr = vm->nurseryTop;
+	vm->nurseryTop += size;
+	return ptr;
+#endif
+}
+
+void ms_writeBarrier(ms_VM *vm, ms_Object *owner, ms_Value value)
+{
+	if (owner->isRemembered || !MS_IS_OBJ(value)) return;
+	if (isYoung(vm, owner) || !isYoung(vm, MS_TO_OBJ(value))) return;
+
+	owner->isRemembered = true;
+	pushObject(vm, &vm->remembered, &vm->rememberedCount, &vm->rememberedCap, owner);
+}
+
+static ms_Object *promote(ms_VM *vm, ms_Object *object)
+{
+	if (object->next != NULL) return object->next;
+
+	size_t size = objectSize(object);
+	ms_Object *copy = MS_MEM_MALLOC(vm, size);
+	memcpy(copy, object, size);
+
+	copy->next = vm->objects;
+	vm->objects = copy;
+	object->next = copy;
+	vm->gcStats.bytesPromoted += size;
+
+	// whatever the copy points to has to be promoted as well
+	if (copy->type != MS_OBJ_STRING)
+		pushObject(vm, &vm->grayStack, &vm->grayCount, &vm->grayCap, copy);
+	return copy;
+}
+
+static inline void forwardValue(ms_VM *vm, ms_Value *value)
+{
+	if (MS_IS_OBJ(*value) && isYoung(vm, MS_TO_OBJ(*value)))
+		*value = MS_FROM_OBJ(promote(vm, MS_TO_OBJ(*value)));
+}
+
+static void forwardList(ms_VM *vm, ms_List *list)
+{
+	for (size_t i = 0; i < list->count; i++)
+		forwardValue(vm, list->data + i);
+}
+
+// keys are updated in place, which is fine as long as their hash
+// doesn't depend on their address. these maps are only ever keyed
+// by strings, and those are hashed by content
+static void forwardMap(ms_VM *vm, ms_Map *map)
+{
+	for (size_t i = 0; i < map->cap; i++)
+	{
+		ms_MapEntry *entry = map->entries + i;
+		if (!ms_isMapSlotUsed(map, i)) continue;
+		forwardValue(vm, &entry->key);
+		forwardValue(vm, &entry->value);
+	}
+}
+
+static inline ms_Object *forwardObject(ms_VM *vm, ms_Object *object)
+{
+	if (object != NULL && isYoung(vm, object)) return promote(vm, object);
+	return object;
+}
+
+static void forwardReferences(ms_VM *vm, ms_Object *object)
+{
+	switch (object->type)
+	{
+		case MS_OBJ_FUNCTION:
+			forwardList(vm, &((ms_ObjFunction*)object)->code.constants);
+			break;
+
+		case MS_OBJ_ROPE: {
+			ms_ObjRope *rope = (ms_ObjRope*)object;
+			rope->left = forwardObject(vm, rope->left);
+			rope->right = forwardObject(vm, rope->right);
+			rope->flat = (ms_ObjString*)forwardObject(vm, (ms_Object*)rope->flat);
+		} break;
+
+		// a view's items live in its base, which is moved without
+		// them, so the view can keep pointing straight at them.
+		// numeric lists don't point to anything else
+		case MS_OBJ_LIST: {
+			ms_ObjList *list = (ms_ObjList*)object;
+			if (list->base != NULL)
+				list->base = (ms_ObjList*)forwardObject(vm, (ms_Object*)list->base);
+			else if (!list->isNumeric)
+				for (size_t i = 0; i < list->count; i++)
+					forwardValue(vm, list->as.values + i);
+		} break;
+
+		// any other object is hashed by its address, so
+		// moving one used as a key means rehashing
+		case MS_OBJ_MAP: {
+			ms_ObjMap *map = (ms_ObjMap*)object;
+			bool moved = false;
+			for (size_t i = 0; i < map->count; i++)
+			{
+				ms_MapItem *item = map->items + i;
+				ms_Value key = item->key;
+				forwardValue(vm, &item->key);
+				forwardValue(vm, &item->value);
+				if (!MS_IS_STRING(key) && MS_IS_OBJ(key) && MS_TO_OBJ(key) != MS_TO_OBJ(item->key))
+					moved = true;
+			}
+			if (moved) ms_rehashMap(map);
+		} break;
+
+		default: break;
+	}
+}
+
+// every object left in the nursery is either dead or has been promoted.
+// walking it updates the strings table and frees what the dead ones own
+static void sweepNursery(ms_VM *vm)
+{
+	for (uint8_t *ptr = vm->nursery; ptr < vm->nurseryTop;)
+	{
+		ms_Object *object = (ms_Object*)ptr;
+		ptr += youngObjectSize(object);
+
+		if (object->type == MS_OBJ_STRING && ((ms_ObjString*)object)->isInterned
+		    && ms_deleteFromMap(vm, &vm->strings, MS_FROM_OBJ(object))
+		    && object->next != NULL)
+			ms_setMapKey(vm, &vm->strings, MS_FROM_OBJ(object->next), MS_FROM_NUM(1));
+
+		if (object->next == NULL) releaseObject(vm, object);
+	}
+
+	vm->nurseryTop = vm->nursery;
+	vm->nurseryFull = false;
+}
+
+void ms_collectYoung(ms_VM *vm)
+{
+	if (vm->nursery == NULL) return;
+	MS_ASSERT_REASON(vm->compiler == NULL, "young objects can't be moved while compiling");
+
+	ms_GCStats *stats = &vm->gcStats;
+	clock_t start = clock();
+	size_t promotedBefore = stats->bytesPromoted;
+	vm->gcPaused = true;
+
+	for (ms_Value *slot = vm->stack; slot < vm->stackTop; slot++)
+		forwardValue(vm, slot);
+
+	forwardMap(vm, &vm->globalNames);
+	forwardMap(vm, &vm->globals);
+	forwardList(vm, &vm->globalValues);
+
+	// every survivor gets promoted, so nothing old points into the nursery afterwards
+	for (size_t i = 0; i < vm->rememberedCount; i++)
+	{
+		forwardReferences(vm, vm->remembered[i]);
+		vm->remembered[i]->isRemembered = false;
+	}
+	vm->rememberedCount = 0;
+
+	while (vm->grayCount > 0)
+		forwardReferences(vm, vm->grayStack[--vm->grayCount]);
+
+	sweepNursery(vm);
+	vm->gcPaused = false;
+
+	double pause = (double)(clock() - start) / CLOCKS_PER_SEC;
+	stats->minorCycles++;
+	stats->lastMinorPause = pause;
+	stats->totalMinorPause += pause;
+	if (pause > stats->maxMinorPause) stats->maxMinorPause = pause;
+
+#ifdef MS_DEBUG_LOG_GC
+	fprintf(stderr, "gc: minor cycle %zu, promoted %zu bytes\n",
+		stats->minorCycles, stats->bytesPromoted - promotedBefore);
+#else
+	MS_UNUSED(promotedBefore);
+#endif
+
+	// promotions grow the old generation, which may now need collecting too
+	if (vm->bytesUsed > vm->nextGC) ms_collectGarbage(vm);
+}
+
+//// old generation
+// a non-moving mark and sweep over every object, young ones included,
+// so it can safely run from any allocation
+
+void ms_markObject(ms_VM *vm, ms_Object *object)
+{
+	if (object == NULL || object->isMarked) return;
+	object->isMarked = true;
+
+	// strings don't reference anything, no need to gray them
+	if (object->type == MS_OBJ_STRING) return;
+
+	pushObject(vm, &vm->grayStack, &vm->grayCount, &vm->grayCap, object);
+}
+
+void ms_markValue(ms_VM *vm, ms_Value value)
+{
+	if (MS_IS_OBJ(value)) ms_markObject(vm, MS_TO_OBJ(value));
+}
+
+static void markList(ms_VM *vm, ms_List *list)
+{
+	for (size_t i = 0; i < list->count; i++)
+		ms_markValue(vm, list->data[i]);
+}
+
+static void markMap(ms_VM *vm, ms_Map *map)
+{
+	for (size_t i = 0; i < map->cap; i++)
+	{
+		ms_MapEntry *entry = map->entries + i;
+		if (!ms_isMapSlotUsed(map, i)) continue;
+		ms_markValue(vm, entry->key);
+		ms_markValue(vm, entry->value);
+	}
+}
+
+static void markRoots(ms_VM *vm)
+{
+	for (ms_Value *slot = vm->stack; slot < vm->stackTop; slot++)
+		ms_markValue(vm, *slot);
+
+	for (int i = 0; i < vm->frameCount; i++)
+		ms_markObject(vm, (ms_Object*)vm->frames[i].function);
+
+	markMap(vm, &vm->globalNames);
+	markMap(vm, &vm->globals);
+	markList(vm, &vm->globalValues);
+
+	ms_markCompilerRoots(vm);
+}
+
+static void blackenObject(ms_VM *vm, ms_Object *object)
+{
+	switch (object->type)
+	{
+		case MS_OBJ_FUNCTION:
+			markList(vm, &((ms_ObjFunction*)object)->code.constants);
 			break;
+
+		case MS_OBJ_ROPE: {
+			ms_ObjRope *rope = (ms_ObjRope*)object;
+			ms_markObject(vm, rope->left);
+			ms_markObject(vm, rope->right);
+			ms_markObject(vm, (ms_Object*)rope->flat);
+		} break;
+
+		case MS_OBJ_LIST: {
+			ms_ObjList *list = (ms_ObjList*)object;
+			if (list->base != NULL)
+				ms_markObject(vm, (ms_Object*)list->base);
+			else if (!list->isNumeric)
+				for (size_t i = 0; i < list->count; i++)
+					ms_markValue(vm, list->as.values[i]);
+		} break;
+
+		case MS_OBJ_MAP: {
+			ms_ObjMap *map = (ms_ObjMap*)object;
+			for (size_t i = 0; i < map->count; i++)
+			{
+				ms_markValue(vm, map->items[i].key);
+				ms_markValue(vm, map->items[i].value);
+			}
+		} break;
+
+		default: break;
+	}
+}
+
+static void traceReferences(ms_VM *vm)
+{
+	while (vm->grayCount > 0)
+		blackenObject(vm, vm->grayStack[--vm->grayCount]);
+}
+
+// the strings table only holds weak references, strings that
+// nothing else points to are dropped from it before being freed
+static void removeWhiteStrings(ms_VM *vm)
+{
+	ms_Map *strings = &vm->strings;
+	for (size_t i = 0; i < strings->cap; i++)
+	{
+		ms_MapEntry *entry = strings->entries + i;
+		if (ms_isMapSlotUsed(strings, i) && !MS_TO_OBJ(entry->key)->isMarked)
+			ms_deleteFromMap(vm, strings, entry->key);
+	}
+}
+
+// remembered objects about to be freed must not be visited by the next minor collection
+static void pruneRememberedSet(ms_VM *vm)
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < vm->rememberedCount; i++)
+		if (vm->remembered[i]->isMarked)
+			vm->remembered[kept++] = vm->remembered[i];
+	vm->rememberedCount = kept;
+}
+
+static void sweep(ms_VM *vm)
+{
+	ms_Object *previous = NULL;
+	ms_Object *object = vm->objects;
+	while (object != NULL)
+	{
+		if (object->isMarked)
+		{
+			object->isMarked = false;
+			previous = object;
+			object = object->next;
+			continue;
+		}
+
+		ms_Object *unreached = object;
+		object = object->next;
+		if (previous != NULL) previous->next = object;
+		else vm->objects = object;
+
+		freeObject(vm, unreached);
+	}
+
+	// dead young objects are left for the next minor collection
+	for (uint8_t *ptr = vm->nursery; ptr < vm->nurseryTop;)
+	{
+		ms_Object *object = (ms_Object*)ptr;
+		ptr += youngObjectSize(object);
+		object->isMarked = false;
 	}
 }
 
+void ms_collectGarbage(ms_VM *vm)
+{
+	ms_GCStats *stats = &vm->gcStats;
+	clock_t start = clock();
+	stats->bytesBefore = vm->bytesUsed;
+
+#ifdef MS_DEBUG_LOG_GC
+	fprintf(stderr, "gc: begin cycle %zu\n", stats->cycles + 1);
+#endif
+
+	vm->gcPaused = true;
+	markRoots(vm);
+	traceReferences(vm);
+	pruneRememberedSet(vm);
+	removeWhiteStrings(vm);
+	sweep(vm);
+	vm->gcPaused = false;
+
+	size_t next = vm->bytesUsed * vm->gcGrowthFactor;
+	vm->nextGC = next > vm->minGCThreshold ? next : vm->minGCThreshold;
+
+	double pause = (double)(clock() - start) / CLOCKS_PER_SEC;
+	stats->cycles++;
+	stats->bytesAfter = vm->bytesUsed;
+	stats->lastPause = pause;
+	stats->totalPause += pause;
+	if (pause > stats->maxPause) stats->maxPause = pause;
+
+#ifdef MS_DEBUG_LOG_GC
+	fprintf(stderr, "gc: end cycle, collected %zu bytes (from %zu to %zu), next at %zu\n",
+		stats->bytesBefore - stats->bytesAfter, stats->bytesBefore, stats->bytesAfter, vm->nextGC);
+#endif
+}
+
+void ms_setGCGrowthFactor(ms_VM *vm, double factor)
+{
+	MS_ASSERT_REASON(factor >= 1, "the heap can't grow by less than its live size");
+	vm->gcGrowthFactor = factor;
+}
+
+void ms_setGCMinThreshold(ms_VM *vm, size_t bytes)
+{
+	vm->minGCThreshold = bytes;
+	if (vm->nextGC < bytes) vm->nextGC = bytes;
+}
+
+const ms_GCStats *ms_getGCStats(ms_VM *vm)
+{
+	return &vm->gcStats;
+}
+
 void ms_freeAllObjects(ms_VM* vm)
 {
 	ms_Object *obj = vm->objects;
@@ -62,16 +550,17 @@ void ms_freeAllObjects(ms_VM* vm)
 		freeObject(vm, obj);
 		obj = next;
 	}
-}
 
-// FNV-1a hash
-uint32_t ms_hashMem(const void *ptr, size_t length)
-{
-	uint8_t *p = (uint8_t *)ptr;
+	if (vm->nursery == NULL) return;
 
-	uint32_t hash = 2166136261u;
-	for (size_t i = 0; i < length; i++)
-		hash = (hash ^ p[i]) * 16777619;
+	// promoted objects were freed above, along with what they own
+	for (uint8_t *ptr = vm->nursery; ptr < vm->nurseryTop;)
+	{
+		ms_Object *object = (ms_Object*)ptr;
+		ptr += youngObjectSize(object);
+		if (object->next == NULL) releaseObject(vm, object);
+	}
 
-	return hash;
+	MS_MEM_FREE(vm, vm->nursery, MS_NURSERY_SIZE);
+	vm->nursery = vm->nurseryTop = vm->nurseryEnd = NULL;
 }
@@ -3,6 +3,7 @@
 
 #include "ms_common.h"
 #include "miniscript.h"
+#include "ms_value.h"
 
 #define MS_MEM_REALLOC(vm, ptr, oldSize, newSize) \
 	ms_vmRealloc(vm, ptr, oldSize, newSize)
@@ -26,6 +27,10 @@
 
 void *ms_vmRealloc(ms_VM *vm, void *ptr, size_t oldSize, size_t newSize);
 void ms_freeAllObjects(ms_VM* vm);
-uint32_t ms_hashMem(const void* ptr, size_t length);
+void *ms_allocateYoung(ms_VM *vm, size_t size);
+void ms_collectYoung(ms_VM *vm);
+void ms_writeBarrier(ms_VM *vm, ms_Object *owner, ms_Value value);
+void ms_markObject(ms_VM *vm, ms_Object *object);
+void ms_markValue(ms_VM *vm, ms_Value value);
 
 #endif
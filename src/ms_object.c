@@ -1,18 +1,37 @@
+#include <stdio.h>
 #include <string.h>
 
 #include "ms_code.h"
+#include "ms_hash.h"
+#include "ms_list.h"
 #include "ms_mem.h"
 #include "ms_object.h"
 #include "ms_map.h"
+#include "ms_mapobject.h"
+#include "ms_string.h"
 #include "ms_value.h"
 #include "ms_vm.h"
 
-static ms_Object *newObject(ms_VM *vm, size_t size, ms_ObjectType type)
+static inline void initObject(ms_Object *obj, ms_ObjectType type, ms_Object *next)
 {
-	ms_Object* obj = MS_MEM_MALLOC(vm, size);
-	obj->next = vm->objects;
-	vm->objects = obj;
 	obj->type = type;
+	obj->isMarked = obj->isRemembered = false;
+	obj->next = next;
+}
+
+static ms_Object *newObject(ms_VM *vm, size_t size, ms_ObjectType type)
+{
+	// functions are written to all throughout compilation and live as
+	// long as the code referencing them, so they skip the nursery
+	ms_Object *obj = type != MS_OBJ_FUNCTION ? ms_allocateYoung(vm, size) : NULL;
+	if (obj != NULL)
+		initObject(obj, type, NULL);
+	else
+	{
+		obj = MS_MEM_MALLOC(vm, size);
+		initObject(obj, type, vm->objects);
+		vm->objects = obj;
+	}
 	return obj;
 }
 
@@ -20,42 +39,93 @@ ms_ObjFunction *ms_newFunction(ms_VM *vm)
 {
 	ms_ObjFunction *function = (ms_ObjFunction*)newObject(vm, sizeof(ms_ObjFunction), MS_OBJ_FUNCTION);
 	function->arity = 0;
+	function->maxStack = 1;
 	ms_initCode(vm, &function->code);
 	return function;
 }
 
-static ms_ObjString *allocateString(ms_VM *vm, char *str, size_t length, uint32_t hash)
+ms_ObjString *ms_allocateString(ms_VM *vm, size_t length)
 {
-	ms_ObjString *obj = (ms_ObjString*)newObject(vm, sizeof(ms_ObjString), MS_OBJ_STRING);
-	obj->chars = str;
-	obj->length = length;
-	obj->hash = hash;
-	ms_setMapKey(vm, &vm->strings, MS_FROM_OBJ(obj), MS_FROM_NUM(1));
-	return obj;
+	ms_ObjString *str = (ms_ObjString*)newObject(vm, MS_STRING_SIZE(length), MS_OBJ_STRING);
+	str->length = length;
+	str->hash = 0;
+	str->isInterned = false;
+	str->chars[length] = '\0';
+	return str;
 }
 
-ms_ObjString *ms_newString(ms_VM *vm, char *str, size_t length)
+static ms_ObjString *addToStrings(ms_VM *vm, ms_ObjString *str, uint32_t hash)
 {
-	uint32_t hash = ms_hashMem(str, length);
-	ms_ObjString *interned = ms_findStringInMap(vm, &vm->strings, str, length, hash);
-	if (interned != NULL)
-	{
-		MS_MEM_FREE_ARR(vm, char, str, length+1);
-		return interned;
-	}
-	return allocateString(vm, str, length, hash);
+	str->hash = hash;
+	str->isInterned = true;
+
+	// the strings table is weak, keep the string alive while it grows
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(str));
+	ms_setMapKey(vm, &vm->strings, MS_FROM_OBJ(str), MS_FROM_NUM(1));
+	ms_popValueFromVM(vm);
+	return str;
+}
+
+ms_ObjString *ms_internString(ms_VM *vm, ms_ObjString *str)
+{
+	if (str->isInterned) return str;
+
+	uint32_t hash = ms_hashMem(str->chars, str->length, vm->hashSeed);
+	ms_ObjString *interned = ms_findStringInMap(vm, &vm->strings, str->chars, str->length, hash);
+	if (interned != NULL) return interned;
+	return addToStrings(vm, str, hash);
 }
 
 ms_ObjString *ms_copyString(ms_VM *vm, const char *str, size_t length)
 {
-	uint32_t hash = ms_hashMem(str, length);
+	uint32_t hash = ms_hashMem(str, length, vm->hashSeed);
 	ms_ObjString *interned = ms_findStringInMap(vm, &vm->strings, str, length, hash);
 	if (interned != NULL) return interned;
 
-	char *heapStr = MS_MEM_MALLOC_ARR(vm, char, length+1);
-	memcpy(heapStr, str, length);
-	heapStr[length] = '\0';
-	return allocateString(vm, heapStr, length, hash);
+	ms_ObjString *copy = ms_allocateString(vm, length);
+	memcpy(copy->chars, str, length);
+	return addToStrings(vm, copy, hash);
+}
+
+// the pieces have to be reachable, allocating the rope may collect
+ms_ObjRope *ms_newRope(ms_VM *vm, ms_Object *left, ms_Object *right, size_t length)
+{
+	ms_ObjRope *rope = (ms_ObjRope*)newObject(vm, sizeof(ms_ObjRope), MS_OBJ_ROPE);
+	rope->length = length;
+	rope->left = left;
+	rope->right = right;
+	rope->flat = NULL;
+
+	// the nursery may have been full, leaving an old rope pointing at young pieces
+	ms_writeBarrier(vm, &rope->obj, MS_FROM_OBJ(left));
+	ms_writeBarrier(vm, &rope->obj, MS_FROM_OBJ(right));
+	return rope;
+}
+
+// the items are allocated before the list, so there's nothing to lose if that collects
+ms_ObjList *ms_newList(ms_VM *vm, size_t cap, bool numeric)
+{
+	void *items = NULL;
+	if (cap > 0)
+		items = MS_MEM_MALLOC(vm, cap * (numeric ? sizeof(double) : sizeof(ms_Value)));
+
+	ms_ObjList *list = (ms_ObjList*)newObject(vm, sizeof(ms_ObjList), MS_OBJ_LIST);
+	list->isNumeric = numeric;
+	list->count = 0;
+	list->cap = cap;
+	list->as.values = items;
+	list->base = NULL;
+	return list;
+}
+
+ms_ObjMap *ms_newMap(ms_VM *vm)
+{
+	ms_ObjMap *map = (ms_ObjMap*)newObject(vm, sizeof(ms_ObjMap), MS_OBJ_MAP);
+	map->items = NULL;
+	map->count = map->cap = 0;
+	map->index = NULL;
+	map->indexCap = 0;
+	return map;
 }
 
 void printFunction(ms_ObjFunction *function)
@@ -73,6 +143,18 @@ void ms_printObject(ms_Value val)
 			printf("%s", MS_TO_CSTRING(val));
 			break;
 
+		case MS_OBJ_ROPE:
+			ms_printRope(MS_TO_ROPE(val));
+			break;
+
+		case MS_OBJ_LIST:
+			ms_printList(MS_TO_LIST(val));
+			break;
+
+		case MS_OBJ_MAP:
+			ms_printMap(MS_TO_MAP(val));
+			break;
+
 		case MS_OBJ_FUNCTION:
 			printFunction(MS_TO_FUNCTION(val));
 			break;
@@ -86,6 +168,9 @@ double ms_getBoolObj(ms_Value val)
 	switch (MS_OBJ_TYPE(val))
 	{
 		case MS_OBJ_STRING: return MS_TO_STRING(val)->length != 0;
+		case MS_OBJ_ROPE:   return MS_TO_ROPE(val)->length != 0;
+		case MS_OBJ_LIST:   return MS_TO_LIST(val)->count != 0;
+		case MS_OBJ_MAP:    return MS_TO_MAP(val)->count != 0;
 		default: MS_UNREACHABLE("ms_getBoolObj"); break;
 	}
 }
@@ -7,11 +7,17 @@
 
 typedef enum {
 	MS_OBJ_STRING,
+	MS_OBJ_ROPE,
+	MS_OBJ_LIST,
+	MS_OBJ_MAP,
 	MS_OBJ_FUNCTION,
 } ms_ObjectType;
 
 struct ms_Object {
 	ms_ObjectType type;
+	bool isMarked, isRemembered;
+	// old objects are linked through this, young ones use it
+	// to point at their promoted copy once they survive
 	struct ms_Object *next;
 };
 
@@ -19,26 +25,102 @@ struct ms_Object {
 typedef struct {
 	ms_Object obj;
 	int arity;
+	// most stack slots a frame of this function can use, slot 0 included
+	int maxStack;
 	ms_Code code;
 } ms_ObjFunction;
 
+// the characters are allocated along with the object, null terminated.
+// strings made while running aren't interned (and have no hash) until
+// something needs them to be, see ms_internString
 struct ms_ObjString {
 	ms_Object obj;
-	char *chars;
 	size_t length;
 	uint32_t hash;
+	bool isInterned;
+	char chars[];
 };
 
+#define MS_STRING_SIZE(length) (offsetof(ms_ObjString, chars) + (length) + 1)
 
-#define MS_TO_OBJ(val) val.as.object
+// a string that's still in pieces. concatenating and repeating strings
+// builds these instead of copying characters around, and the pieces are
+// only put together once something looks at the characters (see ms_string.h)
+typedef struct {
+	ms_Object obj;
+	size_t length;
+	// each is a string or another rope. they're the same piece when
+	// it's repeated twice, and both NULL once the rope has been flattened
+	ms_Object *left, *right;
+	ms_ObjString *flat;
+} ms_ObjRope;
+
+// lists own their items, unless they're a view: slicing a list doesn't
+// copy anything, both lists read the same items until one of them is
+// written to. lists of nothing but numbers keep them as plain doubles,
+// until something else is written to them (see ms_list.h)
+typedef struct ms_ObjList {
+	ms_Object obj;
+	bool isNumeric;
+	size_t count;
+	// how many items the list has room for, 0 for views
+	size_t cap;
+	// where the items are read from, either the list's own
+	// buffer or a part of the base's. `numbers` when it's numeric
+	union {
+		ms_Value *values;
+		double *numbers;
+	} as;
+	// what a view's items belong to. bases are never written to
+	struct ms_ObjList *base;
+} ms_ObjList;
+
+typedef struct {
+	ms_Value key, value;
+	uint32_t hash;
+} ms_MapItem;
+
+// maps as scripts see them, not to be confused with ms_Map. the items are
+// kept packed in the order they were added, and found through a separate
+// table of positions into them (see ms_mapobject.h)
+typedef struct {
+	ms_Object obj;
+	ms_MapItem *items;
+	size_t count, cap;
+	// 0 for an empty slot, otherwise the item's position plus one.
+	// small maps don't have one, looking through the items is faster
+	uint32_t *index;
+	size_t indexCap;
+} ms_ObjMap;
+
+
+#ifdef MS_NAN_BOXING
+
+#define MS_TO_OBJ(val) ((ms_Object*)(uintptr_t)((val) & ~(MS__SIGN_BIT | MS__QNAN)))
+#define MS_FROM_OBJ(val) ((ms_Value)(MS__SIGN_BIT | MS__QNAN | (uint64_t)(uintptr_t)(val)))
+#define MS_IS_OBJ(val) (((val) & (MS__SIGN_BIT | MS__QNAN)) == (MS__SIGN_BIT | MS__QNAN))
+
+#else
+
+#define MS_TO_OBJ(val) (val).as.object
 #define MS_FROM_OBJ(val) ((ms_Value){ .type = MS_TYPE_OBJ, .as.object = (ms_Object*)val })
-#define MS_IS_OBJ(val) (val.type == MS_TYPE_OBJ)
+#define MS_IS_OBJ(val) ((val).type == MS_TYPE_OBJ)
+
+#endif // MS_NAN_BOXING
 
 #define MS_OBJ_TYPE(val) (MS_TO_OBJ(val)->type)
 #define MS_IS_STRING(val) isObjType(val, MS_OBJ_STRING)
+#define MS_IS_ROPE(val) isObjType(val, MS_OBJ_ROPE)
+#define MS_IS_LIST(val) isObjType(val, MS_OBJ_LIST)
+#define MS_IS_MAP(val) isObjType(val, MS_OBJ_MAP)
 #define MS_IS_FUNCTION(val) isObjType(val, MS_OBJ_FUNCTION)
+// strings as scripts see them, flat or not
+#define MS_IS_ANY_STRING(val) (MS_IS_STRING(val) || MS_IS_ROPE(val))
 
 #define MS_TO_STRING(val) ((ms_ObjString*)MS_TO_OBJ(val))
+#define MS_TO_ROPE(val) ((ms_ObjRope*)MS_TO_OBJ(val))
+#define MS_TO_LIST(val) ((ms_ObjList*)MS_TO_OBJ(val))
+#define MS_TO_MAP(val) ((ms_ObjMap*)MS_TO_OBJ(val))
 #define MS_TO_CSTRING(val) (((ms_ObjString*)MS_TO_OBJ(val))->chars)
 #define MS_TO_FUNCTION(val) ((ms_ObjFunction*)MS_TO_OBJ(val))
 
@@ -48,8 +130,17 @@ static inline bool isObjType(ms_Value val, ms_ObjectType type)
 }
 
 ms_ObjFunction *ms_newFunction(ms_VM* vm);
-ms_ObjString *ms_newString(ms_VM *vm, char *str, size_t length);
+// a string with room for `length` characters, to be filled in
+// and then handed to ms_internString before anything else allocates
+ms_ObjString *ms_allocateString(ms_VM *vm, size_t length);
+// returns the string that ends up in the strings table: either `str`
+// or an equal one that was already there, in which case `str` is left for the gc
+ms_ObjString *ms_internString(ms_VM *vm, ms_ObjString *str);
 ms_ObjString *ms_copyString(ms_VM *vm, const char *str, size_t length);
+ms_ObjRope *ms_newRope(ms_VM *vm, ms_Object *left, ms_Object *right, size_t length);
+// an empty list with room for `cap` items, numbers or any kind of value
+ms_ObjList *ms_newList(ms_VM *vm, size_t cap, bool numeric);
+ms_ObjMap *ms_newMap(ms_VM *vm);
 void ms_printObject(ms_Value val);
 double ms_getBoolObj(ms_Value val);
 
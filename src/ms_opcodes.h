@@ -19,6 +19,8 @@ OPCODE(MS_OP_DIVIDE)
 OPCODE(MS_OP_POWER)
 OPCODE(MS_OP_MODULO)
 OPCODE(MS_OP_NEGATE)
+// what the compiler turns `x^2` into, there's no DUP to build `x * x` out of
+OPCODE(MS_OP_SQUARE)
 
 OPCODE(MS_OP_EQUAL)
 OPCODE(MS_OP_NOT_EQUAL)
@@ -31,17 +33,62 @@ OPCODE(MS_OP_AND)
 OPCODE(MS_OP_OR)
 OPCODE(MS_OP_NOT)
 
+// BUILD_LIST takes how many values on the stack go in the list as a 16-bit operand
+OPCODE(MS_OP_BUILD_LIST)
+OPCODE(MS_OP_GET_INDEX)
+OPCODE(MS_OP_SET_INDEX)
+OPCODE(MS_OP_SLICE)
+// same as BUILD_LIST, counting key and value pairs
+OPCODE(MS_OP_BUILD_MAP)
+
 OPCODE(MS_OP_SET_GLOBAL)
 OPCODE(MS_OP_GET_GLOBAL)
 OPCODE(MS_OP_SET_LOCAL)
 OPCODE(MS_OP_GET_LOCAL)
 OPCODE(MS_OP_INVOKE)
+// an INVOKE whose result is returned right away, reuses the caller's frame
+OPCODE(MS_OP_TAIL_INVOKE)
 
 OPCODE(MS_OP_JUMP)
 OPCODE(MS_OP_JUMP_IF_FALSE)
 OPCODE(MS_OP_LOOP)
+// steps a for loop over the sequence and position below the top of the stack,
+// pushing the next item, or jumping forward once there aren't any more
+OPCODE(MS_OP_FOR_ITER)
+
+// the same as the ones with the short names, with 24-bit operands instead,
+// for functions with more than 256 constants or jumps over more than 64 KiB
+OPCODE(MS_OP_CONST_LONG)
+OPCODE(MS_OP_JUMP_LONG)
+OPCODE(MS_OP_JUMP_IF_FALSE_LONG)
+OPCODE(MS_OP_LOOP_LONG)
+OPCODE(MS_OP_FOR_ITER_LONG)
 
 OPCODE(MS_OP_POP)
 OPCODE(MS_OP_RETURN)
 
+// superinstructions, only emitted by the peephole pass in ms_optimizer.c
+OPCODE(MS_OP_GET_LOCAL_INVOKE)
+OPCODE(MS_OP_GET_GLOBAL_INVOKE)
+OPCODE(MS_OP_ADD_CONST)
+OPCODE(MS_OP_POP_JUMP_IF_FALSE)
+OPCODE(MS_OP_LESS_JUMP_IF_FALSE)
+
+// quickened forms, only written over the generic ones by the VM once they've
+// run on numbers. they check that they still get numbers, and put the
+// generic opcode back as soon as they don't. see ms_genericOpcode
+OPCODE(MS_OP_ADD_NUM_NUM)
+OPCODE(MS_OP_SUBTRACT_NUM_NUM)
+OPCODE(MS_OP_MULTIPLY_NUM_NUM)
+OPCODE(MS_OP_DIVIDE_NUM_NUM)
+OPCODE(MS_OP_EQUAL_NUM_NUM)
+OPCODE(MS_OP_NOT_EQUAL_NUM_NUM)
+OPCODE(MS_OP_LESS_NUM_NUM)
+OPCODE(MS_OP_LESS_EQUAL_NUM_NUM)
+OPCODE(MS_OP_GREATER_NUM_NUM)
+OPCODE(MS_OP_GREATER_EQUAL_NUM_NUM)
+// ADD_CONST with a number constant, only checks the other operand
+OPCODE(MS_OP_ADD_CONST_NUM)
+OPCODE(MS_OP_LESS_NUM_JUMP_IF_FALSE)
+
 OPCODE(MS_OP__END)
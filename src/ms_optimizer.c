@@ -0,0 +1,713 @@
+#include <string.h>
+
+#include "ms_optimizer.h"
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_vm.h"
+
+// code is decoded into a flat list of instructions whose jumps point
+// at other instructions instead of byte offsets, so that instructions
+// can be merged without caring about addresses. it is encoded back
+// into bytecode once every pass is done
+typedef struct {
+	uint8_t op;
+	size_t operand; // index of the target instruction for jumps
+	int line;
+	// where it was in the code it was decoded from, and how deep the
+	// stack is when it runs (-1 if it never does, see computeDepths)
+	size_t offset;
+	int depth;
+	bool isTarget, isDeleted;
+} Instruction;
+
+static bool isJump(uint8_t op)
+{
+	switch (op)
+	{
+		case MS_OP_JUMP:
+		case MS_OP_JUMP_IF_FALSE:
+		case MS_OP_LOOP:
+		case MS_OP_FOR_ITER:
+		case MS_OP_POP_JUMP_IF_FALSE:
+		case MS_OP_LESS_JUMP_IF_FALSE:
+		case MS_OP_JUMP_LONG:
+		case MS_OP_JUMP_IF_FALSE_LONG:
+		case MS_OP_LOOP_LONG:
+		case MS_OP_FOR_ITER_LONG:
+			return true;
+
+		default: return false;
+	}
+}
+
+static inline bool isLoop(uint8_t op)
+{
+	return op == MS_OP_LOOP || op == MS_OP_LOOP_LONG;
+}
+
+static inline size_t instructionSize(uint8_t op)
+{
+	return 1 + ms_opcodeInfo[op].operandBytes;
+}
+
+static Instruction *decode(ms_VM *vm, ms_Code *code, size_t *count)
+{
+	// maps the offset of every instruction to its index
+	size_t *indices = MS_MEM_MALLOC_ARR(vm, size_t, code->count + 1);
+
+	size_t n = 0;
+	for (size_t offset = 0; offset < code->count; offset += instructionSize(code->data[offset]))
+		indices[offset] = n++;
+	indices[code->count] = n;
+
+	Instruction *instructions = MS_MEM_MALLOC_ARR(vm, Instruction, n);
+	size_t run = 0;
+	for (size_t offset = 0, i = 0; offset < code->count; i++)
+	{
+		uint8_t *ip = code->data + offset;
+		Instruction *ins = instructions + i;
+
+		// instructions are visited in order, so the runs can be too
+		while (run + 1 < code->lineCount && code->lines[run + 1].offset <= offset) run++;
+
+		ins->op = *ip;
+		ins->line = code->lines[run].line;
+		ins->offset = offset;
+		ins->depth = -1;
+		ins->isTarget = ins->isDeleted = false;
+
+		switch (ms_opcodeInfo[*ip].operandBytes)
+		{
+			case 0: ins->operand = 0; break;
+			case 1: ins->operand = ip[1]; break;
+			case 2: ins->operand = (size_t)(ip[1] << 8 | ip[2]); break;
+			case 3: ins->operand = (size_t)ip[1] << 16 | ip[2] << 8 | ip[3]; break;
+			default: MS_UNREACHABLE("decode"); break;
+		}
+
+		offset += instructionSize(*ip);
+
+		if (isJump(*ip))
+			ins->operand = indices[isLoop(*ip) ? offset - ins->operand : offset + ins->operand];
+	}
+
+	for (size_t i = 0; i < n; i++)
+		if (isJump(instructions[i].op) && instructions[i].operand < n)
+			instructions[instructions[i].operand].isTarget = true;
+
+	MS_MEM_FREE_ARR(vm, size_t, indices, code->count + 1);
+	*count = n;
+	return instructions;
+}
+
+////////////////////////////
+
+// the passes below only run with the optimizing compiler on, see
+// ms_setOptimizingCompiler. they come before any instructions are
+// fused, so they only ever see what the compiler emits.
+// deleted instructions are treated as if they did nothing
+
+static inline bool isUnconditional(uint8_t op)
+{
+	switch (op)
+	{
+		case MS_OP_JUMP:
+		case MS_OP_JUMP_LONG:
+		case MS_OP_LOOP:
+		case MS_OP_LOOP_LONG:
+		case MS_OP_RETURN:
+			return true;
+
+		default: return false;
+	}
+}
+
+static inline bool isConditional(uint8_t op)
+{
+	return op == MS_OP_JUMP_IF_FALSE || op == MS_OP_JUMP_IF_FALSE_LONG;
+}
+
+// the first instruction at or after index that wasn't deleted
+static size_t nextLive(Instruction *instructions, size_t count, size_t index)
+{
+	while (index < count && instructions[index].isDeleted) index++;
+	return index;
+}
+
+// how many values the instruction takes off the stack
+static int popCount(Instruction *ins)
+{
+	switch (ins->op)
+	{
+		case MS_OP_INVOKE:
+		case MS_OP_TAIL_INVOKE: return (int)ins->operand + 1;
+		case MS_OP_BUILD_LIST:  return (int)ins->operand;
+		case MS_OP_BUILD_MAP:   return 2 * (int)ins->operand;
+
+		case MS_OP_SET_INDEX:
+		case MS_OP_SLICE:
+			return 3;
+
+		case MS_OP_ADD:
+		case MS_OP_SUBTRACT:
+		case MS_OP_MULTIPLY:
+		case MS_OP_DIVIDE:
+		case MS_OP_POWER:
+		case MS_OP_MODULO:
+		case MS_OP_EQUAL:
+		case MS_OP_NOT_EQUAL:
+		case MS_OP_LESS:
+		case MS_OP_LESS_EQUAL:
+		case MS_OP_GREATER:
+		case MS_OP_GREATER_EQUAL:
+		case MS_OP_AND:
+		case MS_OP_OR:
+		case MS_OP_GET_INDEX:
+			return 2;
+
+		case MS_OP_NEGATE:
+		case MS_OP_SQUARE:
+		case MS_OP_NOT:
+		case MS_OP_SET_GLOBAL:
+		case MS_OP_SET_LOCAL:
+		case MS_OP_POP:
+		case MS_OP_RETURN:
+		// the position in the sequence is replaced, then the item pushed
+		case MS_OP_FOR_ITER:
+		case MS_OP_FOR_ITER_LONG:
+			return 1;
+
+		default: return 0;
+	}
+}
+
+// and how many it pushes in their place, when it doesn't jump
+static int pushCount(Instruction *ins)
+{
+	int effect = ms_opcodeInfo[ins->op].stackEffect;
+	if (ins->op == MS_OP_INVOKE || ins->op == MS_OP_TAIL_INVOKE) effect -= (int)ins->operand;
+	if (ins->op == MS_OP_BUILD_LIST) effect -= (int)ins->operand;
+	if (ins->op == MS_OP_BUILD_MAP) effect -= 2 * (int)ins->operand;
+	return popCount(ins) + effect;
+}
+
+// walks every path from the start, like computeMaxStack in the compiler.
+// whatever's left with a depth of -1 can never run
+static void computeDepths(ms_VM *vm, Instruction *instructions, size_t count, int initialDepth)
+{
+	size_t *pending = MS_MEM_MALLOC_ARR(vm, size_t, count);
+	size_t pendingCount = 0;
+
+	for (size_t i = 0; i < count; i++) instructions[i].depth = -1;
+
+#define VISIT(index, d) do {                                    \
+    size_t v = (index);                                         \
+    if (v < count && instructions[v].depth == -1)               \
+    {                                                           \
+      instructions[v].depth = (d);                              \
+      pending[pendingCount++] = v;                              \
+    }                                                           \
+  } while(0)
+
+	VISIT(0, initialDepth);
+	while (pendingCount > 0)
+	{
+		size_t i = pending[--pendingCount];
+		Instruction *ins = instructions + i;
+		int depth = ins->depth;
+
+		if (ins->isDeleted)
+		{
+			VISIT(i + 1, depth);
+			continue;
+		}
+
+		int next = depth - popCount(ins) + pushCount(ins);
+		switch (ins->op)
+		{
+			case MS_OP_RETURN: break;
+
+			case MS_OP_JUMP:
+			case MS_OP_JUMP_LONG:
+			case MS_OP_LOOP:
+			case MS_OP_LOOP_LONG:
+				VISIT(ins->operand, depth);
+				break;
+
+			case MS_OP_JUMP_IF_FALSE:
+			case MS_OP_JUMP_IF_FALSE_LONG:
+			case MS_OP_FOR_ITER:
+			case MS_OP_FOR_ITER_LONG:
+				VISIT(ins->operand, depth);
+				VISIT(i + 1, next);
+				break;
+
+			default: VISIT(i + 1, next); break;
+		}
+	}
+
+#undef VISIT
+
+	MS_MEM_FREE_ARR(vm, size_t, pending, count);
+}
+
+// code after a `return` (or the JUMP over an else that follows one...)
+static void removeUnreachable(Instruction *instructions, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		if (instructions[i].depth == -1) instructions[i].isDeleted = true;
+}
+
+// points every jump at an instruction that's still there, and marks those
+static void markTargets(Instruction *instructions, size_t count)
+{
+	for (size_t i = 0; i < count; i++) instructions[i].isTarget = false;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		Instruction *ins = instructions + i;
+		if (ins->isDeleted || !isJump(ins->op)) continue;
+
+		ins->operand = nextLive(instructions, count, ins->operand);
+		if (ins->operand < count) instructions[ins->operand].isTarget = true;
+	}
+}
+
+// the end of a nested `if` jumps to the end of the one around it, which
+// jumps somewhere else again, or back to the start of a `while`. such
+// jumps go straight to where the last one leads, or become a copy of
+// the LOOP or RETURN they land on. conditional jumps can be threaded
+// through other conditional jumps too: the condition is still on the stack
+static void threadJumps(Instruction *instructions, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		Instruction *ins = instructions + i;
+		if (ins->isDeleted) continue;
+
+		bool conditional = isConditional(ins->op);
+		if (!conditional && ins->op != MS_OP_JUMP && ins->op != MS_OP_JUMP_LONG) continue;
+
+		bool isLong = ins->op == MS_OP_JUMP_LONG || ins->op == MS_OP_JUMP_IF_FALSE_LONG;
+		size_t reach = isLong ? MS_MAX_LONG_OPERAND : UINT16_MAX;
+
+		// every jump followed is a forward one, so this can't go around in circles
+		for (;;)
+		{
+			ins->operand = nextLive(instructions, count, ins->operand);
+			if (ins->operand >= count) break;
+
+			Instruction *target = instructions + ins->operand;
+			bool follow = target->op == MS_OP_JUMP || target->op == MS_OP_JUMP_LONG
+				|| (conditional && isConditional(target->op));
+			if (!follow) break;
+
+			// nothing is ever replaced with something longer, so the
+			// distance can only shrink once it's encoded again
+			size_t dest = nextLive(instructions, count, target->operand);
+			if (dest >= count || instructions[dest].offset - ins->offset > reach) break;
+			ins->operand = dest;
+		}
+
+		if (conditional || ins->operand >= count) continue;
+
+		// unless the copy would be longer, like a LOOP_LONG over a JUMP
+		Instruction *target = instructions + ins->operand;
+		bool copy = (target->op == MS_OP_RETURN || isLoop(target->op))
+			&& instructionSize(target->op) <= instructionSize(ins->op);
+		if (copy)
+		{
+			// a LOOP from here has less to go back over than the one copied
+			ins->op = target->op;
+			ins->operand = target->operand;
+		}
+		else if (ins->operand == nextLive(instructions, count, i + 1))
+			ins->isDeleted = true;
+	}
+}
+
+// what's known about a stack slot: MS_OP__END for nothing, GET_LOCAL
+// for holding the same value as the local in `operand`, or the
+// instruction that pushes the constant it holds
+typedef struct {
+	uint8_t op;
+	size_t operand;
+} Fact;
+
+static const Fact unknownFact = { MS_OP__END, 0 };
+
+static inline bool isPushConstant(uint8_t op)
+{
+	switch (op)
+	{
+		case MS_OP_CONST:
+		case MS_OP_CONST_LONG:
+		case MS_OP_NULL:
+		case MS_OP_TRUE:
+		case MS_OP_FALSE:
+			return true;
+
+		default: return false;
+	}
+}
+
+// the slot was written to: it's not known to hold anything, and
+// whatever was known to be a copy of it isn't anymore
+static void forgetSlot(Fact *facts, size_t slots, size_t slot)
+{
+	for (size_t i = 0; i < slots; i++)
+		if (facts[i].op == MS_OP_GET_LOCAL && facts[i].operand == slot)
+			facts[i] = unknownFact;
+	if (slot < slots) facts[slot] = unknownFact;
+}
+
+// after `b = @a` or `b = 1`, reading b reads a or the constant instead,
+// until either is assigned again or the code branches. that's what lets
+// the pass after this one drop the store to b. reading a constant is
+// also cheaper, and invoking one does nothing as they're never functions
+static void propagateCopies(ms_VM *vm, ms_Code *code, Instruction *instructions, size_t count)
+{
+	size_t slots = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		Instruction *ins = instructions + i;
+		if (ins->isDeleted) continue;
+
+		size_t top = (size_t)(ins->depth - popCount(ins) + pushCount(ins));
+		if ((size_t)ins->depth > slots) slots = ins->depth;
+		if (top > slots) slots = top;
+	}
+
+	Fact *facts = MS_MEM_MALLOC_ARR(vm, Fact, slots + 1);
+	bool fallsThrough = false;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		Instruction *ins = instructions + i;
+		if (ins->isDeleted) continue;
+
+		// nothing is known about code that can be reached from somewhere else
+		if (ins->isTarget || !fallsThrough)
+			for (size_t s = 0; s <= slots; s++) facts[s] = unknownFact;
+		fallsThrough = !isUnconditional(ins->op);
+
+		size_t depth = (size_t)ins->depth;
+		switch (ins->op)
+		{
+			case MS_OP_GET_LOCAL: {
+				Fact fact = ins->operand < depth ? facts[ins->operand] : unknownFact;
+				if (fact.op == MS_OP_GET_LOCAL) ins->operand = fact.operand;
+				else if (fact.op == MS_OP__END) fact = (Fact){ MS_OP_GET_LOCAL, ins->operand };
+				// a CONST_LONG would make the code longer, and the jumps
+				// over it were already given their sizes by the compiler
+				else if (instructionSize(fact.op) <= instructionSize(ins->op))
+				{
+					ins->op = fact.op;
+					ins->operand = fact.operand;
+
+					size_t next = nextLive(instructions, count, i + 1);
+					if (next < count && instructions[next].op == MS_OP_INVOKE
+					 && instructions[next].operand == 0 && !instructions[next].isTarget)
+						instructions[next].isDeleted = true;
+				}
+
+				forgetSlot(facts, slots, depth);
+				facts[depth] = fact;
+			} break;
+
+			case MS_OP_SET_LOCAL: {
+				Fact fact = facts[depth - 1];
+				size_t local = ins->operand;
+
+				forgetSlot(facts, slots, depth - 1);
+				forgetSlot(facts, slots, local);
+				bool itself = fact.op == MS_OP_GET_LOCAL && fact.operand == local;
+				if (!itself) facts[local] = fact;
+			} break;
+
+			default: {
+				// whatever was popped or pushed is gone
+				size_t low = depth - popCount(ins);
+				size_t high = low + pushCount(ins);
+				if (depth > high) high = depth;
+				for (size_t s = low; s < high; s++) forgetSlot(facts, slots, s);
+
+				if (isPushConstant(ins->op))
+				{
+					bool function = (ins->op == MS_OP_CONST || ins->op == MS_OP_CONST_LONG)
+						&& MS_IS_FUNCTION(code->constants.data[ins->operand]);
+					if (!function) facts[depth] = (Fact){ ins->op, ins->operand };
+				}
+			} break;
+		}
+	}
+
+	MS_MEM_FREE_ARR(vm, Fact, facts, slots + 1);
+}
+
+// locals are up to UINT8_COUNT slots, one bit each
+typedef struct {
+	uint64_t bits[UINT8_COUNT / 64];
+} SlotSet;
+
+static inline void addSlot(SlotSet *set, size_t slot)
+{
+	if (slot < UINT8_COUNT) set->bits[slot / 64] |= (uint64_t)1 << (slot % 64);
+}
+
+static inline void removeSlot(SlotSet *set, size_t slot)
+{
+	if (slot < UINT8_COUNT) set->bits[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+}
+
+static inline bool hasSlot(SlotSet *set, size_t slot)
+{
+	return slot < UINT8_COUNT && (set->bits[slot / 64] >> (slot % 64) & 1);
+}
+
+static inline void addSlots(SlotSet *set, SlotSet *other)
+{
+	for (int i = 0; i < UINT8_COUNT / 64; i++) set->bits[i] |= other->bits[i];
+}
+
+// the slots whose values may still be read after the instruction at i
+static SlotSet liveAfter(Instruction *instructions, SlotSet *live, size_t i)
+{
+	SlotSet out = {0};
+	Instruction *ins = instructions + i;
+	if (ins->isDeleted || !isUnconditional(ins->op) || isJump(ins->op))
+	{
+		if (isJump(ins->op) && !ins->isDeleted) addSlots(&out, &live[ins->operand]);
+		if (ins->isDeleted || !isUnconditional(ins->op)) addSlots(&out, &live[i + 1]);
+	}
+	return out;
+}
+
+// a store to a local that isn't read again before it's assigned or goes out
+// of scope only has to pop the value. liveness of every slot is found by
+// going backwards over the code until nothing changes, for the loops
+static void eliminateDeadStores(ms_VM *vm, Instruction *instructions, size_t count)
+{
+	// live[i] is what's live right before instruction i runs, live[count] is empty
+	SlotSet *live = MS_MEM_MALLOC_ARR(vm, SlotSet, count + 1);
+	memset(live, 0, sizeof(SlotSet) * (count + 1));
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t i = count; i-- > 0;)
+		{
+			Instruction *ins = instructions + i;
+			SlotSet in = liveAfter(instructions, live, i);
+
+			if (!ins->isDeleted)
+			{
+				size_t depth = (size_t)ins->depth;
+				size_t low = depth - popCount(ins);
+
+				// written slots are dead before, read ones live
+				if (ins->op == MS_OP_SET_LOCAL) removeSlot(&in, ins->operand);
+				for (size_t s = low; s < low + pushCount(ins); s++) removeSlot(&in, s);
+
+				if (ins->op == MS_OP_GET_LOCAL) addSlot(&in, ins->operand);
+				if (ins->op != MS_OP_POP)
+					for (size_t s = low; s < depth; s++) addSlot(&in, s);
+				// the sequence being iterated, and the condition that's left on the stack
+				if (ins->op == MS_OP_FOR_ITER || ins->op == MS_OP_FOR_ITER_LONG) addSlot(&in, depth - 2);
+				if (isConditional(ins->op)) addSlot(&in, depth - 1);
+			}
+
+			if (memcmp(&in, &live[i], sizeof in) != 0)
+			{
+				live[i] = in;
+				changed = true;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		Instruction *ins = instructions + i;
+		if (ins->isDeleted || ins->op != MS_OP_SET_LOCAL) continue;
+
+		SlotSet out = liveAfter(instructions, live, i);
+		if (!hasSlot(&out, ins->operand))
+		{
+			ins->op = MS_OP_POP;
+			ins->operand = 0;
+		}
+	}
+
+	MS_MEM_FREE_ARR(vm, SlotSet, live, count + 1);
+}
+
+// what's left of a dead store of a copy: pushing a value only to pop it
+static void removeDiscardedPushes(Instruction *instructions, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		Instruction *ins = instructions + i;
+		if (ins->isDeleted) continue;
+		if (!isPushConstant(ins->op) && ins->op != MS_OP_GET_LOCAL && ins->op != MS_OP_GET_GLOBAL) continue;
+
+		size_t next = nextLive(instructions, count, i + 1);
+		if (next < count && instructions[next].op == MS_OP_POP && !instructions[next].isTarget)
+			ins->isDeleted = instructions[next].isDeleted = true;
+	}
+}
+
+////////////////////////////
+
+// the instruction at index, if it has the given opcode and nothing jumps to it
+static Instruction *fusable(Instruction *instructions, size_t count, size_t index, uint8_t op)
+{
+	if (index >= count) return NULL;
+
+	Instruction *ins = instructions + index;
+	if (ins->op != op || ins->isTarget || ins->isDeleted) return NULL;
+	return ins;
+}
+
+// the sequences fused here are the most frequently executed pairs of the
+// benchmark corpus (see bench/bench_dispatch.c with MS_PROFILE_OPCODES)
+static void fuseInstructions(Instruction *instructions, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		Instruction *ins = instructions + i;
+		if (ins->isDeleted) continue;
+
+		switch (ins->op)
+		{
+			// every identifier is read as GET_X; INVOKE 0
+			case MS_OP_GET_LOCAL:
+			case MS_OP_GET_GLOBAL: {
+				Instruction *invoke = fusable(instructions, count, i + 1, MS_OP_INVOKE);
+				if (invoke == NULL || invoke->operand != 0) break;
+
+				ins->op = ins->op == MS_OP_GET_LOCAL ? MS_OP_GET_LOCAL_INVOKE : MS_OP_GET_GLOBAL_INVOKE;
+				invoke->isDeleted = true;
+			} break;
+
+			case MS_OP_CONST: {
+				Instruction *add = fusable(instructions, count, i + 1, MS_OP_ADD);
+				if (add == NULL) break;
+
+				ins->op = MS_OP_ADD_CONST;
+				add->isDeleted = true;
+			} break;
+
+			// `if` and `while` leave the condition on the stack for
+			// a POP on both paths. when the jump lands on a POP too,
+			// both can be folded into the jump, which then skips it
+			case MS_OP_LESS:
+			case MS_OP_JUMP_IF_FALSE: {
+				size_t next = i + (ins->op == MS_OP_LESS);
+				Instruction *jump = ins->op == MS_OP_LESS
+					? fusable(instructions, count, next, MS_OP_JUMP_IF_FALSE)
+					: ins;
+				Instruction *pop = fusable(instructions, count, next + 1, MS_OP_POP);
+
+				if (jump == NULL || pop == NULL) break;
+				if (jump->operand + 1 >= count || instructions[jump->operand].op != MS_OP_POP) break;
+
+				size_t target = jump->operand + 1;
+				if (ins->op == MS_OP_LESS) jump->isDeleted = true;
+				ins->op = ins->op == MS_OP_LESS ? MS_OP_LESS_JUMP_IF_FALSE : MS_OP_POP_JUMP_IF_FALSE;
+				ins->operand = target;
+				instructions[target].isTarget = true;
+				pop->isDeleted = true;
+			} break;
+
+			default: break;
+		}
+	}
+}
+
+static void encode(ms_VM *vm, ms_Code *code, Instruction *instructions, size_t count)
+{
+	size_t *offsets = MS_MEM_MALLOC_ARR(vm, size_t, count + 1);
+
+	size_t offset = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		offsets[i] = offset;
+		if (!instructions[i].isDeleted) offset += instructionSize(instructions[i].op);
+	}
+	offsets[count] = offset;
+
+	ms_Code out;
+	ms_initCode(vm, &out);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		Instruction *ins = instructions + i;
+		if (ins->isDeleted) continue;
+
+		size_t operand = ins->operand;
+		if (isJump(ins->op))
+		{
+			size_t next = offsets[i] + instructionSize(ins->op);
+			size_t target = offsets[ins->operand];
+			operand = isLoop(ins->op) ? next - target : target - next;
+		}
+		MS_ASSERT_REASON(operand < (size_t)1 << 8 * ms_opcodeInfo[ins->op].operandBytes,
+			"an operand outgrew its instruction while optimizing");
+
+		ms_addByteToCode(vm, &out, ins->op, ins->line);
+		switch (ms_opcodeInfo[ins->op].operandBytes)
+		{
+			case 0: break;
+			case 1: ms_addByteToCode(vm, &out, operand & 0xff, ins->line); break;
+			case 2:
+				ms_addByteToCode(vm, &out, (operand >> 8) & 0xff, ins->line);
+				ms_addByteToCode(vm, &out, operand & 0xff, ins->line);
+				break;
+			case 3:
+				ms_addByteToCode(vm, &out, (operand >> 16) & 0xff, ins->line);
+				ms_addByteToCode(vm, &out, (operand >> 8) & 0xff, ins->line);
+				ms_addByteToCode(vm, &out, operand & 0xff, ins->line);
+				break;
+			default: MS_UNREACHABLE("encode"); break;
+		}
+	}
+
+	MS_MEM_FREE_ARR(vm, size_t, offsets, count + 1);
+
+	// the constants stay where they are, only the bytecode is replaced
+	ms_freeList(vm, &out.constants);
+	out.constants = code->constants;
+	ms_initList(vm, &code->constants);
+	ms_freeCode(vm, code);
+	*code = out;
+}
+
+void ms_optimizeCode(ms_VM *vm, ms_Code *code, int initialDepth)
+{
+	if (code->count == 0) return;
+
+	size_t count;
+	Instruction *instructions = decode(vm, code, &count);
+
+	if (vm->optimizeCode)
+	{
+		computeDepths(vm, instructions, count, initialDepth);
+		removeUnreachable(instructions, count);
+		threadJumps(instructions, count);
+		// threading may have left more code behind that nothing gets to
+		computeDepths(vm, instructions, count, initialDepth);
+		removeUnreachable(instructions, count);
+
+		markTargets(instructions, count);
+		propagateCopies(vm, code, instructions, count);
+		eliminateDeadStores(vm, instructions, count);
+		removeDiscardedPushes(instructions, count);
+		markTargets(instructions, count);
+	}
+
+	fuseInstructions(instructions, count);
+	encode(vm, code, instructions, count);
+
+	MS_MEM_FREE_ARR(vm, Instruction, instructions, count);
+}
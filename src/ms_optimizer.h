@@ -0,0 +1,13 @@
+#ifndef MS_OPTIMIZER_H
+#define MS_OPTIMIZER_H
+
+#include "ms_code.h"
+
+// rewrites common instruction sequences of finished code into
+// superinstructions, fixing up jumps and line info along the way.
+// with the optimizing compiler on, it cleans up the code before that,
+// see ms_setOptimizingCompiler. `initialDepth` is how many stack slots
+// are in use when the code starts running
+void ms_optimizeCode(ms_VM *vm, ms_Code *code, int initialDepth);
+
+#endif
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ms_common.h"
+#include "ms_object.h"
+#include "ms_vm.h"
+#include "ms_slab.h"
+
+#define LARGE (-1)
+
+// 80 is ms_ObjFunction. strings carry their characters, so identifiers
+// and short literals land in 40 to 64; the rest covers the first few
+// growths of code, lists and maps
+static const size_t classSizes[MS_SLAB_CLASS_COUNT] = {
+	8, 16, 24, 32, 40, 48, 64, 80, 96, 128, 192, 256, 384, 512,
+};
+
+void ms_initSlabs(ms_SlabAllocator *slabs)
+{
+	slabs->enabled = false;
+	slabs->pages = NULL;
+	slabs->largeCount = slabs->largeBytes = 0;
+
+	for (int i = 0; i < MS_SLAB_CLASS_COUNT; i++)
+	{
+		ms_SlabClass *class = slabs->classes + i;
+		class->blockSize = classSizes[i];
+		class->freeList = NULL;
+		class->bump = class->bumpEnd = NULL;
+		class->pageCount = class->blocksUsed = class->bytesRequested = 0;
+	}
+
+	for (size_t slot = 0, class = 0; slot <= MS_SLAB_MAX_SIZE / 8; slot++)
+	{
+		while (classSizes[class] < slot * 8) class++;
+		slabs->classOf[slot] = (uint8_t)class;
+	}
+
+	MS_ASSERT_REASON(classSizes[slabs->classOf[sizeof(ms_ObjFunction) / 8]] == sizeof(ms_ObjFunction),
+		"functions don't fit their size class exactly");
+}
+
+void ms_freeSlabs(ms_VM *vm)
+{
+	ms_SlabPage *page = vm->slabs.pages;
+	while (page != NULL)
+	{
+		ms_SlabPage *next = page->next;
+		vm->reallocFn(page, MS_SLAB_PAGE_SIZE, 0);
+		page = next;
+	}
+
+	bool enabled = vm->slabs.enabled;
+	ms_initSlabs(&vm->slabs);
+	vm->slabs.enabled = enabled;
+}
+
+static inline int classFor(ms_SlabAllocator *slabs, size_t size)
+{
+	if (size > MS_SLAB_MAX_SIZE) return LARGE;
+	return slabs->classOf[(size + 7) / 8];
+}
+
+// pages start with their link, blocks come right after it
+#define PAGE_HEADER_SIZE ((sizeof(ms_SlabPage) + 15) & ~(size_t)15)
+
+static void *allocateBlock(ms_VM *vm, ms_SlabClass *class)
+{
+	void *block;
+	if (class->freeList != NULL)
+	{
+		block = class->freeList;
+		class->freeList = class->freeList->next;
+	}
+	else
+	{
+		if ((size_t)(class->bumpEnd - class->bump) < class->blockSize)
+		{
+			ms_SlabPage *page = vm->reallocFn(NULL, 0, MS_SLAB_PAGE_SIZE);
+			MS_ASSERT_REASON(page != NULL, "couldn't allocate a slab page");
+			page->next = vm->slabs.pages;
+			vm->slabs.pages = page;
+			class->pageCount++;
+
+			class->bump = (uint8_t*)page + PAGE_HEADER_SIZE;
+			class->bumpEnd = (uint8_t*)page + MS_SLAB_PAGE_SIZE;
+		}
+
+		block = class->bump;
+		class->bump += class->blockSize;
+	}
+
+	class->blocksUsed++;
+	return block;
+}
+
+static inline void freeBlock(ms_SlabClass *class, void *ptr)
+{
+	ms_SlabBlock *block = ptr;
+	block->next = class->freeList;
+	class->freeList = block;
+	class->blocksUsed--;
+}
+
+static void *allocate(ms_VM *vm, size_t size)
+{
+	ms_SlabAllocator *slabs = &vm->slabs;
+	int class = classFor(slabs, size);
+	if (class == LARGE)
+	{
+		slabs->largeCount++;
+		slabs->largeBytes += size;
+		return vm->reallocFn(NULL, 0, size);
+	}
+
+	slabs->classes[class].bytesRequested += size;
+	return allocateBlock(vm, slabs->classes + class);
+}
+
+static void release(ms_VM *vm, void *ptr, size_t size)
+{
+	ms_SlabAllocator *slabs = &vm->slabs;
+	int class = classFor(slabs, size);
+	if (class == LARGE)
+	{
+		slabs->largeCount--;
+		slabs->largeBytes -= size;
+		vm->reallocFn(ptr, size, 0);
+		return;
+	}
+
+	slabs->classes[class].bytesRequested -= size;
+	freeBlock(slabs->classes + class, ptr);
+}
+
+void *ms_slabRealloc(ms_VM *vm, void *ptr, size_t oldSize, size_t newSize)
+{
+	ms_SlabAllocator *slabs = &vm->slabs;
+	if (ptr == NULL || oldSize == 0) return newSize == 0 ? NULL : allocate(vm, newSize);
+
+	if (newSize == 0)
+	{
+		release(vm, ptr, oldSize);
+		return NULL;
+	}
+
+	int oldClass = classFor(slabs, oldSize);
+	int newClass = classFor(slabs, newSize);
+
+	// still fits the same block
+	if (oldClass == newClass && oldClass != LARGE)
+	{
+		slabs->classes[oldClass].bytesRequested += newSize - oldSize;
+		return ptr;
+	}
+
+	if (oldClass == LARGE && newClass == LARGE)
+	{
+		slabs->largeBytes += newSize - oldSize;
+		return vm->reallocFn(ptr, oldSize, newSize);
+	}
+
+	void *res = allocate(vm, newSize);
+	if (res != NULL) memcpy(res, ptr, oldSize < newSize ? oldSize : newSize);
+	release(vm, ptr, oldSize);
+	return res;
+}
+
+void ms_useSlabAllocator(ms_VM *vm, bool enable)
+{
+	MS_ASSERT_REASON(vm->bytesUsed == 0, "the allocator can't change once the VM has allocated memory");
+	vm->slabs.enabled = enable;
+}
+
+size_t ms_getSlabStats(ms_VM *vm, ms_SlabStats *stats, size_t max)
+{
+	size_t count = max < MS_SLAB_CLASS_COUNT ? max : MS_SLAB_CLASS_COUNT;
+	for (size_t i = 0; i < count; i++)
+	{
+		ms_SlabClass *class = vm->slabs.classes + i;
+		size_t blocksPerPage = (MS_SLAB_PAGE_SIZE - PAGE_HEADER_SIZE) / class->blockSize;
+
+		stats[i].blockSize = class->blockSize;
+		stats[i].blocksUsed = class->blocksUsed;
+		stats[i].blocksTotal = class->pageCount * blocksPerPage;
+		stats[i].bytesRequested = class->bytesRequested;
+	}
+	return count;
+}
+
+void ms_printSlabReport(ms_VM *vm)
+{
+	ms_SlabStats stats[MS_SLAB_CLASS_COUNT];
+	size_t count = ms_getSlabStats(vm, stats, MS_SLAB_CLASS_COUNT);
+
+	printf("---- slab allocator (%s) ----\n", vm->slabs.enabled ? "enabled" : "disabled");
+	printf("%6s %8s %8s %9s %9s\n", "class", "used", "total", "occupied", "utilized");
+	for (size_t i = 0; i < count; i++)
+	{
+		ms_SlabStats *s = stats + i;
+		if (s->blocksTotal == 0) continue;
+
+		// occupied: blocks handed out; utilized: how much of those blocks was asked for
+		double occupied = 100.0 * s->blocksUsed / s->blocksTotal;
+		double utilized = s->blocksUsed == 0 ? 0 : 100.0 * s->bytesRequested / (s->blocksUsed * s->blockSize);
+		printf("%6zu %8zu %8zu %8.1f%% %8.1f%%\n",
+			s->blockSize, s->blocksUsed, s->blocksTotal, occupied, utilized);
+	}
+	printf("%6s %8zu %8s %9zu bytes\n", "large", vm->slabs.largeCount, "", vm->slabs.largeBytes);
+}
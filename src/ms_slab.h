@@ -0,0 +1,44 @@
+#ifndef MS_SLAB_H
+#define MS_SLAB_H
+
+#include "ms_common.h"
+#include "miniscript.h"
+
+// small allocations are served from pages of fixed size blocks, one set
+// of pages per size class. anything bigger than MS_SLAB_MAX_SIZE goes
+// straight to the VM's realloc function
+
+#define MS_SLAB_PAGE_SIZE (8 * 1024)
+#define MS_SLAB_MAX_SIZE 512
+#define MS_SLAB_CLASS_COUNT 14
+
+typedef struct ms_SlabBlock {
+	struct ms_SlabBlock *next;
+} ms_SlabBlock;
+
+typedef struct ms_SlabPage {
+	struct ms_SlabPage *next;
+} ms_SlabPage;
+
+typedef struct {
+	size_t blockSize;
+	// freed blocks are reused first, then the rest of the newest page
+	ms_SlabBlock *freeList;
+	uint8_t *bump, *bumpEnd;
+	size_t pageCount, blocksUsed, bytesRequested;
+} ms_SlabClass;
+
+typedef struct {
+	bool enabled;
+	ms_SlabClass classes[MS_SLAB_CLASS_COUNT];
+	// size class of every multiple of 8 bytes up to MS_SLAB_MAX_SIZE
+	uint8_t classOf[MS_SLAB_MAX_SIZE / 8 + 1];
+	ms_SlabPage *pages;
+	size_t largeCount, largeBytes;
+} ms_SlabAllocator;
+
+void ms_initSlabs(ms_SlabAllocator *slabs);
+void ms_freeSlabs(ms_VM *vm);
+void *ms_slabRealloc(ms_VM *vm, void *ptr, size_t oldSize, size_t newSize);
+
+#endif
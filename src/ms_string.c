@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ms_common.h"
+#include "ms_mem.h"
+#include "ms_object.h"
+#include "ms_string.h"
+#include "ms_value.h"
+#include "ms_vm.h"
+
+//// flattening
+
+typedef struct {
+	// NULL for the second half of a repeated piece, which is
+	// copied from the first half once that one's been filled in
+	ms_Object *piece;
+	char *dest;
+	size_t length;
+} FillTask;
+
+// going down the shorter side of every rope and leaving the longer one
+// for later means the piece being filled at least halves with every task
+// left behind, so there can't be more of them than bits in a length
+#define FILL_STACK_SIZE (sizeof(size_t) * 8)
+
+static inline size_t pieceLength(ms_Object *piece)
+{
+	if (piece->type == MS_OBJ_STRING) return ((ms_ObjString*)piece)->length;
+	return ((ms_ObjRope*)piece)->length;
+}
+
+// writes the characters of `root` into `dest`. pieces are placed by
+// position, so they can be filled in any order
+static void fillChars(char *dest, ms_Object *root)
+{
+	FillTask stack[FILL_STACK_SIZE];
+	size_t count = 0;
+	ms_Object *piece = root;
+
+	for (;;)
+	{
+		ms_ObjString *flat = NULL;
+		if (piece->type == MS_OBJ_STRING)
+			flat = (ms_ObjString*)piece;
+		else
+			flat = ((ms_ObjRope*)piece)->flat;
+
+		if (flat != NULL)
+			memcpy(dest, flat->chars, flat->length);
+		else
+		{
+			ms_ObjRope *rope = (ms_ObjRope*)piece;
+			MS_ASSERT_REASON(count < FILL_STACK_SIZE, "rope is too deep to flatten");
+
+			if (rope->left == rope->right)
+			{
+				size_t half = rope->length / 2;
+				stack[count++] = (FillTask){ NULL, dest + half, half };
+				piece = rope->left;
+				continue;
+			}
+
+			size_t leftLength = pieceLength(rope->left);
+			FillTask left = { rope->left, dest, leftLength };
+			FillTask right = { rope->right, dest + leftLength, rope->length - leftLength };
+
+			bool leftFirst = left.length <= right.length;
+			stack[count++] = leftFirst ? right : left;
+			piece = leftFirst ? left.piece : right.piece;
+			dest = leftFirst ? left.dest : right.dest;
+			continue;
+		}
+
+		// done with this piece, pick up whatever was left behind
+		for (;;)
+		{
+			if (count == 0) return;
+
+			FillTask task = stack[--count];
+			if (task.piece != NULL)
+			{
+				piece = task.piece;
+				dest = task.dest;
+				break;
+			}
+
+			memcpy(task.dest, task.dest - task.length, task.length);
+		}
+	}
+}
+
+ms_ObjString *ms_flattenString(ms_VM *vm, ms_Value str)
+{
+	if (MS_IS_STRING(str)) return MS_TO_STRING(str);
+
+	ms_ObjRope *rope = MS_TO_ROPE(str);
+	if (rope->flat != NULL) return rope->flat;
+
+	ms_ObjString *flat = ms_allocateString(vm, rope->length);
+	fillChars(flat->chars, &rope->obj);
+
+	// the pieces aren't needed anymore, let them go
+	rope->flat = flat;
+	rope->left = rope->right = NULL;
+	ms_writeBarrier(vm, &rope->obj, MS_FROM_OBJ(flat));
+	return flat;
+}
+
+void ms_printRope(ms_ObjRope *rope)
+{
+	if (rope->flat != NULL)
+	{
+		printf("%s", rope->flat->chars);
+		return;
+	}
+
+	char *chars = malloc(rope->length + 1);
+	MS_ASSERT_REASON(chars != NULL, "couldn't allocate a buffer to print a rope");
+	fillChars(chars, &rope->obj);
+	fwrite(chars, 1, rope->length, stdout);
+	free(chars);
+}
+
+//// operators
+
+static ms_Value newFlatString(ms_VM *vm, const char *chars, size_t length)
+{
+	ms_ObjString *str = ms_allocateString(vm, length);
+	memcpy(str->chars, chars, length);
+	return MS_FROM_OBJ(str);
+}
+
+ms_Value ms_toString(ms_VM *vm, ms_Value val)
+{
+	if (MS_IS_NULL(val)) return newFlatString(vm, "", 0);
+	if (!MS_IS_NUM(val)) return val;
+
+	char buf[MS_NUMBER_BUFFER_SIZE];
+	int length = ms_formatNumber(buf, sizeof buf, MS_TO_NUM(val));
+	return newFlatString(vm, buf, length);
+}
+
+ms_Value ms_concatStrings(ms_VM *vm, ms_Value a, ms_Value b)
+{
+	size_t lengthA = ms_stringLength(a), lengthB = ms_stringLength(b);
+	if (lengthA == 0) return b;
+	if (lengthB == 0) return a;
+
+	size_t length = lengthA + lengthB;
+	if (length > MS_ROPE_MIN_LENGTH)
+		return MS_FROM_OBJ(ms_newRope(vm, MS_TO_OBJ(a), MS_TO_OBJ(b), length));
+
+	// ropes are always longer than this, so both halves are flat already
+	ms_ObjString *str = ms_allocateString(vm, length);
+	memcpy(str->chars, MS_TO_STRING(a)->chars, lengthA);
+	memcpy(str->chars + lengthA, MS_TO_STRING(b)->chars, lengthB);
+	return MS_FROM_OBJ(str);
+}
+
+ms_Value ms_subtractStrings(ms_VM *vm, ms_Value a, ms_Value b)
+{
+	size_t lengthA = ms_stringLength(a), lengthB = ms_stringLength(b);
+	if (lengthB == 0 || lengthB > lengthA) return a;
+
+	ms_ObjString *strA = ms_flattenString(vm, a);
+	ms_ObjString *strB = ms_flattenString(vm, b);
+	if (memcmp(strA->chars + lengthA - lengthB, strB->chars, lengthB) != 0) return a;
+
+	// strA is still reachable through `a`, even if it was just flattened
+	return newFlatString(vm, strA->chars, lengthA - lengthB);
+}
+
+ms_Value ms_repeatString(ms_VM *vm, ms_Value str, double times)
+{
+	size_t length = ms_stringLength(str);
+	if (times <= 0 || length == 0) return newFlatString(vm, "", 0);
+
+	size_t count = (size_t)times;
+	size_t extra = (size_t)((times - count) * length);
+	if (count == 0 && extra == 0) return newFlatString(vm, "", 0);
+
+	// the intermediate results need to stay reachable while building the next one
+	ms_pushValueIntoVM(vm, MS_NULL_VAL);
+	ms_pushValueIntoVM(vm, str);
+	ms_Value *result = vm->stackTop - 2, *piece = vm->stackTop - 1;
+
+	// by doubling: ropes whose halves are the same piece cost one node,
+	// so this takes a log of `count` nodes, however big the result is
+	for (bool first = true; count > 0; count >>= 1)
+	{
+		if (count & 1)
+		{
+			ms_Value next = first ? *piece : ms_concatStrings(vm, *result, *piece);
+			*result = next;
+			first = false;
+		}
+
+		if (count > 1)
+		{
+			ms_Value next = ms_concatStrings(vm, *piece, *piece);
+			*piece = next;
+		}
+	}
+
+	if (extra > 0)
+	{
+		ms_ObjString *whole = ms_flattenString(vm, str);
+		ms_Value part = newFlatString(vm, whole->chars, extra);
+		*piece = part;
+		ms_Value next = MS_IS_NULL(*result) ? part : ms_concatStrings(vm, *result, part);
+		*result = next;
+	}
+
+	ms_Value res = *result;
+	vm->stackTop -= 2;
+	return res;
+}
+
+ms_Value ms_substring(ms_VM *vm, ms_Value str, size_t start, size_t length)
+{
+	if (start == 0 && length == ms_stringLength(str)) return str;
+
+	// the flattened string stays reachable through the rope
+	ms_ObjString *whole = ms_flattenString(vm, str);
+	return newFlatString(vm, whole->chars + start, length);
+}
+
+bool ms_stringsEqual(ms_VM *vm, ms_Value a, ms_Value b)
+{
+	if (MS_TO_OBJ(a) == MS_TO_OBJ(b)) return true;
+
+	size_t length = ms_stringLength(a);
+	if (length != ms_stringLength(b)) return false;
+
+	// there's only ever one interned string with the same contents
+	if (MS_IS_STRING(a) && MS_IS_STRING(b)
+		&& MS_TO_STRING(a)->isInterned && MS_TO_STRING(b)->isInterned)
+		return false;
+
+	ms_ObjString *strA = ms_flattenString(vm, a);
+	ms_ObjString *strB = ms_flattenString(vm, b);
+	return memcmp(strA->chars, strB->chars, length) == 0;
+}
+
+int ms_compareStrings(ms_VM *vm, ms_Value a, ms_Value b)
+{
+	ms_ObjString *strA = ms_flattenString(vm, a);
+	ms_ObjString *strB = ms_flattenString(vm, b);
+
+	size_t length = strA->length < strB->length ? strA->length : strB->length;
+	int cmp = memcmp(strA->chars, strB->chars, length);
+	if (cmp != 0) return cmp;
+	return (strA->length > strB->length) - (strA->length < strB->length);
+}
@@ -0,0 +1,48 @@
+#ifndef MS_STRING_H
+#define MS_STRING_H
+
+#include "ms_common.h"
+#include "ms_object.h"
+#include "ms_value.h"
+
+// what the string operators build on. `+` and `*` make ropes instead of
+// copying, so that `s = s + x` in a loop doesn't copy s every time around;
+// the characters are put together once they're observed (compared,
+// printed, hashed...), by flattening the rope.
+//
+// everything here that takes a VM may allocate, and so collect: the
+// strings passed in have to be reachable from the VM's stack
+
+// results up to this long are copied right away, a rope isn't worth it
+#define MS_ROPE_MIN_LENGTH 32
+
+#ifndef MS_MAX_STRING_LENGTH
+#define MS_MAX_STRING_LENGTH ((size_t)1 << 30)
+#endif
+
+static inline size_t ms_stringLength(ms_Value str)
+{
+	return MS_IS_STRING(str) ? MS_TO_STRING(str)->length : MS_TO_ROPE(str)->length;
+}
+
+// the characters of `str`, flattening it first if it's a rope
+ms_ObjString *ms_flattenString(ms_VM *vm, ms_Value str);
+// numbers and null as strings, strings are returned as they are
+ms_Value ms_toString(ms_VM *vm, ms_Value val);
+
+ms_Value ms_concatStrings(ms_VM *vm, ms_Value a, ms_Value b);
+// `a` without `b` at its end, or `a` itself if it doesn't end with it
+ms_Value ms_subtractStrings(ms_VM *vm, ms_Value a, ms_Value b);
+// `str` repeated `times` times, fractions repeat part of it
+ms_Value ms_repeatString(ms_VM *vm, ms_Value str, double times);
+// `length` characters of `str` starting from `start`, for indexing and slicing
+ms_Value ms_substring(ms_VM *vm, ms_Value str, size_t start, size_t length);
+
+bool ms_stringsEqual(ms_VM *vm, ms_Value a, ms_Value b);
+// <0, 0 or >0, like strcmp
+int ms_compareStrings(ms_VM *vm, ms_Value a, ms_Value b);
+
+// prints a rope without flattening it, for when there's no VM at hand
+void ms_printRope(ms_ObjRope *rope);
+
+#endif
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -5,11 +6,30 @@
 #include "ms_mem.h"
 #include "ms_value.h"
 
+// same format as the reference implementation: integers as integers,
+// very big or small numbers in scientific notation, everything else
+// with up to 6 decimals
+int ms_formatNumber(char *buf, size_t size, double num)
+{
+	if (num == 0) return snprintf(buf, size, "0");
+	if (fmod(num, 1.0) == 0 && fabs(num) < 1e15) return snprintf(buf, size, "%.0f", num);
+	if (fabs(num) > 1e10 || fabs(num) < 1e-6) return snprintf(buf, size, "%.6E", num);
+
+	int length = snprintf(buf, size, "%.6f", num);
+	while (buf[length - 1] == '0' && buf[length - 2] != '.') buf[--length] = '\0';
+	return length;
+}
+
 void ms_printValue(ms_Value val)
 {
+	char buf[MS_NUMBER_BUFFER_SIZE];
 	switch (MS_VAL_TYPE(val))
 	{
-		case MS_TYPE_NUM:  printf("%g", MS_TO_NUM(val));   break;
+		case MS_TYPE_NUM:
+			ms_formatNumber(buf, sizeof buf, MS_TO_NUM(val));
+			printf("%s", buf);
+			break;
+
 		case MS_TYPE_NULL: printf("null");                 break;
 		case MS_TYPE_OBJ:  ms_printObject(val);            break;
 
@@ -17,8 +37,20 @@ void ms_printValue(ms_Value val)
 	}
 }
 
+// strings are quoted inside lists and maps, like the reference implementation does
+void ms_printNestedValue(ms_Value val)
+{
+	if (MS_IS_ANY_STRING(val)) printf("\"");
+	ms_printValue(val);
+	if (MS_IS_ANY_STRING(val)) printf("\"");
+}
+
 bool ms_valuesEqual(ms_Value a, ms_Value b)
 {
+#ifdef MS_NAN_BOXING
+	if (MS_IS_NUM(a) && MS_IS_NUM(b)) return MS_TO_NUM(a) == MS_TO_NUM(b);
+	return a == b;
+#else
 	if (MS_VAL_TYPE(a) != MS_VAL_TYPE(b)) return false;
 	switch (MS_VAL_TYPE(a))
 	{
@@ -27,6 +59,7 @@ bool ms_valuesEqual(ms_Value a, ms_Value b)
 		case MS_TYPE_OBJ:  return MS_TO_OBJ(a) == MS_TO_OBJ(b);
 		default: MS_UNREACHABLE("ms_valuesEqual"); break;
 	}
+#endif
 }
 
 double ms_getBoolVal(ms_Value val)
@@ -56,6 +89,14 @@ void ms_freeList(ms_VM *vm, ms_List *list)
 	ms_initList(vm, list);
 }
 
+// makes room for `cap` values in total, growing the list only once
+void ms_reserveList(ms_VM *vm, ms_List *list, size_t cap)
+{
+	if (cap <= list->cap) return;
+	list->data = MS_MEM_REALLOC_ARR(vm, ms_Value, list->data, list->cap, cap);
+	list->cap = cap;
+}
+
 size_t ms_addValueToList(ms_VM *vm, ms_List *list, ms_Value val)
 {
 	if (list->count + 1 >= list->cap)
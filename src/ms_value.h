@@ -1,6 +1,8 @@
 #ifndef MS_VALUE_H
 #define MS_VALUE_H
 
+#include <math.h>
+
 #include "miniscript.h"
 #include "ms_common.h"
 
@@ -13,6 +15,52 @@ typedef enum {
 	MS_TYPE_OBJ,
 } ms_ValueType;
 
+#ifdef MS_NAN_BOXING
+
+#include <string.h>
+
+// every value is a single 64-bit word. numbers are stored as-is,
+// everything else lives inside the payload of a quiet NaN:
+//  - null is the quiet NaN with a tag of 1
+//  - objects have the sign bit set and the pointer in the low 48 bits
+typedef uint64_t ms_Value;
+
+#define MS__SIGN_BIT ((uint64_t)0x8000000000000000)
+#define MS__QNAN     ((uint64_t)0x7ffc000000000000)
+#define MS__TAG_NULL ((uint64_t)1)
+
+static inline double ms_valueToNum(ms_Value val)
+{
+	double num;
+	memcpy(&num, &val, sizeof val);
+	return num;
+}
+
+static inline ms_Value ms_numToValue(double num)
+{
+	ms_Value val;
+	memcpy(&val, &num, sizeof num);
+	return val;
+}
+
+#define MS_TO_NUM(val) ms_valueToNum(val)
+#define MS_FROM_NUM(val) ms_numToValue(val)
+#define MS_IS_NUM(val) (((val) & MS__QNAN) != MS__QNAN)
+
+#define MS_NULL_VAL ((ms_Value)(MS__QNAN | MS__TAG_NULL))
+#define MS_IS_NULL(val) ((val) == MS_NULL_VAL)
+
+static inline ms_ValueType ms_getValueType(ms_Value val)
+{
+	if (MS_IS_NUM(val)) return MS_TYPE_NUM;
+	if (MS_IS_NULL(val)) return MS_TYPE_NULL;
+	return MS_TYPE_OBJ;
+}
+
+#define MS_VAL_TYPE(val) ms_getValueType(val)
+
+#else
+
 typedef struct {
 	ms_ValueType type;
 	union {
@@ -21,19 +69,34 @@ typedef struct {
 	} as;
 } ms_Value;
 
-#define MS_VAL_TYPE(val) val.type
+#define MS_VAL_TYPE(val) (val).type
 
-#define MS_TO_NUM(val) val.as.number
+#define MS_TO_NUM(val) (val).as.number
 #define MS_FROM_NUM(val) ((ms_Value){ .type = MS_TYPE_NUM, .as.number = val })
-#define MS_IS_NUM(val) (val.type == MS_TYPE_NUM)
+#define MS_IS_NUM(val) ((val).type == MS_TYPE_NUM)
 
 #define MS_NULL_VAL ((ms_Value){ .type = MS_TYPE_NULL })
-#define MS_IS_NULL(val) (val.type == MS_TYPE_NULL)
+#define MS_IS_NULL(val) ((val).type == MS_TYPE_NULL)
 
+#endif // MS_NAN_BOXING
+
+// big enough for any number ms_formatNumber writes
+#define MS_NUMBER_BUFFER_SIZE 32
+
+int ms_formatNumber(char *buf, size_t size, double num);
 void ms_printValue(ms_Value val);
+// how values are printed inside containers
+void ms_printNestedValue(ms_Value val);
 bool ms_valuesEqual(ms_Value a, ms_Value b);
 double ms_getBoolVal(ms_Value val);
 
+// `and`, `or`, `not` and negation clamp their operands with this first.
+// shared with the compiler, so that what it folds matches what the VM does
+static inline double ms_absClamp01(double v)
+{
+	return fabs(v < 0 ? 0 : (v > 1 ? 1 : v));
+}
+
 typedef struct {
 	size_t count, cap;
 	ms_Value *data;
@@ -41,6 +104,7 @@ typedef struct {
 
 void ms_initList(ms_VM *vm, ms_List *list);
 void ms_freeList(ms_VM *vm, ms_List *list);
+void ms_reserveList(ms_VM *vm, ms_List *list, size_t cap);
 size_t ms_addValueToList(ms_VM *vm, ms_List *list, ms_Value val);
 int ms_findValueInList(ms_List *list, ms_Value val);
 ms_Value *ms_getValueFromList(ms_List *list, size_t index);
@@ -12,8 +12,13 @@
 #include "ms_compiler.h"
 #include "ms_mem.h"
 #include "ms_code.h"
+#include "ms_bytecode.h"
+#include "ms_hash.h"
+#include "ms_list.h"
+#include "ms_mapobject.h"
+#include "ms_string.h"
 
-#ifdef MS_DEBUG_EXECUTION
+#if defined(MS_DEBUG_EXECUTION) || defined(MS_PROFILE_OPCODES)
 #include "ms_debug.h"
 #endif
 
@@ -42,10 +47,32 @@ ms_VM *ms_newVM(ms_ReallocFn reallocFn)
 
 	vm->reallocFn = reallocFn;
 	vm->bytesUsed = 0;
+	ms_initSlabs(&vm->slabs);
 	vm->objects = NULL;
-	vm->stackTop = vm->stack;
+	vm->minGCThreshold = vm->nextGC = MS_GC_DEFAULT_THRESHOLD;
+	vm->gcGrowthFactor = MS_GC_DEFAULT_GROWTH;
+	memset(&vm->gcStats, 0, sizeof vm->gcStats);
+	vm->grayStack = NULL;
+	vm->grayCount = vm->grayCap = 0;
+	vm->compiler = NULL;
+	vm->optimizeCode = true;
+	vm->nursery = vm->nurseryTop = vm->nurseryEnd = NULL;
+	vm->nurseryFull = vm->gcPaused = false;
+	vm->remembered = NULL;
+	vm->rememberedCount = vm->rememberedCap = 0;
+	vm->mappings = NULL;
+	// both stacks are allocated on first use, so that the VM is
+	// nothing but the struct itself until it runs something
+	vm->stack = vm->stackTop = NULL;
+	vm->stackCap = 0;
+	vm->frames = NULL;
+	vm->frameCount = vm->frameCap = 0;
+	vm->maxFrames = MS_DEFAULT_MAX_FRAMES;
+	vm->hashSeed = ms_newHashSeed(vm);
 	ms_initMap(vm, &vm->strings);
+	ms_initMap(vm, &vm->globalNames);
 	ms_initMap(vm, &vm->globals);
+	ms_initList(vm, &vm->globalValues);
 
 #ifdef MS_DEBUG_MEM_ALLOC
 	fprintf(stderr, "vm: all set up and ready to go!\n");
@@ -64,19 +91,105 @@ void ms_freeVM(ms_VM *vm)
 	fprintf(stderr, "vm: all objects freed\n");
 #endif
 	vm->objects = NULL;
+	// only once nothing can point into them anymore
+	ms_freeMappings(vm);
+	vm->reallocFn(vm->grayStack, vm->grayCap * sizeof(ms_Object*), 0);
+	vm->reallocFn(vm->remembered, vm->rememberedCap * sizeof(ms_Object*), 0);
 	ms_freeMap(vm, &vm->strings);
+	ms_freeMap(vm, &vm->globalNames);
 	ms_freeMap(vm, &vm->globals);
+	ms_freeList(vm, &vm->globalValues);
+	MS_MEM_FREE_ARR(vm, ms_Value, vm->stack, vm->stackCap);
+	MS_MEM_FREE_ARR(vm, CallFrame, vm->frames, vm->frameCap);
 
 	MS_ASSERT_REASON(vm->bytesUsed == 0, "program leaked memory!!");
+	ms_freeSlabs(vm);
 #ifdef MS_DEBUG_MEM_ALLOC
 	fprintf(stderr, "vm: successfully freed everything, will free itself now. goodbye!");
 #endif
 	vm->reallocFn(vm, sizeof *vm, 0);
 }
 
+int ms_findGlobal(ms_VM *vm, ms_ObjString *name)
+{
+	ms_Value slot;
+	if (!ms_getMapKey(vm, &vm->globalNames, MS_FROM_OBJ(name), &slot)) return -1;
+	return (int)MS_TO_NUM(slot);
+}
+
+int ms_declareGlobal(ms_VM *vm, ms_ObjString *name)
+{
+	int slot = ms_findGlobal(vm, name);
+	if (slot != -1) return slot;
+
+	// the name might only be referenced from here until it's in the table
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(name));
+	slot = ms_addValueToList(vm, &vm->globalValues, MS_NULL_VAL);
+	ms_setMapKey(vm, &vm->globalNames, MS_FROM_OBJ(name), MS_FROM_NUM(slot));
+	ms_popValueFromVM(vm);
+	return slot;
+}
+
+ms_Map *ms_getGlobalsMap(ms_VM *vm)
+{
+	for (size_t i = 0; i < vm->globalNames.cap; i++)
+	{
+		ms_MapEntry *entry = vm->globalNames.entries + i;
+		if (!ms_isMapSlotUsed(&vm->globalNames, i)) continue;
+
+		size_t slot = MS_TO_NUM(entry->value);
+		ms_setMapKey(vm, &vm->globals, entry->key, vm->globalValues.data[slot]);
+	}
+
+	return &vm->globals;
+}
+
+void ms_setMaxCallDepth(ms_VM *vm, int depth)
+{
+	MS_ASSERT_REASON(depth > 0, "the script itself needs a frame");
+	vm->maxFrames = depth;
+}
+
+void ms_setOptimizingCompiler(ms_VM *vm, bool enable)
+{
+	vm->optimizeCode = enable;
+}
+
+void ms_setHashSeed(ms_VM *vm, uint64_t seed)
+{
+	MS_ASSERT_REASON(vm->strings.count == 0, "strings were already hashed with the old seed");
+	vm->hashSeed = ms_prepareHashSeed(seed);
+}
+
+// makes room for at least `needed` values, moving the stack if it has to.
+// everything pointing into it is relocated, except for the copies
+// interpret() keeps in locals, which it reloads after every call
+bool ms_ensureStack(ms_VM *vm, size_t needed)
+{
+	if (needed <= vm->stackCap) return true;
+	if (needed > MS_MAX_STACK_SIZE(vm->maxFrames)) return false;
+
+	size_t cap = vm->stackCap < MS_INITIAL_STACK_SIZE ? MS_INITIAL_STACK_SIZE : vm->stackCap;
+	while (cap < needed) cap *= 2;
+
+	ms_Value *oldStack = vm->stack;
+	// the values being moved are the roots, nothing may be collected meanwhile
+	bool wasPaused = vm->gcPaused;
+	vm->gcPaused = true;
+	vm->stack = MS_MEM_REALLOC_ARR(vm, ms_Value, vm->stack, vm->stackCap, cap);
+	vm->gcPaused = wasPaused;
+
+	vm->stackCap = cap;
+	vm->stackTop = vm->stack + (vm->stackTop - oldStack);
+	for (int i = 0; i < vm->frameCount; i++)
+		vm->frames[i].slots = vm->stack + (vm->frames[i].slots - oldStack);
+	return true;
+}
+
 void ms_pushValueIntoVM(ms_VM *vm, ms_Value val)
 {
-	MS_ASSERT_REASON(vm->stackTop - vm->stack < MS_MAX_STACK_SIZE, "stack overflow");
+	if (MS_UNLIKELY(!ms_ensureStack(vm, (size_t)(vm->stackTop - vm->stack) + 1)))
+		MS_ASSERT_REASON(false, "stack overflow");
 	*vm->stackTop++ = val;
 }
 
@@ -96,268 +209,941 @@ void ms_pushNullIntoVM(ms_VM *vm) { ms_pushValueIntoVM(vm, MS_NULL_VAL); }
 void ms_pushTrueIntoVM(ms_VM *vm) { ms_pushValueIntoVM(vm, MS_FROM_NUM(1)); }
 void ms_pushFalseIntoVM(ms_VM *vm) { ms_pushValueIntoVM(vm, MS_FROM_NUM(0)); }
 
-ms_InterpretResult ms_runtimeError(ms_VM *vm, const char *err)
+static MS_COLD ms_InterpretResult runtimeError(ms_VM *vm, const char *err)
 {
-	MS_UNUSED(vm);
+	if (vm->frameCount == 0)
+	{
+		fprintf(stderr, "Runtime Error: %s\n", err);
+		return MS_INTERPRET_RUNTIME_ERROR;
+	}
+
 	CallFrame *frame = &vm->frames[vm->frameCount-1];
 	size_t instruction = frame->ip - frame->function->code.data - 1;
-	int line = frame->function->code.lines[instruction];
+	int line = ms_getCodeLine(&frame->function->code, instruction);
 	fprintf(stderr, "Runtime Error: %s [line %i]\n", err, line);
 	return MS_INTERPRET_RUNTIME_ERROR;
 }
 
-static void call(ms_VM *vm, ms_ObjFunction *func, int argCount)
+static MS_COLD ms_InterpretResult operandError(ms_VM *vm, ms_Value a, ms_Value b)
 {
-	if (argCount > func->arity)
+	if (MS_VAL_TYPE(a) != MS_VAL_TYPE(b))
+		return runtimeError(vm, "Both types must be equal.");
+	return runtimeError(vm, "Can't currently operate on non-numbers.");
+}
+
+// `+ - * /` on anything but two numbers. the operands are still on top of
+// the stack, so they stay reachable while the result is built, and are
+// replaced with it. numbers and null only turn into strings next to one,
+// and lists can only be added to other lists
+static MS_COLD bool binaryOpOnObjects(ms_VM *vm, ms_Opcode op)
+{
+	ms_Value a = vm->stackTop[-2], b = vm->stackTop[-1];
+	bool addable = MS_IS_NUM(b) || MS_IS_NULL(b) || MS_IS_ANY_STRING(b);
+
+	ms_Value result;
+	if (op == MS_OP_ADD && MS_IS_LIST(a) && MS_IS_LIST(b))
+		result = MS_FROM_OBJ(ms_concatLists(vm, MS_TO_LIST(a), MS_TO_LIST(b)));
+	else if (MS_IS_ANY_STRING(a) && addable && (op == MS_OP_ADD || op == MS_OP_SUBTRACT))
 	{
-		ms_runtimeError(vm, "Too many arguments");
-		return;
+		b = vm->stackTop[-1] = ms_toString(vm, b);
+		if (op == MS_OP_SUBTRACT)
+			result = ms_subtractStrings(vm, a, b);
+		else if (ms_stringLength(a) + ms_stringLength(b) > MS_MAX_STRING_LENGTH)
+			goto tooLong;
+		else
+			result = ms_concatStrings(vm, a, b);
 	}
-
-	if (vm->frameCount == MS_MAX_FRAMES_AMT)
+	else if (MS_IS_ANY_STRING(a) && MS_IS_NUM(b) && (op == MS_OP_MULTIPLY || op == MS_OP_DIVIDE))
 	{
-		ms_runtimeError(vm, "Stack overflow");
-		return;
+		double times = op == MS_OP_MULTIPLY ? MS_TO_NUM(b) : 1 / MS_TO_NUM(b);
+		if (times * ms_stringLength(a) > MS_MAX_STRING_LENGTH) goto tooLong;
+		result = ms_repeatString(vm, a, times);
+	}
+	else if (op == MS_OP_ADD && MS_IS_ANY_STRING(b) && (MS_IS_NUM(a) || MS_IS_NULL(a)))
+	{
+		a = vm->stackTop[-2] = ms_toString(vm, a);
+		if (ms_stringLength(a) + ms_stringLength(b) > MS_MAX_STRING_LENGTH) goto tooLong;
+		result = ms_concatStrings(vm, a, b);
+	}
+	else
+	{
+		operandError(vm, a, b);
+		return false;
 	}
 
-	CallFrame *frame = &vm->frames[vm->frameCount++];
-	frame->function = func;
-	frame->ip = func->code.data;
-	frame->slots = vm->stackTop - argCount - 1;
+	vm->stackTop -= 2;
+	*vm->stackTop++ = result;
+	return true;
+
+tooLong:
+	runtimeError(vm, "String exceeds the maximum length");
+	return false;
+}
+
+static MS_COLD ms_InterpretResult indexError(ms_VM *vm, const char *kind, ms_Value index)
+{
+	char num[MS_NUMBER_BUFFER_SIZE], message[64 + MS_NUMBER_BUFFER_SIZE];
+	ms_formatNumber(num, sizeof num, MS_TO_NUM(index));
+	snprintf(message, sizeof message, "Index Error (%s index %s out of range)", kind, num);
+	return runtimeError(vm, message);
 }
 
-static void callValue(ms_VM *vm, ms_Value callee, int argCount)
+static MS_COLD ms_InterpretResult keyError(ms_VM *vm, ms_Value key)
 {
-	if (MS_IS_OBJ(callee))
+	char message[96];
+	if (MS_IS_NUM(key))
+	{
+		char num[MS_NUMBER_BUFFER_SIZE];
+		ms_formatNumber(num, sizeof num, MS_TO_NUM(key));
+		snprintf(message, sizeof message, "Key Not Found: '%s' not found in map", num);
+	}
+	else if (MS_IS_ANY_STRING(key))
 	{
-		switch (MS_OBJ_TYPE(callee))
+		ms_ObjString *str = ms_flattenString(vm, key);
+		int length = str->length > 40 ? 40 : (int)str->length;
+		snprintf(message, sizeof message, "Key Not Found: '%.*s' not found in map", length, str->chars);
+	}
+	else
+		snprintf(message, sizeof message, "Key Not Found: key not found in map");
+	return runtimeError(vm, message);
+}
+
+// whatever GET_INDEX can't do by itself: strings, maps, and errors.
+// like binaryOpOnObjects, the operands are replaced with the result
+static MS_COLD bool getIndex(ms_VM *vm)
+{
+	ms_Value container = vm->stackTop[-2], index = vm->stackTop[-1];
+	if (MS_IS_MAP(container))
+	{
+		ms_Value value;
+		if (!ms_getMapItem(vm, MS_TO_MAP(container), index, &value))
 		{
-			case MS_OBJ_FUNCTION:
-				call(vm, MS_TO_FUNCTION(callee), argCount);
-				break;
+			keyError(vm, index);
+			return false;
+		}
+
+		vm->stackTop -= 2;
+		*vm->stackTop++ = value;
+		return true;
+	}
+
+	if (!MS_IS_LIST(container) && !MS_IS_ANY_STRING(container))
+	{
+		runtimeError(vm, "Can only index into lists, maps and strings");
+		return false;
+	}
+
+	if (!MS_IS_NUM(index))
+	{
+		runtimeError(vm, "Index Error (index must be a number)");
+		return false;
+	}
+
+	size_t pos;
+	ms_Value result;
+	if (MS_IS_LIST(container))
+	{
+		ms_ObjList *list = MS_TO_LIST(container);
+		if (!ms_resolveIndex(MS_TO_NUM(index), list->count, &pos)) goto outOfRange;
+		result = ms_getListItem(list, pos);
+	}
+	else
+	{
+		if (!ms_resolveIndex(MS_TO_NUM(index), ms_stringLength(container), &pos)) goto outOfRange;
+		result = ms_substring(vm, container, pos, 1);
+	}
+
+	vm->stackTop -= 2;
+	*vm->stackTop++ = result;
+	return true;
+
+outOfRange:
+	indexError(vm, MS_IS_LIST(container) ? "list" : "string", index);
+	return false;
+}
+
+// same as getIndex, for SET_INDEX. the value being assigned is on top
+static MS_COLD bool setIndex(ms_VM *vm)
+{
+	ms_Value container = vm->stackTop[-3], index = vm->stackTop[-2];
+	if (MS_IS_ANY_STRING(container))
+	{
+		runtimeError(vm, "Strings can't be changed, only replaced");
+		return false;
+	}
+
+	if (MS_IS_MAP(container))
+	{
+		ms_setMapItem(vm, MS_TO_MAP(container), index, vm->stackTop[-1]);
+		vm->stackTop -= 3;
+		return true;
+	}
+
+	if (!MS_IS_LIST(container))
+	{
+		runtimeError(vm, "Can only index into lists, maps and strings");
+		return false;
+	}
+
+	if (!MS_IS_NUM(index))
+	{
+		runtimeError(vm, "Index Error (index must be a number)");
+		return false;
+	}
+
+	size_t pos;
+	ms_ObjList *list = MS_TO_LIST(container);
+	if (!ms_resolveIndex(MS_TO_NUM(index), list->count, &pos))
+	{
+		indexError(vm, "list", index);
+		return false;
+	}
+
+	ms_setListItem(vm, list, pos, vm->stackTop[-1]);
+	vm->stackTop -= 3;
+	return true;
+}
+
+// `a[from:to]` on a list or a string, with the three operands on the stack
+static bool sliceValue(ms_VM *vm)
+{
+	ms_Value container = vm->stackTop[-3], from = vm->stackTop[-2], to = vm->stackTop[-1];
+	if ((!MS_IS_NUM(from) && !MS_IS_NULL(from)) || (!MS_IS_NUM(to) && !MS_IS_NULL(to)))
+	{
+		runtimeError(vm, "Slice bounds must be numbers");
+		return false;
+	}
+
+	size_t start, end;
+	ms_Value result;
+	if (MS_IS_LIST(container))
+	{
+		ms_ObjList *list = MS_TO_LIST(container);
+		ms_resolveSlice(from, to, list->count, &start, &end);
+		result = MS_FROM_OBJ(ms_sliceList(vm, list, start, end));
+	}
+	else if (MS_IS_ANY_STRING(container))
+	{
+		ms_resolveSlice(from, to, ms_stringLength(container), &start, &end);
+		result = ms_substring(vm, container, start, end - start);
+	}
+	else
+	{
+		runtimeError(vm, "Can only slice lists and strings");
+		return false;
+	}
 
-			default:
-				MS_UNREACHABLE("callValue");
-				break;
+	vm->stackTop -= 3;
+	*vm->stackTop++ = result;
+	return true;
+}
+
+// FOR_ITER on anything but a list. pushes the next item and moves the
+// position along, which is the value below it. 0 when there are no more
+// items, -1 on an error
+static int iterate(ms_VM *vm)
+{
+	ms_Value sequence = vm->stackTop[-2];
+	size_t pos = (size_t)MS_TO_NUM(vm->stackTop[-1]);
+
+	ms_Value item;
+	if (MS_IS_MAP(sequence))
+	{
+		ms_ObjMap *map = MS_TO_MAP(sequence);
+		if (pos >= map->count) return 0;
+		item = MS_FROM_OBJ(ms_mapItemPair(vm, map, pos));
+	}
+	else if (MS_IS_ANY_STRING(sequence))
+	{
+		if (pos >= ms_stringLength(sequence)) return 0;
+		item = ms_substring(vm, sequence, pos, 1);
+	}
+	else
+	{
+		runtimeError(vm, "Can only iterate over lists, maps and strings");
+		return -1;
+	}
+
+	vm->stackTop[-1] = MS_FROM_NUM(pos + 1);
+	*vm->stackTop++ = item;
+	return 1;
+}
+
+static MS_COLD bool growFrames(ms_VM *vm)
+{
+	if (vm->frameCount >= vm->maxFrames) return false;
+
+	int cap = vm->frameCap < MS_INITIAL_FRAMES ? MS_INITIAL_FRAMES : vm->frameCap * 2;
+	if (cap > vm->maxFrames) cap = vm->maxFrames;
+
+	bool wasPaused = vm->gcPaused;
+	vm->gcPaused = true;
+	vm->frames = MS_MEM_REALLOC_ARR(vm, CallFrame, vm->frames, vm->frameCap, cap);
+	vm->gcPaused = wasPaused;
+
+	vm->frameCap = cap;
+	return true;
+}
+
+static bool call(ms_VM *vm, ms_ObjFunction *func, int argCount)
+{
+	if (argCount > func->arity)
+	{
+		runtimeError(vm, "Too many arguments");
+		return false;
+	}
+
+	size_t base = vm->stackTop - argCount - 1 - vm->stack;
+	size_t needed = base + func->maxStack + MS_STACK_RESERVE;
+	if (MS_UNLIKELY(vm->frameCount == vm->frameCap || needed > vm->stackCap))
+	{
+		if ((vm->frameCount == vm->frameCap && !growFrames(vm)) || !ms_ensureStack(vm, needed))
+		{
+			runtimeError(vm, "Stack overflow");
+			return false;
 		}
 	}
 
-	return;
+	// missing arguments are null
+	for (; argCount < func->arity; argCount++) *vm->stackTop++ = MS_NULL_VAL;
+
+	ms_Value *slots = vm->stack + base;
+	CallFrame *frame = &vm->frames[vm->frameCount++];
+	frame->function = func;
+	frame->ip = func->code.data;
+	frame->slots = slots;
+	return true;
 }
 
-static ms_InterpretResult interpret(register ms_VM* vm, register CallFrame *frame)
+#ifdef MS_COMPUTED_GOTO
+// labels as values are a GNU extension, which -pedantic rightfully complains about
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+static ms_InterpretResult interpret(ms_VM* vm)
 {
+	// the state of the current frame is cached in locals so that
+	// the compiler can keep it in registers, and is only written
+	// back to the VM when something outside of this function needs it
+	CallFrame *frame;
+	register uint8_t *ip;
+	register ms_Value *sp = vm->stackTop;
+	register ms_Value *slots;
+	register ms_Value *constants;
+	// only the compiler declares new globals, so this can't move while running
+	register ms_Value *globals = vm->globalValues.data;
 	register ms_Value temp, temp2;
 
-#define NEXT_BYTE() (*frame->ip++)
-#define NEXT_SHORT() (frame->ip += 2, (((uint16_t)frame->ip[-2]) << 8 | (uint16_t)frame->ip[-1]))
-#define NEXT_CONST() (frame->function->code.constants.data[NEXT_BYTE()])
-#define BINARY_OP(vm, op) do {                               \
-    temp2 = ms_popValueFromVM(vm);                           \
-    temp = ms_popValueFromVM(vm);                            \
-                                                             \
-    if (MS_VAL_TYPE(temp) != MS_VAL_TYPE(temp2))             \
-      return ms_runtimeError(vm, "Types must be the same."); \
-                                                             \
-    MS_ASSERT(MS_IS_NUM(temp)); /* TODO */                   \
-                                                             \
-    temp = MS_FROM_NUM(MS_TO_NUM(temp) op MS_TO_NUM(temp2)); \
-    ms_pushValueIntoVM(vm, temp);                            \
+#define STORE_FRAME() do { \
+    frame->ip = ip;        \
+    vm->stackTop = sp;     \
   } while(0)
 
-#define COMPARISON_OP(vm, op) do {                                              \
-    temp2 = ms_popValueFromVM(vm);                                              \
-    temp = ms_popValueFromVM(vm);                                               \
-                                                                                \
-    if (MS_VAL_TYPE(temp) != MS_VAL_TYPE(temp2))                                \
-      return ms_runtimeError(vm, "Types must be equal.");                       \
-                                                                                \
-    if (MS_VAL_TYPE(temp) == MS_TYPE_OBJ && MS_OBJ_TYPE(temp) == MS_OBJ_STRING) \
-      ms_pushValueIntoVM(vm, MS_FROM_NUM(                                       \
-        (strcmp(MS_TO_CSTRING(temp), MS_TO_CSTRING(temp2)) op 0)                \
-      ));                                                                       \
-    else                                                                        \
-      ms_pushValueIntoVM(vm, MS_FROM_NUM(MS_TO_NUM(temp) op MS_TO_NUM(temp2))); \
+#define LOAD_FRAME() do {                                    \
+    frame = &vm->frames[vm->frameCount-1];                   \
+    ip = frame->ip;                                          \
+    slots = frame->slots;                                    \
+    constants = frame->function->code.constants.data;        \
   } while(0)
 
-#ifdef MS_DEBUG_EXECUTION
-	fprintf(stderr, "vm: will start executing code...\n");
+#define RUNTIME_ERROR(...) do {             \
+    STORE_FRAME();                          \
+    return runtimeError(vm, __VA_ARGS__);   \
+  } while(0)
+
+// minor collections move young objects, so they wait for a point where
+// every reference to one is in a root. backwards jumps are frequent
+// enough for that, and the only thing a minor collection touches in
+// the cached state are the values in the stack, which stay in place
+#define SAFEPOINT() do {                  \
+    if (MS_UNLIKELY(vm->nurseryFull))     \
+    {                                     \
+      STORE_FRAME();                      \
+      ms_collectYoung(vm);                \
+    }                                     \
+  } while(0)
+
+#define PUSH(val) (*sp++ = (val))
+#define POP() (*--sp)
+#define PEEK(distance) (sp[-1 - (distance)])
+
+#define NEXT_BYTE() (*ip++)
+#define NEXT_SHORT() (ip += 2, (((uint16_t)ip[-2]) << 8 | (uint16_t)ip[-1]))
+#define NEXT_LONG() (ip += 3, (size_t)ip[-3] << 16 | (size_t)ip[-2] << 8 | (size_t)ip[-1])
+#define NEXT_CONST() (constants[NEXT_BYTE()])
+
+// calling anything but a function leaves it be, so only functions need to leave the loop
+#define INVOKE(callee, argCount) do {                       \
+    if (MS_IS_FUNCTION(callee))                             \
+    {                                                       \
+      STORE_FRAME();                                        \
+      if (!call(vm, MS_TO_FUNCTION(callee), argCount))      \
+        return MS_INTERPRET_RUNTIME_ERROR;                  \
+      sp = vm->stackTop;                                    \
+      LOAD_FRAME();                                         \
+    }                                                       \
+    else if ((argCount) > 0)                                \
+      RUNTIME_ERROR("Too many arguments");                  \
+  } while(0)
+
+// lists are stepped through right here, anything else goes through iterate()
+#define FOR_ITER(offset) do {                               \
+    temp = PEEK(1);                                         \
+    size_t pos = (size_t)MS_TO_NUM(PEEK(0));                \
+                                                            \
+    if (MS_LIKELY(MS_IS_LIST(temp)))                        \
+    {                                                       \
+      ms_ObjList *list = MS_TO_LIST(temp);                  \
+      if (pos < list->count)                                \
+      {                                                     \
+        sp[-1] = MS_FROM_NUM(pos + 1);                      \
+        PUSH(ms_getListItem(list, pos));                    \
+      }                                                     \
+      else ip += (offset);                                  \
+    }                                                       \
+    else                                                    \
+    {                                                       \
+      STORE_FRAME();                                        \
+      int pushed = iterate(vm);                             \
+      if (pushed < 0) return MS_INTERPRET_RUNTIME_ERROR;    \
+      if (pushed == 0) ip += (offset);                      \
+      sp = vm->stackTop;                                    \
+    }                                                       \
+  } while(0)
+
+// the instruction being run, whose opcode is `length` bytes behind ip,
+// found numbers where the generic one has to check for anything.
+// it's rewritten into `op`, which only handles numbers
+#ifndef MS_NO_QUICKENING
+#define QUICKEN(length, op) (ip[-(length)] = (op))
+#else
+#define QUICKEN(length, op) ((void)0)
+#endif
+
+// a quickened instruction got something else: it's turned back into
+// the generic one, and run again as that. it's quickened again if it
+// finds numbers once more
+#define DEQUICKEN(length, op) do { \
+    ip -= (length);                \
+    *ip = (op);                    \
+    VM_NEXT();                     \
+  } while(0)
+
+// anything that isn't two numbers leaves the loop, with the operands
+// still on the stack since strings may need to allocate
+#define BINARY_OP(op, opcode, length, quick) do {                   \
+    temp2 = PEEK(0);                                                \
+    temp = PEEK(1);                                                 \
+                                                                    \
+    if (MS_LIKELY(MS_IS_NUM(temp) && MS_IS_NUM(temp2)))             \
+    {                                                               \
+      QUICKEN(length, quick);                                       \
+      sp--;                                                         \
+      sp[-1] = MS_FROM_NUM(MS_TO_NUM(temp) op MS_TO_NUM(temp2));    \
+    }                                                               \
+    else                                                            \
+    {                                                               \
+      STORE_FRAME();                                                \
+      if (!binaryOpOnObjects(vm, opcode))                           \
+        return MS_INTERPRET_RUNTIME_ERROR;                          \
+      sp = vm->stackTop;                                            \
+    }                                                               \
+  } while(0)
+
+// the quickened forms of the above and below, all of them take two numbers
+#define NUMBER_OP(op, generic) do {                                \
+    temp2 = PEEK(0);                                               \
+    temp = PEEK(1);                                                \
+    if (MS_UNLIKELY(!MS_IS_NUM(temp) || !MS_IS_NUM(temp2)))        \
+      DEQUICKEN(1, generic);                                       \
+                                                                   \
+    sp--;                                                          \
+    sp[-1] = MS_FROM_NUM(MS_TO_NUM(temp) op MS_TO_NUM(temp2));     \
+  } while(0)
+
+// strings that aren't interned have to be compared by their contents
+#define EQUALITY_OP(equal, quick) do {                                   \
+    temp2 = PEEK(0);                                                     \
+    temp = PEEK(1);                                                      \
+                                                                         \
+    bool result;                                                         \
+    if (MS_UNLIKELY(MS_IS_ANY_STRING(temp) && MS_IS_ANY_STRING(temp2)))  \
+    {                                                                    \
+      STORE_FRAME();                                                     \
+      result = ms_stringsEqual(vm, temp, temp2);                         \
+      sp = vm->stackTop;                                                 \
+    }                                                                    \
+    else                                                                 \
+    {                                                                    \
+      if (MS_IS_NUM(temp) && MS_IS_NUM(temp2)) QUICKEN(1, quick);        \
+      result = ms_valuesEqual(temp, temp2);                              \
+    }                                                                    \
+                                                                         \
+    sp -= 2;                                                             \
+    PUSH(MS_FROM_NUM(result == (equal)));                                \
+  } while(0)
+
+// comparing strings may flatten them, which allocates
+#define STRING_COMPARISON(result, a, b) do { \
+    STORE_FRAME();                           \
+    result = ms_compareStrings(vm, a, b);    \
+    sp = vm->stackTop;                       \
+  } while(0)
+
+#define COMPARISON_OP(op, quick) do {                           \
+    temp2 = PEEK(0);                                            \
+    temp = PEEK(1);                                             \
+                                                                \
+    bool result;                                                \
+    if (MS_LIKELY(MS_IS_NUM(temp) && MS_IS_NUM(temp2)))         \
+    {                                                           \
+      QUICKEN(1, quick);                                        \
+      result = MS_TO_NUM(temp) op MS_TO_NUM(temp2);             \
+    }                                                           \
+    else if (MS_IS_ANY_STRING(temp) && MS_IS_ANY_STRING(temp2)) \
+    {                                                           \
+      int cmp;                                                  \
+      STRING_COMPARISON(cmp, temp, temp2);                      \
+      result = cmp op 0;                                        \
+    }                                                           \
+    else                                                        \
+      RUNTIME_ERROR("Types must be equal.");                    \
+                                                                \
+    sp -= 2;                                                    \
+    PUSH(MS_FROM_NUM(result));                                  \
+  } while(0)
+
+#ifdef MS_PROFILE_OPCODES
+	uint8_t previousOp = MS_OP__END;
+#define PROFILE_INSTRUCTION() do {                          \
+    if (previousOp != MS_OP__END)                           \
+      ms_opcodePairCounts[previousOp][*ip]++;               \
+    previousOp = *ip;                                       \
+  } while(0)
+#else
+#define PROFILE_INSTRUCTION() do {} while(0)
 #endif
 
-	for (;;)
-	{
 #ifdef MS_DEBUG_EXECUTION
-		printf("stack state: ");
-		for (ms_Value *i = vm->stack; i < vm->stackTop; i++)
-		{
-			printf("[");
-			ms_printValue(*i);
-			printf("]");
-		}
-		printf("\ncurrent instruction: ");
-		ms_disassembleInstruction(&frame->function->code,
-			    (int)(frame->ip - frame->function->code.data));
-		printf("\n");
+#define TRACE_INSTRUCTION() do {                                 \
+    printf("stack state: ");                                     \
+    for (ms_Value *i = vm->stack; i < sp; i++)                   \
+    {                                                            \
+      printf("[");                                               \
+      ms_printValue(*i);                                         \
+      printf("]");                                               \
+    }                                                            \
+    printf("\ncurrent instruction: ");                           \
+    ms_disassembleInstruction(&frame->function->code,            \
+      (int)(ip - frame->function->code.data));                   \
+    printf("\n");                                                \
+  } while(0)
+#else
+#define TRACE_INSTRUCTION() do {} while(0)
+#endif
+
+// VM_LOOP starts executing, VM_CASE labels the handler of an opcode
+// and every handler ends with VM_NEXT, which dispatches the next one.
+// with computed gotos each handler jumps straight to the next handler
+// through the label table, instead of going back to a shared switch
+#ifdef MS_COMPUTED_GOTO
+	static void *dispatchTable[] = {
+		#define OPCODE(op) &&VM_LABEL_##op,
+		#include "ms_opcodes.h"
+		#undef OPCODE
+	};
+
+#define VM_NEXT() do {                    \
+    TRACE_INSTRUCTION();                  \
+    PROFILE_INSTRUCTION();                \
+    goto *dispatchTable[NEXT_BYTE()];     \
+  } while(0)
+#define VM_LOOP VM_NEXT();
+#define VM_CASE(op) VM_LABEL_##op
+#else
+#define VM_NEXT() goto vm_loop
+#define VM_LOOP vm_loop: TRACE_INSTRUCTION(); PROFILE_INSTRUCTION(); switch (NEXT_BYTE())
+#define VM_CASE(op) case op
 #endif
 
-		switch (NEXT_BYTE())
-		{
-			case MS_OP_CONST: ms_pushValueIntoVM(vm, NEXT_CONST()); break;
-			case MS_OP_NULL:  ms_pushNullIntoVM(vm); break;
-			case MS_OP_TRUE:  ms_pushTrueIntoVM(vm); break;
-			case MS_OP_FALSE: ms_pushFalseIntoVM(vm); break;
-
-			case MS_OP_ADD:      BINARY_OP(vm, +); break;
-			case MS_OP_SUBTRACT: BINARY_OP(vm, -); break;
-			case MS_OP_MULTIPLY: BINARY_OP(vm, *); break;
-			case MS_OP_DIVIDE:   BINARY_OP(vm, /); break;
-			case MS_OP_POWER:
-				temp2 = ms_popValueFromVM(vm);
-				temp = ms_popValueFromVM(vm);
-
-				if (MS_VAL_TYPE(temp) != MS_VAL_TYPE(temp2))
-					return ms_runtimeError(vm, "Both types must be equal.");
-
-				if (MS_VAL_TYPE(temp) != MS_TYPE_NUM)
-					return ms_runtimeError(vm, "Can't currently operate on non-numbers.");
-				else
-					ms_pushValueIntoVM(vm, MS_FROM_NUM(pow(MS_TO_NUM(temp), MS_TO_NUM(temp2))));
-
-				break;
-
-			case MS_OP_MODULO:
-				temp2 = ms_popValueFromVM(vm);
-				temp = ms_popValueFromVM(vm);
-
-				if (MS_VAL_TYPE(temp) != MS_VAL_TYPE(temp2))
-					return ms_runtimeError(vm, "Both types must be equal.");
-
-				if (MS_VAL_TYPE(temp) != MS_TYPE_NUM)
-					return ms_runtimeError(vm, "Can't currently operate on non-numbers.");
-				else
-					ms_pushValueIntoVM(vm, MS_FROM_NUM(fmod(MS_TO_NUM(temp), MS_TO_NUM(temp2))));
-
-				break;
-
-#define ABSCLAMP01(v) fabs((v) < 0 ? 0 : ((v) > 1 ? 1 : (v)))
-
-			case MS_OP_NEGATE:
-				temp = ms_popValueFromVM(vm);
-				if (!MS_IS_NUM(temp)) return ms_runtimeError(vm, "Attempt to negate non-number");
-				ms_pushValueIntoVM(vm, MS_FROM_NUM(-ABSCLAMP01(MS_TO_NUM(temp))));
-				break;
-
-			case MS_OP_AND:
-				temp2 = ms_popValueFromVM(vm);
-				temp = ms_popValueFromVM(vm);
-				ms_pushValueIntoVM(vm,
-					MS_FROM_NUM(ABSCLAMP01(ms_getBoolVal(temp) * ms_getBoolVal(temp2)))
-				);
-				break;
-
-			case MS_OP_OR:
-				temp2 = MS_FROM_NUM(ms_getBoolVal(ms_popValueFromVM(vm)));
-				temp = MS_FROM_NUM(ms_getBoolVal(ms_popValueFromVM(vm)));
-				ms_pushValueIntoVM(vm, MS_FROM_NUM(ABSCLAMP01(
-					// formula taken from official C# implementation
-					MS_TO_NUM(temp) + MS_TO_NUM(temp2) - MS_TO_NUM(temp) * MS_TO_NUM(temp2)
-				)));
-				break;
-
-			case MS_OP_NOT:
-				temp = ms_popValueFromVM(vm);
-				ms_pushValueIntoVM(vm, MS_FROM_NUM(1-ABSCLAMP01(ms_getBoolVal(temp))));
-				break;
-
-#undef ABSCLAMP01
-
-			case MS_OP_EQUAL:
-				ms_pushValueIntoVM(vm, MS_FROM_NUM(
-					ms_valuesEqual(ms_popValueFromVM(vm), ms_popValueFromVM(vm))
-				));
-				break;
-
-			case MS_OP_NOT_EQUAL:
-				ms_pushValueIntoVM(vm, MS_FROM_NUM(
-					!ms_valuesEqual(ms_popValueFromVM(vm), ms_popValueFromVM(vm))
-				));
-				break;
-
-			case MS_OP_GREATER:       COMPARISON_OP(vm, > ); break;
-			case MS_OP_LESS:          COMPARISON_OP(vm, < ); break;
-			case MS_OP_GREATER_EQUAL: COMPARISON_OP(vm, >=); break;
-			case MS_OP_LESS_EQUAL:    COMPARISON_OP(vm, <=); break;
-			
-			case MS_OP_SET_GLOBAL:
-				ms_setMapKey(vm, &vm->globals, NEXT_CONST(), ms_popValueFromVM(vm));
-				break;
-
-			case MS_OP_GET_GLOBAL: {
-				ms_Value val = MS_NULL_VAL;
-				ms_getMapKey(vm, &vm->globals, NEXT_CONST(), &val);
-				ms_pushValueIntoVM(vm, val);
-			} break;
-
-			case MS_OP_GET_LOCAL: {
-				uint8_t slot = NEXT_BYTE();
-				ms_pushValueIntoVM(vm, frame->slots[slot]);
-			} break;
-
-			case MS_OP_SET_LOCAL: {
-				uint8_t slot = NEXT_BYTE();
-				frame->slots[slot] = ms_popValueFromVM(vm);
-			} break;
-
-			case MS_OP_INVOKE: {
-				int argCount = NEXT_BYTE();
-				callValue(vm, ms_peekIntoStack(vm, argCount), argCount);
-
-				frame = &vm->frames[vm->frameCount-1];
-			} break;
-
-			case MS_OP_JUMP: {
-				uint16_t offset = NEXT_SHORT();
-				frame->ip += offset;
-			} break;
-
-			case MS_OP_JUMP_IF_FALSE: {
-				uint16_t offset = NEXT_SHORT();
-				if (!ms_getBoolVal(ms_peekIntoStack(vm, 0))) frame->ip += offset;
-			} break;
-
-			case MS_OP_LOOP: {
-				uint16_t offset = NEXT_SHORT();
-				frame->ip -= offset;
-			} break;
-
-			case MS_OP_POP: ms_popValueFromVM(vm); break;
-
-			case MS_OP_RETURN: {
-				ms_Value result = ms_popValueFromVM(vm);
-				vm->frameCount--;
-				if (vm->frameCount == 0)
-				{
-					ms_popValueFromVM(vm);
 #ifdef MS_DEBUG_EXECUTION
-					printf("vm: sucessfully finished execution!\n");
+	fprintf(stderr, "vm: will start executing code...\n");
 #endif
-					return MS_INTERPRET_OK;
-				}
 
-				vm->stackTop = frame->slots;
-				ms_pushValueIntoVM(vm, result);
-				frame = &vm->frames[vm->frameCount-1];
-			} break;
+	LOAD_FRAME();
 
-			default: MS_UNREACHABLE("interpret"); break;
-		}
+	VM_LOOP
+	{
+		VM_CASE(MS_OP_CONST): PUSH(NEXT_CONST()); VM_NEXT();
+		VM_CASE(MS_OP_NULL):  PUSH(MS_NULL_VAL); VM_NEXT();
+		VM_CASE(MS_OP_TRUE):  PUSH(MS_FROM_NUM(1)); VM_NEXT();
+		VM_CASE(MS_OP_FALSE): PUSH(MS_FROM_NUM(0)); VM_NEXT();
+
+		VM_CASE(MS_OP_ADD):      BINARY_OP(+, MS_OP_ADD,      1, MS_OP_ADD_NUM_NUM);      VM_NEXT();
+		VM_CASE(MS_OP_SUBTRACT): BINARY_OP(-, MS_OP_SUBTRACT, 1, MS_OP_SUBTRACT_NUM_NUM); VM_NEXT();
+		VM_CASE(MS_OP_MULTIPLY): BINARY_OP(*, MS_OP_MULTIPLY, 1, MS_OP_MULTIPLY_NUM_NUM); VM_NEXT();
+		VM_CASE(MS_OP_DIVIDE):   BINARY_OP(/, MS_OP_DIVIDE,   1, MS_OP_DIVIDE_NUM_NUM);   VM_NEXT();
+
+		VM_CASE(MS_OP_POWER):
+			temp2 = POP();
+			temp = POP();
+
+			if (MS_UNLIKELY(!MS_IS_NUM(temp) || !MS_IS_NUM(temp2)))
+			{
+				STORE_FRAME();
+				return operandError(vm, temp, temp2);
+			}
+
+			PUSH(MS_FROM_NUM(pow(MS_TO_NUM(temp), MS_TO_NUM(temp2))));
+			VM_NEXT();
+
+		// exactly what pow() gives for an exponent of 2, errors included
+		VM_CASE(MS_OP_SQUARE):
+			temp = PEEK(0);
+			if (MS_UNLIKELY(!MS_IS_NUM(temp)))
+			{
+				STORE_FRAME();
+				return operandError(vm, temp, MS_FROM_NUM(2));
+			}
+
+			sp[-1] = MS_FROM_NUM(MS_TO_NUM(temp) * MS_TO_NUM(temp));
+			VM_NEXT();
+
+		VM_CASE(MS_OP_MODULO):
+			temp2 = POP();
+			temp = POP();
+
+			if (MS_UNLIKELY(!MS_IS_NUM(temp) || !MS_IS_NUM(temp2)))
+			{
+				STORE_FRAME();
+				return operandError(vm, temp, temp2);
+			}
+
+			PUSH(MS_FROM_NUM(fmod(MS_TO_NUM(temp), MS_TO_NUM(temp2))));
+			VM_NEXT();
+
+		VM_CASE(MS_OP_NEGATE):
+			temp = POP();
+			if (MS_UNLIKELY(!MS_IS_NUM(temp))) RUNTIME_ERROR("Attempt to negate non-number");
+			PUSH(MS_FROM_NUM(-ms_absClamp01(MS_TO_NUM(temp))));
+			VM_NEXT();
+
+		VM_CASE(MS_OP_AND):
+			temp2 = POP();
+			temp = POP();
+			PUSH(MS_FROM_NUM(ms_absClamp01(ms_getBoolVal(temp) * ms_getBoolVal(temp2))));
+			VM_NEXT();
+
+		VM_CASE(MS_OP_OR): {
+			double b = ms_getBoolVal(POP());
+			double a = ms_getBoolVal(POP());
+			// formula taken from official C# implementation
+			PUSH(MS_FROM_NUM(ms_absClamp01(a + b - a * b)));
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_NOT):
+			temp = POP();
+			PUSH(MS_FROM_NUM(1-ms_absClamp01(ms_getBoolVal(temp))));
+			VM_NEXT();
+
+		VM_CASE(MS_OP_EQUAL):
+			EQUALITY_OP(true, MS_OP_EQUAL_NUM_NUM);
+			VM_NEXT();
+
+		VM_CASE(MS_OP_NOT_EQUAL):
+			EQUALITY_OP(false, MS_OP_NOT_EQUAL_NUM_NUM);
+			VM_NEXT();
+
+		VM_CASE(MS_OP_GREATER):       COMPARISON_OP(> , MS_OP_GREATER_NUM_NUM);       VM_NEXT();
+		VM_CASE(MS_OP_LESS):          COMPARISON_OP(< , MS_OP_LESS_NUM_NUM);          VM_NEXT();
+		VM_CASE(MS_OP_GREATER_EQUAL): COMPARISON_OP(>=, MS_OP_GREATER_EQUAL_NUM_NUM); VM_NEXT();
+		VM_CASE(MS_OP_LESS_EQUAL):    COMPARISON_OP(<=, MS_OP_LESS_EQUAL_NUM_NUM);    VM_NEXT();
+
+		VM_CASE(MS_OP_BUILD_LIST): {
+			uint16_t count = NEXT_SHORT();
+			// the values stay on the stack, reachable, until the list holds them
+			STORE_FRAME();
+			ms_ObjList *list = ms_newListFrom(vm, sp - count, count);
+			sp -= count;
+			PUSH(MS_FROM_OBJ(list));
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_BUILD_MAP): {
+			uint16_t count = NEXT_SHORT();
+			STORE_FRAME();
+			ms_ObjMap *map = ms_newMapFrom(vm, sp - 2 * count, count);
+			sp -= 2 * count;
+			PUSH(MS_FROM_OBJ(map));
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_GET_INDEX): {
+			temp2 = PEEK(0);
+			temp = PEEK(1);
+
+			size_t pos;
+			if (MS_LIKELY(MS_IS_LIST(temp) && MS_IS_NUM(temp2)
+				&& ms_resolveIndex(MS_TO_NUM(temp2), MS_TO_LIST(temp)->count, &pos)))
+			{
+				sp--;
+				sp[-1] = ms_getListItem(MS_TO_LIST(temp), pos);
+			}
+			else
+			{
+				STORE_FRAME();
+				if (!getIndex(vm)) return MS_INTERPRET_RUNTIME_ERROR;
+				sp = vm->stackTop;
+			}
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_SET_INDEX): {
+			temp2 = PEEK(1);
+			temp = PEEK(2);
+
+			size_t pos;
+			if (MS_LIKELY(MS_IS_LIST(temp) && MS_IS_NUM(temp2)
+				&& ms_resolveIndex(MS_TO_NUM(temp2), MS_TO_LIST(temp)->count, &pos)))
+			{
+				// a view copies its items out first, and a numeric list turns
+				// into a list of values for anything but a number, which allocates
+				ms_ObjList *list = MS_TO_LIST(temp);
+				if (MS_UNLIKELY(list->base != NULL || (list->isNumeric && !MS_IS_NUM(PEEK(0)))))
+					STORE_FRAME();
+				ms_setListItem(vm, list, pos, PEEK(0));
+				sp -= 3;
+			}
+			else
+			{
+				STORE_FRAME();
+				if (!setIndex(vm)) return MS_INTERPRET_RUNTIME_ERROR;
+				sp = vm->stackTop;
+			}
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_SLICE):
+			STORE_FRAME();
+			if (!sliceValue(vm)) return MS_INTERPRET_RUNTIME_ERROR;
+			sp = vm->stackTop;
+			VM_NEXT();
+
+		VM_CASE(MS_OP_SET_GLOBAL): globals[NEXT_SHORT()] = POP(); VM_NEXT();
+		VM_CASE(MS_OP_GET_GLOBAL): PUSH(globals[NEXT_SHORT()]); VM_NEXT();
+
+		VM_CASE(MS_OP_GET_LOCAL): PUSH(slots[NEXT_BYTE()]); VM_NEXT();
+		VM_CASE(MS_OP_SET_LOCAL): slots[NEXT_BYTE()] = POP(); VM_NEXT();
+
+		VM_CASE(MS_OP_INVOKE): {
+			int argCount = NEXT_BYTE();
+			INVOKE(PEEK(argCount), argCount);
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_TAIL_INVOKE): {
+			int argCount = NEXT_BYTE();
+			temp = PEEK(argCount);
+			if (!MS_IS_FUNCTION(temp))
+			{
+				INVOKE(temp, argCount);
+				VM_NEXT();
+			}
+
+			// checked while this frame is still around to report the call's line,
+			// call() would blame the line of the frame below it
+			if (argCount > MS_TO_FUNCTION(temp)->arity) RUNTIME_ERROR("Too many arguments");
+
+			// slide the callee and its arguments down over the current
+			// frame, then let the callee take over the frame's place
+			ms_Value *args = sp - argCount - 1;
+			for (int i = 0; i <= argCount; i++) slots[i] = args[i];
+			sp = slots + argCount + 1;
+
+			STORE_FRAME();
+			vm->frameCount--;
+			if (!call(vm, MS_TO_FUNCTION(temp), argCount))
+				return MS_INTERPRET_RUNTIME_ERROR;
+			sp = vm->stackTop;
+			LOAD_FRAME();
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_JUMP): {
+			uint16_t offset = NEXT_SHORT();
+			ip += offset;
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_JUMP_IF_FALSE): {
+			uint16_t offset = NEXT_SHORT();
+			if (!ms_getBoolVal(PEEK(0))) ip += offset;
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_LOOP): {
+			uint16_t offset = NEXT_SHORT();
+			ip -= offset;
+			SAFEPOINT();
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_FOR_ITER): {
+			uint16_t offset = NEXT_SHORT();
+			FOR_ITER(offset);
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_CONST_LONG): PUSH(constants[NEXT_LONG()]); VM_NEXT();
+
+		VM_CASE(MS_OP_JUMP_LONG): {
+			size_t offset = NEXT_LONG();
+			ip += offset;
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_JUMP_IF_FALSE_LONG): {
+			size_t offset = NEXT_LONG();
+			if (!ms_getBoolVal(PEEK(0))) ip += offset;
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_LOOP_LONG): {
+			size_t offset = NEXT_LONG();
+			ip -= offset;
+			SAFEPOINT();
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_FOR_ITER_LONG): {
+			size_t offset = NEXT_LONG();
+			FOR_ITER(offset);
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_POP): sp--; VM_NEXT();
+
+		VM_CASE(MS_OP_RETURN):
+			temp = POP();
+			sp = slots;
+			vm->frameCount--;
+			if (vm->frameCount == 0)
+			{
+				vm->stackTop = sp;
+#ifdef MS_DEBUG_EXECUTION
+				printf("vm: sucessfully finished execution!\n");
+#endif
+				return MS_INTERPRET_OK;
+			}
+
+			PUSH(temp);
+			LOAD_FRAME();
+			VM_NEXT();
+
+		VM_CASE(MS_OP_GET_LOCAL_INVOKE):
+			temp = slots[NEXT_BYTE()];
+			PUSH(temp);
+			INVOKE(temp, 0);
+			VM_NEXT();
+
+		VM_CASE(MS_OP_GET_GLOBAL_INVOKE):
+			temp = globals[NEXT_SHORT()];
+			PUSH(temp);
+			INVOKE(temp, 0);
+			VM_NEXT();
+
+		VM_CASE(MS_OP_ADD_CONST):
+			// the constant goes on the stack like ADD's operand would've,
+			// every frame has a few spare slots for things like this
+			PUSH(NEXT_CONST());
+			BINARY_OP(+, MS_OP_ADD, 2, MS_OP_ADD_CONST_NUM);
+			VM_NEXT();
+
+		VM_CASE(MS_OP_POP_JUMP_IF_FALSE): {
+			uint16_t offset = NEXT_SHORT();
+			if (!ms_getBoolVal(POP())) ip += offset;
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_LESS_JUMP_IF_FALSE): {
+			uint16_t offset = NEXT_SHORT();
+			temp2 = PEEK(0);
+			temp = PEEK(1);
+
+			bool less;
+			if (MS_LIKELY(MS_IS_NUM(temp) && MS_IS_NUM(temp2)))
+			{
+				QUICKEN(3, MS_OP_LESS_NUM_JUMP_IF_FALSE);
+				less = MS_TO_NUM(temp) < MS_TO_NUM(temp2);
+			}
+			else if (MS_IS_ANY_STRING(temp) && MS_IS_ANY_STRING(temp2))
+			{
+				int cmp;
+				STRING_COMPARISON(cmp, temp, temp2);
+				less = cmp < 0;
+			}
+			else
+				RUNTIME_ERROR("Types must be equal.");
+
+			sp -= 2;
+			if (!less) ip += offset;
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_ADD_NUM_NUM):      NUMBER_OP(+, MS_OP_ADD);      VM_NEXT();
+		VM_CASE(MS_OP_SUBTRACT_NUM_NUM): NUMBER_OP(-, MS_OP_SUBTRACT); VM_NEXT();
+		VM_CASE(MS_OP_MULTIPLY_NUM_NUM): NUMBER_OP(*, MS_OP_MULTIPLY); VM_NEXT();
+		VM_CASE(MS_OP_DIVIDE_NUM_NUM):   NUMBER_OP(/, MS_OP_DIVIDE);   VM_NEXT();
+
+		VM_CASE(MS_OP_EQUAL_NUM_NUM):         NUMBER_OP(==, MS_OP_EQUAL);         VM_NEXT();
+		VM_CASE(MS_OP_NOT_EQUAL_NUM_NUM):     NUMBER_OP(!=, MS_OP_NOT_EQUAL);     VM_NEXT();
+		VM_CASE(MS_OP_LESS_NUM_NUM):          NUMBER_OP(< , MS_OP_LESS);          VM_NEXT();
+		VM_CASE(MS_OP_LESS_EQUAL_NUM_NUM):    NUMBER_OP(<=, MS_OP_LESS_EQUAL);    VM_NEXT();
+		VM_CASE(MS_OP_GREATER_NUM_NUM):       NUMBER_OP(> , MS_OP_GREATER);       VM_NEXT();
+		VM_CASE(MS_OP_GREATER_EQUAL_NUM_NUM): NUMBER_OP(>=, MS_OP_GREATER_EQUAL); VM_NEXT();
+
+		VM_CASE(MS_OP_ADD_CONST_NUM): {
+			ms_Value constant = NEXT_CONST();
+			temp = PEEK(0);
+			if (MS_UNLIKELY(!MS_IS_NUM(temp))) DEQUICKEN(2, MS_OP_ADD_CONST);
+			sp[-1] = MS_FROM_NUM(MS_TO_NUM(temp) + MS_TO_NUM(constant));
+		} VM_NEXT();
+
+		VM_CASE(MS_OP_LESS_NUM_JUMP_IF_FALSE): {
+			uint16_t offset = NEXT_SHORT();
+			temp2 = PEEK(0);
+			temp = PEEK(1);
+			if (MS_UNLIKELY(!MS_IS_NUM(temp) || !MS_IS_NUM(temp2)))
+				DEQUICKEN(3, MS_OP_LESS_JUMP_IF_FALSE);
+
+			sp -= 2;
+			if (!(MS_TO_NUM(temp) < MS_TO_NUM(temp2))) ip += offset;
+		} VM_NEXT();
+
+		VM_CASE(MS_OP__END):
+#ifndef MS_COMPUTED_GOTO
+		default:
+#endif
+			MS_UNREACHABLE("interpret");
 	}
 
+	return MS_INTERPRET_RUNTIME_ERROR;
+
+#undef STORE_FRAME
+#undef LOAD_FRAME
+#undef RUNTIME_ERROR
+#undef PUSH
+#undef POP
+#undef PEEK
 #undef NEXT_BYTE
+#undef NEXT_SHORT
+#undef NEXT_LONG
 #undef NEXT_CONST
+#undef INVOKE
+#undef FOR_ITER
+#undef QUICKEN
+#undef DEQUICKEN
 #undef BINARY_OP
+#undef NUMBER_OP
+#undef EQUALITY_OP
+#undef STRING_COMPARISON
+#undef COMPARISON_OP
+#undef TRACE_INSTRUCTION
+#undef PROFILE_INSTRUCTION
+#undef VM_NEXT
+#undef VM_LOOP
+#undef VM_CASE
 }
 
+#ifdef MS_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
+
 void ms_runTestProgram(ms_VM *vm)
 {
 	ms_Code code;
@@ -373,13 +1159,57 @@ void ms_runTestProgram(ms_VM *vm)
 	ms_freeCode(vm, &code);
 }
 
+static ms_InterpretResult runScript(ms_VM *vm, ms_ObjFunction *function)
+{
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(function));
+	ms_InterpretResult res = call(vm, function, 0)
+		? interpret(vm)
+		: MS_INTERPRET_RUNTIME_ERROR;
+
+	// don't let a failed script leave garbage behind for the next one
+	if (res != MS_INTERPRET_OK)
+	{
+		vm->stackTop = vm->stack;
+		vm->frameCount = 0;
+	}
+
+	return res;
+}
+
 ms_InterpretResult ms_interpretString(ms_VM *vm, char *str)
+{
+	ms_ObjFunction *function = ms_compileString(vm, str);
+	if (function == NULL) return MS_INTERPRET_COMPILE_ERROR;
+	return runScript(vm, function);
+}
+
+bool ms_compileToBytecode(ms_VM *vm, char *str, const char *path)
+{
+	ms_ObjFunction *function = ms_compileString(vm, str);
+	if (function == NULL) return false;
+
+	ms_pushValueIntoVM(vm, MS_FROM_OBJ(function));
+	bool saved = ms_saveBytecode(vm, function, path);
+	ms_popValueFromVM(vm);
+
+	if (!saved) fprintf(stderr, "couldn't save the script to %s\n", path);
+	return saved;
+}
+
+ms_InterpretResult ms_interpretStringAndSave(ms_VM *vm, char *str, const char *path)
 {
 	ms_ObjFunction *function = ms_compileString(vm, str);
 	if (function == NULL) return MS_INTERPRET_COMPILE_ERROR;
 
 	ms_pushValueIntoVM(vm, MS_FROM_OBJ(function));
-	call(vm, function, 0);
+	ms_saveBytecode(vm, function, path);
+	ms_popValueFromVM(vm);
+	return runScript(vm, function);
+}
 
-	return interpret(vm, &vm->frames[vm->frameCount-1]);
+ms_InterpretResult ms_interpretBytecode(ms_VM *vm, const char *path)
+{
+	ms_ObjFunction *function = ms_loadBytecode(vm, path);
+	if (function == NULL) return MS_INTERPRET_COMPILE_ERROR;
+	return runScript(vm, function);
 }
@@ -6,9 +6,23 @@
 #include "ms_object.h"
 #include "ms_value.h"
 #include "ms_map.h"
+#include "ms_slab.h"
 
-#define MS_MAX_FRAMES_AMT 64
-#define MS_MAX_STACK_SIZE (MS_MAX_FRAMES_AMT * UINT8_COUNT)
+// both stacks start small and grow as calls need them, up to the call depth limit
+#define MS_INITIAL_FRAMES 8
+#define MS_INITIAL_STACK_SIZE 64
+#define MS_DEFAULT_MAX_FRAMES 1024
+// every frame can hold at most UINT8_COUNT locals and temporaries
+#define MS_MAX_STACK_SIZE(maxFrames) ((size_t)(maxFrames) * UINT8_COUNT)
+// free slots every call leaves above its frame, for the values C code
+// pushes to keep them alive. pushing those never has to move the stack
+#define MS_STACK_RESERVE 8
+
+#define MS_GC_DEFAULT_THRESHOLD (1024 * 1024)
+#define MS_GC_DEFAULT_GROWTH 2.0
+#ifndef MS_NURSERY_SIZE
+#define MS_NURSERY_SIZE (64 * 1024)
+#endif
 
 typedef struct {
 	ms_ObjFunction *function;
@@ -17,17 +31,57 @@ typedef struct {
 } CallFrame;
 
 struct ms_VM {
-	CallFrame frames[MS_MAX_FRAMES_AMT];
-	int frameCount;
+	CallFrame *frames;
+	int frameCount, frameCap, maxFrames;
 
-	ms_Value stack[MS_MAX_STACK_SIZE], *stackTop;
+	ms_Value *stack, *stackTop;
+	size_t stackCap;
 	size_t bytesUsed;
 	ms_ReallocFn reallocFn;
-	ms_Map strings, globals;
+	ms_SlabAllocator slabs;
+	ms_Map strings;
+	uint64_t hashSeed;
+
+	// globals are resolved to slots at compile time. globalNames maps
+	// each name to its slot in globalValues, and globals is only a
+	// view of both, built on demand for reflection
+	ms_Map globalNames, globals;
+	ms_List globalValues;
+
 	ms_Object* objects;
+
+	// garbage collector state, see ms_mem.c
+	size_t nextGC, minGCThreshold;
+	double gcGrowthFactor;
+	ms_GCStats gcStats;
+	ms_Object **grayStack;
+	size_t grayCount, grayCap;
+	struct ms_Compiler *compiler;
+	// whether ms_optimizeCode does more than fuse instructions
+	bool optimizeCode;
+
+	// young objects are bump allocated in the nursery and copied
+	// into the list above when they survive a minor collection.
+	// remembered holds the old objects that may point into it
+	uint8_t *nursery, *nurseryTop, *nurseryEnd;
+	bool nurseryFull;
+	// while set, allocating never starts a collection
+	bool gcPaused;
+	ms_Object **remembered;
+	size_t rememberedCount, rememberedCap;
+	// bytecode files the code of loaded functions points into, see ms_bytecode.c
+	struct ms_Mapping *mappings;
 };
 
 ms_VM *ms_newVM(ms_ReallocFn reallocFn);
 void ms_freeVM(ms_VM *vm);
 
+bool ms_ensureStack(ms_VM *vm, size_t needed);
+void ms_pushValueIntoVM(ms_VM *vm, ms_Value val);
+ms_Value ms_popValueFromVM(ms_VM *vm);
+
+int ms_findGlobal(ms_VM *vm, ms_ObjString *name);
+int ms_declareGlobal(ms_VM *vm, ms_ObjString *name);
+ms_Map *ms_getGlobalsMap(ms_VM *vm);
+
 #endif